@@ -0,0 +1,218 @@
+/**
+    @file       bufpool.c
+    @brief      预分配缓冲池
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       启动时一次分配对齐的大块内存(可用大页并锁定), 通过无锁空闲链表分配固定大小的缓冲
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "string.h"
+#include "errno.h"
+
+#include "sys/mman.h"
+
+#include "bufpool.h"
+
+#define POOL_ALIGN      64                  /* 缓存行对齐 */
+#define POOL_HUGE_SIZE  (2 * 1024 * 1024)   /* 大页长度 */
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB     0x40000
+#endif
+
+/**
+    @fn         int pool_init(Pool_t *pPool, size_t size, uint32_t count, int flags)
+    @brief      创建缓冲池
+    @author     agent
+    @param[out] pPool       Pool_t*     缓冲池
+    @param[in]  size        size_t      每个缓冲的长度
+    @param[in]  count       uint32_t    缓冲个数
+    @param[in]  flags       int         POOL_HUGE POOL_LOCK
+    @retval     0 成功
+    @retval     -1 失败
+    @note       不小于一页的缓冲按页对齐, 其余按缓存行对齐. 所有页在创建时写一遍,
+                之后收发数据不会再缺页.
+*/
+int pool_init(Pool_t *pPool, size_t size, uint32_t count, int flags)
+{
+    uint32_t i = 0;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t align = (size >= page) ? page : POOL_ALIGN;
+
+    memset(pPool, 0x00, sizeof(Pool_t));
+    pPool->size = (size + align - 1) & ~(align - 1);
+    pPool->count = count;
+    pPool->length = pPool->size * count;
+
+    if (flags & POOL_HUGE)
+    {
+        pPool->length = (pPool->length + POOL_HUGE_SIZE - 1) & ~((size_t)POOL_HUGE_SIZE - 1);
+        pPool->base = mmap(NULL, pPool->length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pPool->base == MAP_FAILED)
+        {
+            printf("mmap failed(MAP_HUGETLB)!%d, use normal pages\n", errno);
+            pPool->base = NULL;
+        }
+        else
+        {
+            pPool->huge = 1;
+        }
+    }
+
+    if (pPool->base == NULL)
+    {
+        pPool->base = mmap(NULL, pPool->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pPool->base == MAP_FAILED)
+        {
+            printf("mmap failed!%d\n", errno);
+            pPool->base = NULL;
+            return -1;
+        }
+
+        /* 没有预留大页时尽量使用透明大页 */
+        if (flags & POOL_HUGE)
+        {
+            madvise(pPool->base, pPool->length, MADV_HUGEPAGE);
+        }
+    }
+
+    if (flags & POOL_LOCK)
+    {
+        if (mlock(pPool->base, pPool->length) == 0)
+        {
+            pPool->locked = 1;
+        }
+        else
+        {
+            printf("mlock failed!%d\n", errno);
+        }
+    }
+
+    memset(pPool->base, 0x00, pPool->length);
+
+    pPool->next = malloc(sizeof(uint32_t) * count);
+    if (pPool->next == NULL)
+    {
+        pool_destroy(pPool);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pPool->next[i] = (i + 1 < count) ? i + 1 : POOL_NIL;
+    }
+    pPool->head = (count != 0) ? 0 : POOL_NIL;
+
+    return 0;
+}
+
+/**
+    @fn         void *pool_get(Pool_t *pPool)
+    @brief      取一个缓冲
+    @author     agent
+    @param[in]  pPool       Pool_t*     缓冲池
+    @retval     缓冲地址
+    @retval     NULL 缓冲用完
+    @note       可以在多个线程中同时调用.
+*/
+void *pool_get(Pool_t *pPool)
+{
+    uint64_t old = 0;
+    uint64_t new = 0;
+    uint32_t index = 0;
+    uint32_t used = 0;
+    uint32_t peak = 0;
+
+    old = __atomic_load_n(&pPool->head, __ATOMIC_ACQUIRE);
+    do
+    {
+        index = (uint32_t)old;
+        if (index == POOL_NIL)
+        {
+            __atomic_add_fetch(&pPool->fails, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        new = (((old >> 32) + 1) << 32) | __atomic_load_n(&pPool->next[index], __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pPool->head, &old, new, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    __atomic_add_fetch(&pPool->gets, 1, __ATOMIC_RELAXED);
+    used = __atomic_add_fetch(&pPool->used, 1, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&pPool->peak, __ATOMIC_RELAXED);
+    while ((used > peak) &&
+           !__atomic_compare_exchange_n(&pPool->peak, &peak, used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+
+    return pPool->base + (size_t)index * pPool->size;
+}
+
+/**
+    @fn         void pool_put(Pool_t *pPool, void *buffer)
+    @brief      归还缓冲
+    @author     agent
+    @param[in]  pPool       Pool_t*     缓冲池
+    @param[in]  buffer      void*       pool_get取得的缓冲, NULL时不处理
+*/
+void pool_put(Pool_t *pPool, void *buffer)
+{
+    uint64_t old = 0;
+    uint64_t new = 0;
+    uint32_t index = 0;
+
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    index = (uint32_t)(((unsigned char *)buffer - pPool->base) / pPool->size);
+
+    old = __atomic_load_n(&pPool->head, __ATOMIC_ACQUIRE);
+    do
+    {
+        __atomic_store_n(&pPool->next[index], (uint32_t)old, __ATOMIC_RELAXED);
+        new = (((old >> 32) + 1) << 32) | index;
+    } while (!__atomic_compare_exchange_n(&pPool->head, &old, new, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    __atomic_sub_fetch(&pPool->used, 1, __ATOMIC_RELAXED);
+}
+
+/**
+    @fn         void pool_print(const Pool_t *pPool)
+    @brief      打印缓冲池使用情况
+    @author     agent
+    @param[in]  pPool       Pool_t*     缓冲池
+*/
+void pool_print(const Pool_t *pPool)
+{
+    printf("pool: %u x %zuB = %zuKB %s%s used=%u peak=%u gets=%llu fails=%llu\n",
+           pPool->count, pPool->size, pPool->length / 1024, pPool->huge ? "hugetlb" : "normal",
+           pPool->locked ? " locked" : "", pPool->used, pPool->peak,
+           (unsigned long long)pPool->gets, (unsigned long long)pPool->fails);
+}
+
+/**
+    @fn         void pool_destroy(Pool_t *pPool)
+    @brief      释放缓冲池
+    @author     agent
+    @param[in]  pPool       Pool_t*     缓冲池
+*/
+void pool_destroy(Pool_t *pPool)
+{
+    if (pPool->base != NULL)
+    {
+        munmap(pPool->base, pPool->length);
+        pPool->base = NULL;
+    }
+
+    if (pPool->next != NULL)
+    {
+        free(pPool->next);
+        pPool->next = NULL;
+    }
+}
@@ -0,0 +1,48 @@
+/**
+    @file       bufpool.h
+    @brief      预分配缓冲池
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       启动时一次分配对齐的大块内存(可用大页并锁定), 通过无锁空闲链表分配固定大小的缓冲
+*/
+
+#ifndef __BUFPOOL_H__
+#define __BUFPOOL_H__
+
+#include "stdint.h"
+#include "stddef.h"
+
+#define POOL_HUGE       0x01        /* 使用MAP_HUGETLB, 失败时退回普通页 */
+#define POOL_LOCK       0x02        /* mlock锁定, 避免换出和缺页 */
+
+#define POOL_NIL        0xFFFFFFFF  /* 空闲链表结束 */
+
+/**
+缓冲池结构体. head高32位为版本号, 低32位为空闲链表头的序号,
+每次修改版本号加1, 避免无锁链表的ABA问题.
+*/
+typedef struct Pool_s
+{
+    unsigned char *base;
+    size_t length;              /* 映射的总长度 */
+    size_t size;                /* 每个缓冲的长度 */
+    uint32_t count;
+    int huge;
+    int locked;
+    uint32_t *next;             /* 空闲链表, 与缓冲分开存放 */
+    uint64_t head;
+    uint32_t used;
+    uint32_t peak;
+    uint64_t gets;
+    uint64_t fails;
+} Pool_t;
+
+int pool_init(Pool_t *pPool, size_t size, uint32_t count, int flags);
+void *pool_get(Pool_t *pPool);
+void pool_put(Pool_t *pPool, void *buffer);
+void pool_print(const Pool_t *pPool);
+void pool_destroy(Pool_t *pPool);
+
+#endif
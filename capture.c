@@ -0,0 +1,259 @@
+/**
+    @file       capture.c
+    @brief      数据抓包与回放
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       接收数据带时间戳写入预分配的mmap文件, 发送端按原时间间隔回放
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "string.h"
+#include "errno.h"
+
+#include "sys/mman.h"
+#include "sys/stat.h"
+
+#include "hist.h"
+#include "capture.h"
+
+#define CAPTURE_ALIGN(x)    (((x) + 7) & ~(uint64_t)7)
+
+/**
+    @fn         int capture_open(Capture_t *pCapture, const char *path, int megabytes)
+    @brief      创建抓包文件
+    @author     agent
+    @param[out] pCapture    Capture_t*  抓包结构体
+    @param[in]  path        char*       文件路径
+    @param[in]  megabytes   int         文件大小, 单位MB
+    @retval     0 成功
+    @retval     <0 失败
+    @note       文件一次分配好并用MAP_POPULATE预先映射, 写记录时只有内存拷贝,
+                没有系统调用, 也不会缺页.
+*/
+int capture_open(Capture_t *pCapture, const char *path, int megabytes)
+{
+    int ret = 0;
+
+    memset(pCapture, 0x00, sizeof(Capture_t));
+    pCapture->size = (uint64_t)megabytes * 1024 * 1024;
+
+    pCapture->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (pCapture->fd == -1)
+    {
+        printf("open %s failed!%d\n", path, errno);
+        return -1;
+    }
+
+    ret = posix_fallocate(pCapture->fd, 0, pCapture->size);
+    if (ret != 0)
+    {
+        printf("posix_fallocate %s failed!%d\n", path, ret);
+        close(pCapture->fd);
+        return -2;
+    }
+
+    pCapture->map = mmap(NULL, pCapture->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         pCapture->fd, 0);
+    if (pCapture->map == MAP_FAILED)
+    {
+        printf("mmap %s failed!%d\n", path, errno);
+        close(pCapture->fd);
+        return -3;
+    }
+
+    pCapture->write = 1;
+    pCapture->head = (CaptureHead_t *)pCapture->map;
+    pCapture->head->magic = CAPTURE_MAGIC;
+    pCapture->head->version = CAPTURE_VERSION;
+    pCapture->head->size = pCapture->size;
+    pCapture->head->used = CAPTURE_ALIGN(sizeof(CaptureHead_t));
+
+    return 0;
+}
+
+/**
+    @fn         int capture_write(Capture_t *pCapture, const void *data, uint32_t length, uint32_t source)
+    @brief      写一条记录
+    @author     agent
+    @param[in]  pCapture    Capture_t*  抓包结构体
+    @param[in]  data        void*       数据
+    @param[in]  length      uint32_t    数据长度
+    @param[in]  source      uint32_t    数据来源
+    @retval     0 成功
+    @retval     -1 文件已满
+*/
+int capture_write(Capture_t *pCapture, const void *data, uint32_t length, uint32_t source)
+{
+    CaptureHead_t *head = pCapture->head;
+    CaptureRecord_t *record = NULL;
+    uint64_t total = CAPTURE_ALIGN(sizeof(CaptureRecord_t) + length);
+
+    if (head->used + total > head->size)
+    {
+        head->dropped++;
+        return -1;
+    }
+
+    record = (CaptureRecord_t *)(pCapture->map + head->used);
+    record->time = clock_ns(CLOCK_REALTIME);
+    record->length = length;
+    record->source = source;
+    memcpy(record + 1, data, length);
+
+    /* 记录写完再更新used, 保证异常退出时文件一致 */
+    __sync_synchronize();
+    head->used += total;
+    head->records++;
+
+    return 0;
+}
+
+/**
+    @fn         int capture_load(Capture_t *pCapture, const char *path)
+    @brief      打开抓包文件用于回放
+    @author     agent
+    @param[out] pCapture    Capture_t*  抓包结构体
+    @param[in]  path        char*       文件路径
+    @retval     0 成功
+    @retval     <0 失败
+*/
+int capture_load(Capture_t *pCapture, const char *path)
+{
+    struct stat st;
+
+    memset(pCapture, 0x00, sizeof(Capture_t));
+
+    pCapture->fd = open(path, O_RDONLY);
+    if (pCapture->fd == -1)
+    {
+        printf("open %s failed!%d\n", path, errno);
+        return -1;
+    }
+
+    if ((fstat(pCapture->fd, &st) != 0) || (st.st_size < sizeof(CaptureHead_t)))
+    {
+        printf("%s is not a capture file!\n", path);
+        close(pCapture->fd);
+        return -2;
+    }
+
+    pCapture->size = st.st_size;
+    pCapture->map = mmap(NULL, pCapture->size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, pCapture->fd, 0);
+    if (pCapture->map == MAP_FAILED)
+    {
+        printf("mmap %s failed!%d\n", path, errno);
+        close(pCapture->fd);
+        return -3;
+    }
+
+    pCapture->head = (CaptureHead_t *)pCapture->map;
+    if ((pCapture->head->magic != CAPTURE_MAGIC) || (pCapture->head->version != CAPTURE_VERSION) ||
+        (pCapture->head->used > pCapture->size))
+    {
+        printf("%s is not a capture file!\n", path);
+        capture_close(pCapture);
+        return -4;
+    }
+
+    pCapture->offset = CAPTURE_ALIGN(sizeof(CaptureHead_t));
+
+    return 0;
+}
+
+/**
+    @fn         CaptureRecord_t *capture_next(Capture_t *pCapture)
+    @brief      取下一条记录
+    @author     agent
+    @param[in]  pCapture    Capture_t*  抓包结构体
+    @retval     记录指针, 数据紧跟在记录头后面
+    @retval     NULL 没有更多记录
+*/
+CaptureRecord_t *capture_next(Capture_t *pCapture)
+{
+    CaptureRecord_t *record = NULL;
+
+    if (pCapture->offset + sizeof(CaptureRecord_t) > pCapture->head->used)
+    {
+        return NULL;
+    }
+
+    record = (CaptureRecord_t *)(pCapture->map + pCapture->offset);
+    if (pCapture->offset + sizeof(CaptureRecord_t) + record->length > pCapture->head->used)
+    {
+        return NULL;
+    }
+
+    pCapture->offset += CAPTURE_ALIGN(sizeof(CaptureRecord_t) + record->length);
+
+    return record;
+}
+
+/**
+    @fn         void capture_wait(uint64_t first, uint64_t start, uint64_t time, double speed)
+    @brief      等待到记录的回放时刻
+    @author     agent
+    @param[in]  first       uint64_t    第一条记录的时间
+    @param[in]  start       uint64_t    回放开始的CLOCK_MONOTONIC时间
+    @param[in]  time        uint64_t    本条记录的时间
+    @param[in]  speed       double      回放倍速, 0表示不等待
+    @note       按绝对时间休眠, 间隔误差不会累积.
+*/
+void capture_wait(uint64_t first, uint64_t start, uint64_t time, double speed)
+{
+    uint64_t target = 0;
+    struct timespec ts;
+
+    if ((speed <= 0) || (time <= first))
+    {
+        return;
+    }
+
+    target = start + (uint64_t)((time - first) / speed);
+    ts.tv_sec = target / 1000000000ULL;
+    ts.tv_nsec = target % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+/**
+    @fn         void capture_close(Capture_t *pCapture)
+    @brief      关闭抓包文件
+    @author     agent
+    @param[in]  pCapture    Capture_t*  抓包结构体
+    @note       抓包文件关闭时截断到实际使用的长度.
+*/
+void capture_close(Capture_t *pCapture)
+{
+    uint64_t used = 0;
+
+    if ((pCapture->map != NULL) && (pCapture->map != MAP_FAILED))
+    {
+        used = pCapture->head->used;
+        if (pCapture->write)
+        {
+            printf("capture records=%llu bytes=%llu dropped=%llu\n",
+                   (unsigned long long)pCapture->head->records, (unsigned long long)used,
+                   (unsigned long long)pCapture->head->dropped);
+            msync(pCapture->map, used, MS_SYNC);
+        }
+        munmap(pCapture->map, pCapture->size);
+        pCapture->map = NULL;
+
+        if (pCapture->write)
+        {
+            ftruncate(pCapture->fd, used);
+        }
+    }
+
+    if (pCapture->fd > 0)
+    {
+        close(pCapture->fd);
+        pCapture->fd = -1;
+    }
+}
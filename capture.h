@@ -0,0 +1,61 @@
+/**
+    @file       capture.h
+    @brief      数据抓包与回放
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       接收数据带时间戳写入预分配的mmap文件, 发送端按原时间间隔回放
+*/
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include "stdint.h"
+
+#define CAPTURE_MAGIC       0x5041434E  /* "NCAP" */
+#define CAPTURE_VERSION     1
+#define CAPTURE_SIZE        64          /* 默认文件大小, 单位MB */
+
+/**
+文件头, 位于文件开始处. used在每条记录写完后更新,
+程序异常退出时已写入的记录仍然有效.
+*/
+typedef struct CaptureHead_s
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;              /* 文件大小 */
+    uint64_t used;              /* 已用字节数, 包括文件头 */
+    uint64_t records;
+    uint64_t dropped;           /* 文件满后丢弃的记录数 */
+} CaptureHead_t;
+
+/**
+记录头, 后跟length字节数据, 整条记录按8字节对齐.
+*/
+typedef struct CaptureRecord_s
+{
+    uint64_t time;              /* CLOCK_REALTIME, 单位ns */
+    uint32_t length;
+    uint32_t source;            /* udp为对端ip, 其他为0 */
+} CaptureRecord_t;
+
+typedef struct Capture_s
+{
+    int fd;
+    int write;                  /* 1:抓包 0:回放 */
+    unsigned char *map;
+    uint64_t size;
+    uint64_t offset;            /* 回放时下一条记录的位置 */
+    CaptureHead_t *head;
+} Capture_t;
+
+int capture_open(Capture_t *pCapture, const char *path, int megabytes);
+int capture_write(Capture_t *pCapture, const void *data, uint32_t length, uint32_t source);
+int capture_load(Capture_t *pCapture, const char *path);
+CaptureRecord_t *capture_next(Capture_t *pCapture);
+void capture_wait(uint64_t first, uint64_t start, uint64_t time, double speed);
+void capture_close(Capture_t *pCapture);
+
+#endif
@@ -0,0 +1,767 @@
+/**
+    @file       ctl.c
+    @brief      多进程多节点测试编排
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       控制连接上是一行一条的文本命令:
+                协调端发送 time, run <启动时刻> <参数>, stop;
+                代理回复 @time, @ready, @start, @result, @exit, 其余行是角色的普通输出.
+                代理为每个控制连接fork一个进程, 标准输出重定向到控制连接,
+                所以角色原有的打印原样转发到协调端.
+*/
+
+#define _GNU_SOURCE
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "string.h"
+#include "errno.h"
+#include "signal.h"
+#include "time.h"
+#include "poll.h"
+#include "getopt.h"
+#include "pthread.h"
+
+#include "sys/socket.h"
+#include "netinet/in.h"
+#include "netinet/tcp.h"
+#include "arpa/inet.h"
+
+#include "ctl.h"
+
+/**
+计划中的一个角色和它的控制连接.
+*/
+typedef struct Agent_s
+{
+    int server;
+    char addr[64];
+    char args[CTL_LINE];
+    int fd;
+    int64_t offset;             /* 代理时钟减协调端时钟, 单位ns */
+    uint64_t rtt;               /* 测量时钟偏差时的往返时间 */
+    uint64_t start;             /* 约定的启动时刻, 代理时钟 */
+    int64_t late;               /* 实际启动比约定晚的时间 */
+    char line[CTL_LINE];
+    int length;
+    int ready;
+    int done;
+    int ret;
+    Result_t result;
+} Agent_t;
+
+static int s_agent = 0;
+static int s_control = -1;
+static Result_t s_result;
+
+/**
+    @fn         int ctl_agent(void)
+    @brief      是否在代理中运行
+    @author     agent
+    @retval     1 代理中运行
+    @retval     0 独立运行
+*/
+int ctl_agent(void)
+{
+    return s_agent;
+}
+
+/**
+    @fn         void ctl_ready(void)
+    @brief      通知协调端server已开始监听
+    @author     agent
+    @note       独立运行时什么也不做.
+*/
+void ctl_ready(void)
+{
+    if (s_agent)
+    {
+        printf("@ready\n");
+        fflush(stdout);
+    }
+}
+
+/**
+    @fn         void ctl_result(const char *role, uint64_t messages, uint64_t bytes, uint64_t errors, uint64_t ns, const Hist_t *pHist)
+    @brief      记录角色的统计
+    @author     agent
+    @param[in]  role        char*       统计名称, 单个单词不能有空格, 否则控制端无法解析
+    @param[in]  messages    uint64_t    消息数
+    @param[in]  bytes       uint64_t    字节数
+    @param[in]  errors      uint64_t    错误数
+    @param[in]  ns          uint64_t    运行时间
+    @param[in]  pHist       Hist_t*     延时直方图, 可为NULL
+    @note       server每个连接调用一次, 数量累加, 时间和延时取最大值.
+*/
+void ctl_result(const char *role, uint64_t messages, uint64_t bytes, uint64_t errors, uint64_t ns,
+                const Hist_t *pHist)
+{
+    uint64_t value = 0;
+
+    if (s_result.role[0] == '\0')
+    {
+        snprintf(s_result.role, sizeof(s_result.role), "%s", role);
+    }
+    s_result.messages += messages;
+    s_result.bytes += bytes;
+    s_result.errors += errors;
+    if (ns > s_result.ns) s_result.ns = ns;
+
+    if ((pHist != NULL) && (pHist->count != 0))
+    {
+        value = hist_percentile(pHist, 50);
+        if (value > s_result.p50) s_result.p50 = value;
+        value = hist_percentile(pHist, 99);
+        if (value > s_result.p99) s_result.p99 = value;
+        if (pHist->max > s_result.max) s_result.max = pHist->max;
+    }
+}
+
+/**
+    @fn         static int ctl_readline(int fd, char *line, int size)
+    @brief      逐字节读一行
+    @author     agent
+    @param[in]  fd          int         控制连接
+    @param[out] line        char*       行内容, 不含换行
+    @param[in]  size        int         缓冲长度
+    @retval     >=0 行长度
+    @retval     -1 连接关闭
+    @note       只用于命令很少的代理端和时钟同步, 角色输出走带缓冲的读.
+*/
+static int ctl_readline(int fd, char *line, int size)
+{
+    int n = 0;
+    char c = 0;
+
+    for (;;)
+    {
+        if (read(fd, &c, 1) != 1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (c == '\n')
+        {
+            break;
+        }
+        if (n < size - 1)
+        {
+            line[n++] = c;
+        }
+    }
+    line[n] = '\0';
+
+    return n;
+}
+
+/**
+    @fn         static void *agent_watch(void *arg)
+    @brief      代理监视线程
+    @author     agent
+    @param[in]  arg         void*       未使用
+    @retval     NULL
+    @note       收到stop或协调端断开时向本进程发送SIGINT, 角色按ctrl+c的方式结束并打印统计.
+*/
+static void *agent_watch(void *arg)
+{
+    char line[CTL_LINE];
+
+    while (ctl_readline(s_control, line, sizeof(line)) >= 0)
+    {
+        if (strcmp(line, "stop") == 0)
+        {
+            break;
+        }
+    }
+    kill(getpid(), SIGINT);
+
+    return NULL;
+}
+
+/**
+    @fn         static int agent_child(int fd, Role_t role, const char *name)
+    @brief      代理进程处理一个控制连接
+    @author     agent
+    @param[in]  fd          int         控制连接
+    @param[in]  role        Role_t      角色入口, 参数与命令行相同
+    @param[in]  name        char*       程序名
+    @retval     角色的返回值
+*/
+static int agent_child(int fd, Role_t role, const char *name)
+{
+    int n = 0;
+    int ret = 0;
+    int argc = 1;
+    char line[CTL_LINE];
+    char *argv[64];
+    char *item = NULL;
+    char *save = NULL;
+    unsigned long long start = 0;
+    struct timespec ts;
+    sigset_t set;
+    pthread_t thread;
+
+    /* 角色的输出直接送到协调端 */
+    dup2(fd, STDOUT_FILENO);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    s_agent = 1;
+    s_control = fd;
+
+    for (;;)
+    {
+        if (ctl_readline(fd, line, sizeof(line)) < 0)
+        {
+            return -1;
+        }
+        if (strcmp(line, "time") == 0)
+        {
+            printf("@time %llu\n", (unsigned long long)clock_ns(CLOCK_REALTIME));
+            continue;
+        }
+        if (sscanf(line, "run %llu %n", &start, &n) >= 1)
+        {
+            break;
+        }
+    }
+
+    argv[0] = (char *)name;
+    for (item = strtok_r(line + n, " \t", &save); (item != NULL) && (argc < 63); item = strtok_r(NULL, " \t", &save))
+    {
+        argv[argc++] = item;
+    }
+    argv[argc] = NULL;
+
+    /* SIGINT只交给运行角色的主线程 */
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    pthread_create(&thread, NULL, agent_watch, NULL);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+
+    if (start != 0)
+    {
+        ts.tv_sec = start / 1000000000ULL;
+        ts.tv_nsec = start % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        {
+        }
+    }
+    printf("@start %llu\n", (unsigned long long)clock_ns(CLOCK_REALTIME));
+
+    optind = 1;
+    ret = role(argc, argv);
+
+    printf("@result %s %llu %llu %llu %llu %llu %llu %llu\n", s_result.role[0] ? s_result.role : "-",
+           (unsigned long long)s_result.messages, (unsigned long long)s_result.bytes,
+           (unsigned long long)s_result.errors, (unsigned long long)s_result.ns,
+           (unsigned long long)s_result.p50, (unsigned long long)s_result.p99, (unsigned long long)s_result.max);
+    printf("@exit %d\n", ret);
+    fflush(stdout);
+
+    return ret;
+}
+
+/**
+    @fn         int agent_run(int port, Role_t role, const char *name)
+    @brief      代理, 等待协调端连接
+    @author     agent
+    @param[in]  port        int         控制端口
+    @param[in]  role        Role_t      角色入口, 参数与命令行相同
+    @param[in]  name        char*       程序名
+    @retval     -1 失败
+    @note       每个控制连接fork一个进程, 同一个代理可以同时运行多个角色. ctrl+c退出.
+*/
+int agent_run(int port, Role_t role, const char *name)
+{
+    int fd = -1;
+    int conn = -1;
+    int opt = 1;
+    pid_t pid = 0;
+    struct sockaddr_in local;
+    struct sockaddr_in peer;
+    socklen_t length = 0;
+
+    /* 子进程退出后自动回收 */
+    signal(SIGCHLD, SIG_IGN);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+    {
+        printf("socket failed!%d\n", errno);
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&local, 0x00, sizeof(struct sockaddr_in));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = INADDR_ANY;
+    if ((bind(fd, (struct sockaddr *)&local, sizeof(struct sockaddr_in)) == -1) || (listen(fd, CTL_AGENTS) == -1))
+    {
+        printf("bind failed!%d\n", errno);
+        close(fd);
+        return -1;
+    }
+
+    printf("agent on port %d, press ctrl+c to quit.\n", port);
+    for (;;)
+    {
+        length = sizeof(struct sockaddr_in);
+        conn = accept(fd, (struct sockaddr *)&peer, &length);
+        if (conn == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("accept failed!%d\n", errno);
+            break;
+        }
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0)
+        {
+            close(fd);
+            exit(agent_child(conn, role, name) == 0 ? 0 : 1);
+        }
+        if (pid == -1)
+        {
+            printf("fork failed!%d\n", errno);
+        }
+        else
+        {
+            printf("controller %s:%d, role pid %d\n", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port), (int)pid);
+        }
+        close(conn);
+    }
+
+    close(fd);
+    return -1;
+}
+
+/**
+    @fn         static int ctl_connect(Agent_t *pAgent)
+    @brief      连接代理并测量时钟偏差
+    @author     agent
+    @param[in]  pAgent      Agent_t*    角色
+    @retval     0 成功
+    @retval     -1 失败
+    @note       与NTP相同, 偏差为代理时间减去发送和接收的中点, 取往返时间最短的一次.
+                跨节点时不要求两端时钟同步.
+*/
+static int ctl_connect(Agent_t *pAgent)
+{
+    int i = 0;
+    int opt = 1;
+    char ip[64];
+    char line[CTL_LINE];
+    char *colon = NULL;
+    uint64_t t0 = 0;
+    uint64_t t1 = 0;
+    unsigned long long remote = 0;
+    struct sockaddr_in addr;
+
+    snprintf(ip, sizeof(ip), "%s", pAgent->addr);
+    colon = strrchr(ip, ':');
+    if (colon == NULL)
+    {
+        printf("bad agent %s!\n", pAgent->addr);
+        return -1;
+    }
+    *colon = '\0';
+
+    memset(&addr, 0x00, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(strtoul(colon + 1, NULL, 10));
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1)
+    {
+        printf("bad agent %s!\n", pAgent->addr);
+        return -1;
+    }
+
+    pAgent->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (pAgent->fd == -1)
+    {
+        printf("socket failed!%d\n", errno);
+        return -1;
+    }
+    if (connect(pAgent->fd, (struct sockaddr *)&addr, sizeof(struct sockaddr_in)) == -1)
+    {
+        printf("connect %s failed!%d\n", pAgent->addr, errno);
+        return -1;
+    }
+    setsockopt(pAgent->fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    pAgent->rtt = UINT64_MAX;
+    for (i = 0; i < CTL_SYNC; i++)
+    {
+        t0 = clock_ns(CLOCK_REALTIME);
+        if ((write(pAgent->fd, "time\n", 5) != 5) || (ctl_readline(pAgent->fd, line, sizeof(line)) < 0) ||
+            (sscanf(line, "@time %llu", &remote) != 1))
+        {
+            printf("sync %s failed!%d\n", pAgent->addr, errno);
+            return -1;
+        }
+        t1 = clock_ns(CLOCK_REALTIME);
+        if (t1 - t0 < pAgent->rtt)
+        {
+            pAgent->rtt = t1 - t0;
+            pAgent->offset = (int64_t)(remote - (t0 + (t1 - t0) / 2));
+        }
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static void ctl_line(Agent_t *pAgent, int index, char *line)
+    @brief      处理代理发来的一行
+    @author     agent
+    @param[in]  pAgent      Agent_t*    角色
+    @param[in]  index       int         角色序号
+    @param[in]  line        char*       行内容
+*/
+static void ctl_line(Agent_t *pAgent, int index, char *line)
+{
+    unsigned long long value[8];
+    Result_t *pResult = &pAgent->result;
+
+    if (strcmp(line, "@ready") == 0)
+    {
+        pAgent->ready = 1;
+    }
+    else if (sscanf(line, "@start %llu", &value[0]) == 1)
+    {
+        pAgent->late = pAgent->start ? (int64_t)(value[0] - pAgent->start) : 0;
+    }
+    else if (sscanf(line, "@result %31s %llu %llu %llu %llu %llu %llu %llu", pResult->role, &value[0], &value[1],
+                    &value[2], &value[3], &value[4], &value[5], &value[6]) == 8)
+    {
+        pResult->messages = value[0];
+        pResult->bytes = value[1];
+        pResult->errors = value[2];
+        pResult->ns = value[3];
+        pResult->p50 = value[4];
+        pResult->p99 = value[5];
+        pResult->max = value[6];
+    }
+    else if (strncmp(line, "@result", 7) == 0)
+    {
+        printf("[%d %s] bad result line: %s\n", index, pAgent->server ? "server" : "client", line);
+    }
+    else if (sscanf(line, "@exit %d", &pAgent->ret) == 1)
+    {
+        pAgent->done = 1;
+    }
+    else if (line[0] != '@')
+    {
+        printf("[%d %s] %s\n", index, pAgent->server ? "server" : "client", line);
+    }
+}
+
+/**
+    @fn         static int ctl_wait(Agent_t *pAgent, int count, int server, int ready, int timeout)
+    @brief      转发代理输出, 直到一组角色全部就绪或结束
+    @author     agent
+    @param[in]  pAgent      Agent_t*    角色数组
+    @param[in]  count       int         角色数
+    @param[in]  server      int         1:等待server 0:等待client
+    @param[in]  ready       int         1:等待就绪 0:等待结束
+    @param[in]  timeout     int         超时, 单位ms, -1为不超时
+    @retval     0 条件满足
+    @retval     -1 超时
+    @note       连接断开而没有@exit的角色记为结束, 返回值-1.
+*/
+static int ctl_wait(Agent_t *pAgent, int count, int server, int ready, int timeout)
+{
+    int i = 0;
+    int n = 0;
+    int waiting = 0;
+    char *begin = NULL;
+    char *end = NULL;
+    uint64_t deadline = clock_ns(CLOCK_MONOTONIC) + (uint64_t)timeout * 1000000;
+    uint64_t now = 0;
+    struct pollfd fds[CTL_AGENTS];
+
+    for (;;)
+    {
+        waiting = 0;
+        for (i = 0; i < count; i++)
+        {
+            if ((pAgent[i].server == server) && !pAgent[i].done && (!ready || !pAgent[i].ready))
+            {
+                waiting++;
+            }
+            fds[i].fd = pAgent[i].fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        if (waiting == 0)
+        {
+            return 0;
+        }
+
+        now = clock_ns(CLOCK_MONOTONIC);
+        if ((timeout >= 0) && (now >= deadline))
+        {
+            return -1;
+        }
+        if (poll(fds, count, (timeout < 0) ? -1 : (int)((deadline - now) / 1000000 + 1)) <= 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+
+            n = read(pAgent[i].fd, pAgent[i].line + pAgent[i].length, CTL_LINE - 1 - pAgent[i].length);
+            if (n <= 0)
+            {
+                if (!pAgent[i].done)
+                {
+                    printf("[%d] %s connection lost!\n", i, pAgent[i].addr);
+                    pAgent[i].done = 1;
+                    pAgent[i].ret = -1;
+                }
+                close(pAgent[i].fd);
+                pAgent[i].fd = -1;
+                continue;
+            }
+
+            pAgent[i].length += n;
+            pAgent[i].line[pAgent[i].length] = '\0';
+            for (begin = pAgent[i].line; (end = strchr(begin, '\n')) != NULL; begin = end + 1)
+            {
+                *end = '\0';
+                ctl_line(&pAgent[i], i, begin);
+            }
+
+            /* 超长的行直接输出 */
+            if ((begin == pAgent[i].line) && (pAgent[i].length == CTL_LINE - 1))
+            {
+                ctl_line(&pAgent[i], i, begin);
+                begin += pAgent[i].length;
+            }
+            pAgent[i].length -= begin - pAgent[i].line;
+            memmove(pAgent[i].line, begin, pAgent[i].length);
+        }
+    }
+}
+
+/**
+    @fn         static void ctl_report(Agent_t *pAgent, int count)
+    @brief      打印汇总统计
+    @author     agent
+    @param[in]  pAgent      Agent_t*    角色数组
+    @param[in]  count       int         角色数
+    @note       client的消息数和字节数相加, 总速率按最长的client运行时间计算,
+                延时取所有client中最差的值. 启动偏差反映同步启动的精度.
+*/
+static void ctl_report(Agent_t *pAgent, int count)
+{
+    int i = 0;
+    int clients = 0;
+    int failed = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    uint64_t span = 0;
+    uint64_t p99 = 0;
+    uint64_t max = 0;
+    int64_t early = INT64_MAX;
+    int64_t late = INT64_MIN;
+    double seconds = 0;
+    Result_t *pResult = NULL;
+
+    printf("=== merged report ===\n");
+    printf("%-3s %-6s %-21s %-12s %12s %14s %8s %9s %9s %10s %10s %10s %5s\n", "#", "role", "agent", "name",
+           "messages", "bytes", "errors", "time(s)", "Gbps", "p50(us)", "p99(us)", "max(us)", "ret");
+    for (i = 0; i < count; i++)
+    {
+        pResult = &pAgent[i].result;
+        seconds = pResult->ns / 1e9;
+        printf("%-3d %-6s %-21s %-12s %12llu %14llu %8llu %9.3f %9.3f %10.3f %10.3f %10.3f %5d\n", i,
+               pAgent[i].server ? "server" : "client", pAgent[i].addr, pResult->role[0] ? pResult->role : "-",
+               (unsigned long long)pResult->messages, (unsigned long long)pResult->bytes,
+               (unsigned long long)pResult->errors, seconds, seconds > 0 ? pResult->bytes * 8 / seconds / 1e9 : 0.0,
+               pResult->p50 / 1000.0, pResult->p99 / 1000.0, pResult->max / 1000.0, pAgent[i].ret);
+
+        if (pAgent[i].ret != 0)
+        {
+            failed++;
+        }
+        if (pAgent[i].server)
+        {
+            continue;
+        }
+
+        clients++;
+        messages += pResult->messages;
+        bytes += pResult->bytes;
+        errors += pResult->errors;
+        if (pResult->ns > span) span = pResult->ns;
+        if (pResult->p99 > p99) p99 = pResult->p99;
+        if (pResult->max > max) max = pResult->max;
+        if (pAgent[i].late < early) early = pAgent[i].late;
+        if (pAgent[i].late > late) late = pAgent[i].late;
+    }
+
+    if (clients == 0)
+    {
+        return;
+    }
+
+    seconds = span / 1e9;
+    printf("clients=%d failed=%d messages=%llu bytes=%llu errors=%llu span=%.3fs aggregate=%.3fGbps %.0fmsgs/s\n",
+           clients, failed, (unsigned long long)messages, (unsigned long long)bytes, (unsigned long long)errors,
+           seconds, seconds > 0 ? bytes * 8 / seconds / 1e9 : 0.0, seconds > 0 ? messages / seconds : 0.0);
+    printf("worst p99=%.3fus max=%.3fus start skew=%.3fus (late %.3fus ~ %.3fus)\n", p99 / 1000.0, max / 1000.0,
+           (late - early) / 1000.0, early / 1000.0, late / 1000.0);
+}
+
+/**
+    @fn         int ctl_run(const char *plan)
+    @brief      协调端, 按计划文件运行一次测试
+    @author     agent
+    @param[in]  plan        char*       计划文件
+    @retval     0 所有角色成功
+    @retval     -1 失败
+    @note       计划文件每行一个角色: server|client <代理ip:端口> <参数>, #开头为注释, 例如
+                server 192.168.1.200:7000 -s -p 8080 -e
+                client 192.168.1.201:7000 -c -i 192.168.1.200 -p 8080 -e -n 100000
+                同一个代理可以出现多次, 本机多进程测试时所有代理写127.0.0.1.
+*/
+int ctl_run(const char *plan)
+{
+    int i = 0;
+    int n = 0;
+    int ret = 0;
+    int count = 0;
+    char role[16];
+    char text[CTL_LINE];
+    uint64_t start = 0;
+    FILE *file = NULL;
+    Agent_t *pAgent = NULL;
+
+    pAgent = calloc(CTL_AGENTS, sizeof(Agent_t));
+    file = fopen(plan, "r");
+    if ((pAgent == NULL) || (file == NULL))
+    {
+        printf("open %s failed!%d\n", plan, errno);
+        ret = -1;
+        goto Exit;
+    }
+
+    while ((count < CTL_AGENTS) && (fgets(text, sizeof(text), file) != NULL))
+    {
+        text[strcspn(text, "\r\n")] = '\0';
+        n = 0;
+        if ((text[0] == '#') || (sscanf(text, "%15s %63s %n", role, pAgent[count].addr, &n) < 2) || (n == 0))
+        {
+            continue;
+        }
+        if ((strcmp(role, "server") != 0) && (strcmp(role, "client") != 0))
+        {
+            printf("bad role %s!\n", role);
+            ret = -1;
+            goto Exit;
+        }
+        pAgent[count].server = (role[0] == 's');
+        pAgent[count].fd = -1;
+        snprintf(pAgent[count].args, sizeof(pAgent[count].args), "%s", text + n);
+        count++;
+    }
+    fclose(file);
+    file = NULL;
+
+    for (i = 0; i < count; i++)
+    {
+        if (ctl_connect(&pAgent[i]) != 0)
+        {
+            ret = -1;
+            goto Exit;
+        }
+        printf("[%d] %s %s offset=%.3fus rtt=%.3fus: %s\n", i, pAgent[i].server ? "server" : "client",
+               pAgent[i].addr, pAgent[i].offset / 1000.0, pAgent[i].rtt / 1000.0, pAgent[i].args);
+    }
+
+    /* server先启动, 全部开始监听后才启动client */
+    for (i = 0; i < count; i++)
+    {
+        if (pAgent[i].server)
+        {
+            dprintf(pAgent[i].fd, "run 0 %s\n", pAgent[i].args);
+        }
+    }
+    if (ctl_wait(pAgent, count, 1, 1, CTL_READY_MS) != 0)
+    {
+        printf("servers not ready!\n");
+        ret = -1;
+        goto Stop;
+    }
+
+    /* 统一的启动时刻换算到各代理的时钟 */
+    start = clock_ns(CLOCK_REALTIME) + CTL_LEAD_MS * 1000000ULL;
+    for (i = 0; i < count; i++)
+    {
+        if (!pAgent[i].server)
+        {
+            pAgent[i].start = start + pAgent[i].offset;
+            dprintf(pAgent[i].fd, "run %llu %s\n", (unsigned long long)pAgent[i].start, pAgent[i].args);
+        }
+    }
+    ctl_wait(pAgent, count, 0, 0, -1);
+
+Stop:
+    for (i = 0; i < count; i++)
+    {
+        if (pAgent[i].server && (pAgent[i].fd != -1))
+        {
+            dprintf(pAgent[i].fd, "stop\n");
+        }
+    }
+    if (ctl_wait(pAgent, count, 1, 0, CTL_READY_MS) != 0)
+    {
+        printf("servers did not stop!\n");
+    }
+
+    ctl_report(pAgent, count);
+    for (i = 0; i < count; i++)
+    {
+        if (pAgent[i].ret != 0)
+        {
+            ret = -1;
+        }
+    }
+
+Exit:
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    if (pAgent != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (pAgent[i].fd != -1)
+            {
+                close(pAgent[i].fd);
+            }
+        }
+        free(pAgent);
+    }
+
+    return ret;
+}
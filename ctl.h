@@ -0,0 +1,50 @@
+/**
+    @file       ctl.h
+    @brief      多进程多节点测试编排
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       代理(agent)在控制端口等待协调端(controller)的连接, 每个连接运行一个角色.
+                协调端按计划文件先启动所有server并等待就绪, 再按各代理的时钟偏差
+                约定同一时刻启动所有client, client结束后停止server, 汇总各代理的统计.
+*/
+
+#ifndef __CTL_H__
+#define __CTL_H__
+
+#include "stdint.h"
+
+#include "hist.h"
+
+#define CTL_AGENTS      32          /* 计划中最多的角色数 */
+#define CTL_LINE        1024        /* 控制连接一行的最大长度 */
+#define CTL_LEAD_MS     500         /* 发出启动命令到统一启动时刻的提前量 */
+#define CTL_READY_MS    5000        /* 等待server就绪或退出的超时 */
+#define CTL_SYNC        8           /* 时钟偏差测量次数, 取往返最短的一次 */
+
+/**
+一个角色的统计, 多个连接累加, 延时取各连接中的最大值.
+*/
+typedef struct Result_s
+{
+    char role[32];
+    uint64_t messages;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t ns;                /* 运行时间 */
+    uint64_t p50;               /* 以下单位ns */
+    uint64_t p99;
+    uint64_t max;
+} Result_t;
+
+typedef int (*Role_t)(int argc, char *argv[]);
+
+int ctl_agent(void);
+void ctl_ready(void);
+void ctl_result(const char *role, uint64_t messages, uint64_t bytes, uint64_t errors, uint64_t ns,
+                const Hist_t *pHist);
+int agent_run(int port, Role_t role, const char *name);
+int ctl_run(const char *plan);
+
+#endif
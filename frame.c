@@ -0,0 +1,423 @@
+/**
+    @file       frame.c
+    @brief      长度前缀消息分帧
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       每条消息前加4字节网络字节序长度. 接收端在缓冲中原地解析,
+                一次recv可解析出多条消息; 发送端用writev一次发送多条消息.
+                消息长度可按固定, 均匀或录制的分布产生.
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "sys/socket.h"
+#include "arpa/inet.h"
+
+#include "frame.h"
+#include "capture.h"
+
+#define DIST_SEED       0x9E3779B97F4A7C15ULL
+
+/**
+    @fn         void frame_init(Frame_t *pFrame, unsigned char *buffer, uint32_t size)
+    @brief      初始化接收解析器
+    @author     agent
+    @param[in]  pFrame      Frame_t*    解析器
+    @param[in]  buffer      char*       接收缓冲
+    @param[in]  size        uint32_t    缓冲长度, 至少两条最大消息
+*/
+void frame_init(Frame_t *pFrame, unsigned char *buffer, uint32_t size)
+{
+    memset(pFrame, 0x00, sizeof(Frame_t));
+    pFrame->buffer = buffer;
+    pFrame->size = size;
+}
+
+/**
+    @fn         int frame_recv(Frame_t *pFrame, int fd, int flags)
+    @brief      接收数据追加到未解析数据之后
+    @author     agent
+    @param[in]  pFrame      Frame_t*    解析器
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  flags       int         recv的flags
+    @retval     >0 接收的字节数
+    @retval     0 对端关闭
+    @retval     -1 失败, 消息超长时errno为EMSGSIZE
+    @note       缓冲尾部放不下一条最大消息时, 把剩下的不完整消息搬到开头,
+                搬运的只是一条消息的一部分, 完整的消息都是原地解析的.
+*/
+int frame_recv(Frame_t *pFrame, int fd, int flags)
+{
+    int ret = 0;
+    uint32_t length = 0;
+
+    if (pFrame->tail - pFrame->head >= FRAME_HEAD)
+    {
+        memcpy(&length, pFrame->buffer + pFrame->head, FRAME_HEAD);
+        if (ntohl(length) > FRAME_MAX)
+        {
+            errno = EMSGSIZE;
+            return -1;
+        }
+    }
+
+    if (pFrame->head == pFrame->tail)
+    {
+        pFrame->head = 0;
+        pFrame->tail = 0;
+    }
+    else if (pFrame->size - pFrame->tail < FRAME_HEAD + FRAME_MAX)
+    {
+        memmove(pFrame->buffer, pFrame->buffer + pFrame->head, pFrame->tail - pFrame->head);
+        pFrame->tail -= pFrame->head;
+        pFrame->head = 0;
+        pFrame->moves++;
+    }
+
+    ret = recv(fd, pFrame->buffer + pFrame->tail, pFrame->size - pFrame->tail, flags);
+    if (ret > 0)
+    {
+        pFrame->tail += ret;
+        pFrame->recvs++;
+    }
+
+    return ret;
+}
+
+/**
+    @fn         unsigned char *frame_next(Frame_t *pFrame, uint32_t *pLength)
+    @brief      取出下一条完整消息
+    @author     agent
+    @param[in]  pFrame      Frame_t*    解析器
+    @param[out] pLength     uint32_t*   消息长度
+    @retval     消息内容, 指向接收缓冲
+    @retval     NULL 没有完整消息
+*/
+unsigned char *frame_next(Frame_t *pFrame, uint32_t *pLength)
+{
+    uint32_t length = 0;
+    unsigned char *data = NULL;
+
+    if (pFrame->tail - pFrame->head < FRAME_HEAD)
+    {
+        return NULL;
+    }
+
+    memcpy(&length, pFrame->buffer + pFrame->head, FRAME_HEAD);
+    length = ntohl(length);
+    if ((length > FRAME_MAX) || (pFrame->tail - pFrame->head - FRAME_HEAD < length))
+    {
+        return NULL;
+    }
+
+    data = pFrame->buffer + pFrame->head + FRAME_HEAD;
+    pFrame->head += FRAME_HEAD + length;
+    pFrame->frames++;
+    pFrame->bytes += length;
+    *pLength = length;
+
+    return data;
+}
+
+/**
+    @fn         void frame_batch_init(FrameBatch_t *pBatch)
+    @brief      初始化发送批次
+    @author     agent
+    @param[in]  pBatch      FrameBatch_t*   发送批次
+*/
+void frame_batch_init(FrameBatch_t *pBatch)
+{
+    memset(pBatch, 0x00, sizeof(FrameBatch_t));
+}
+
+/**
+    @fn         int frame_add(FrameBatch_t *pBatch, const void *data, uint32_t length)
+    @brief      向批次中加入一条消息
+    @author     agent
+    @param[in]  pBatch      FrameBatch_t*   发送批次
+    @param[in]  data        void*       消息内容, 发送完之前不能修改
+    @param[in]  length      uint32_t    消息长度
+    @retval     0 成功
+    @retval     -1 批次已满, 需要先frame_flush
+*/
+int frame_add(FrameBatch_t *pBatch, const void *data, uint32_t length)
+{
+    if (pBatch->count + 2 > FRAME_IOV)
+    {
+        return -1;
+    }
+
+    pBatch->prefix[pBatch->count / 2] = htonl(length);
+    pBatch->iov[pBatch->count].iov_base = &pBatch->prefix[pBatch->count / 2];
+    pBatch->iov[pBatch->count].iov_len = FRAME_HEAD;
+    pBatch->iov[pBatch->count + 1].iov_base = (void *)data;
+    pBatch->iov[pBatch->count + 1].iov_len = length;
+    pBatch->count += 2;
+    pBatch->frames++;
+
+    return 0;
+}
+
+/**
+    @fn         int frame_flush(FrameBatch_t *pBatch, int fd)
+    @brief      用writev发送批次中的消息
+    @author     agent
+    @param[in]  pBatch      FrameBatch_t*   发送批次
+    @param[in]  fd          int         已连接的套接字
+    @retval     1 全部发完, 批次已清空
+    @retval     0 非阻塞套接字发送缓冲满, 剩余部分下次再发
+    @retval     -1 失败
+    @note       writev可能只发送一部分, 已发送的iovec跳过, 发了一半的调整起始位置.
+*/
+int frame_flush(FrameBatch_t *pBatch, int fd)
+{
+    ssize_t ret = 0;
+
+    while (pBatch->index < pBatch->count)
+    {
+        ret = writev(fd, &pBatch->iov[pBatch->index], pBatch->count - pBatch->index);
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+        }
+        pBatch->writes++;
+
+        while ((pBatch->index < pBatch->count) && (ret >= (ssize_t)pBatch->iov[pBatch->index].iov_len))
+        {
+            ret -= pBatch->iov[pBatch->index].iov_len;
+            pBatch->index++;
+        }
+
+        if (ret > 0)
+        {
+            pBatch->iov[pBatch->index].iov_base = (char *)pBatch->iov[pBatch->index].iov_base + ret;
+            pBatch->iov[pBatch->index].iov_len -= ret;
+        }
+    }
+
+    pBatch->count = 0;
+    pBatch->index = 0;
+
+    return 1;
+}
+
+/**
+    @fn         static uint32_t dist_clamp(unsigned long size)
+    @brief      把消息长度限制在[1, FRAME_MAX]
+    @author     agent
+    @param[in]  size        unsigned long   长度
+    @retval     限制后的长度
+*/
+static uint32_t dist_clamp(unsigned long size)
+{
+    if (size < 1) return 1;
+    if (size > FRAME_MAX) return FRAME_MAX;
+
+    return size;
+}
+
+/**
+    @fn         static int dist_record(Dist_t *pDist, uint32_t size)
+    @brief      追加一个录制的长度
+    @author     agent
+    @param[in]  pDist       Dist_t*     长度分布
+    @param[in]  size        uint32_t    长度
+    @retval     0 成功
+    @retval     -1 内存不足
+    @note       只在启动加载时调用, 容量按倍数增长.
+*/
+static int dist_record(Dist_t *pDist, uint32_t size)
+{
+    uint32_t *sizes = NULL;
+
+    /* 从1024开始, 个数到2的幂时扩大一倍 */
+    if ((pDist->count == 0) || ((pDist->count >= 1024) && ((pDist->count & (pDist->count - 1)) == 0)))
+    {
+        sizes = realloc(pDist->sizes, (pDist->count ? pDist->count * 2 : 1024) * sizeof(uint32_t));
+        if (sizes == NULL)
+        {
+            printf("realloc failed!%d\n", errno);
+            return -1;
+        }
+        pDist->sizes = sizes;
+    }
+
+    size = dist_clamp(size);
+    pDist->sizes[pDist->count++] = size;
+    if (size < pDist->min) pDist->min = size;
+    if (size > pDist->max) pDist->max = size;
+
+    return 0;
+}
+
+/**
+    @fn         int dist_parse(Dist_t *pDist, const char *spec)
+    @brief      解析消息长度分布
+    @author     agent
+    @param[in]  pDist       Dist_t*     长度分布
+    @param[in]  spec        char*       分布描述
+    @retval     0 成功
+    @retval     -1 失败
+    @note       fixed:256 或 256         固定长度
+                uniform:64-4096          均匀分布
+                file:sizes.txt           每行一个长度, 例如从生产日志统计得到
+                cap:field.cap            抓包文件中每条记录的长度
+                录制的长度按随机顺序抽样, 长度限制在[1, FRAME_MAX].
+*/
+int dist_parse(Dist_t *pDist, const char *spec)
+{
+    int ret = 0;
+    FILE *file = NULL;
+    unsigned long size = 0;
+    Capture_t capture;
+    CaptureRecord_t *record = NULL;
+
+    memset(pDist, 0x00, sizeof(Dist_t));
+    pDist->seed = DIST_SEED;
+
+    if (strncmp(spec, "uniform:", 8) == 0)
+    {
+        pDist->type = DIST_UNIFORM;
+        if (sscanf(spec + 8, "%u-%u", &pDist->min, &pDist->max) != 2)
+        {
+            printf("bad distribution %s!\n", spec);
+            return -1;
+        }
+        pDist->min = dist_clamp(pDist->min);
+        pDist->max = dist_clamp(pDist->max);
+        if (pDist->max < pDist->min) pDist->max = pDist->min;
+        return 0;
+    }
+
+    if ((strncmp(spec, "file:", 5) == 0) || (strncmp(spec, "cap:", 4) == 0))
+    {
+        pDist->type = DIST_RECORDED;
+        pDist->min = UINT32_MAX;
+
+        if (spec[0] == 'c')
+        {
+            if (capture_load(&capture, spec + 4) != 0)
+            {
+                return -1;
+            }
+            while ((ret == 0) && ((record = capture_next(&capture)) != NULL))
+            {
+                ret = dist_record(pDist, record->length);
+            }
+            capture_close(&capture);
+        }
+        else
+        {
+            file = fopen(spec + 5, "r");
+            if (file == NULL)
+            {
+                printf("open %s failed!%d\n", spec + 5, errno);
+                return -1;
+            }
+            while ((ret == 0) && (fscanf(file, "%lu", &size) == 1))
+            {
+                ret = dist_record(pDist, size);
+            }
+            fclose(file);
+        }
+
+        if ((ret != 0) || (pDist->count == 0))
+        {
+            printf("no sizes in %s!\n", spec);
+            dist_free(pDist);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (strncmp(spec, "fixed:", 6) == 0)
+    {
+        spec += 6;
+    }
+    pDist->type = DIST_FIXED;
+    pDist->min = dist_clamp(strtoul(spec, NULL, 10));
+    pDist->max = pDist->min;
+
+    return 0;
+}
+
+/**
+    @fn         uint32_t dist_next(Dist_t *pDist)
+    @brief      产生下一个消息长度
+    @author     agent
+    @param[in]  pDist       Dist_t*     长度分布
+    @retval     消息长度
+    @note       xorshift64*随机数, 每条消息只需几条指令.
+*/
+uint32_t dist_next(Dist_t *pDist)
+{
+    uint64_t random = 0;
+
+    if (pDist->type == DIST_FIXED)
+    {
+        return pDist->min;
+    }
+
+    pDist->seed ^= pDist->seed >> 12;
+    pDist->seed ^= pDist->seed << 25;
+    pDist->seed ^= pDist->seed >> 27;
+    random = (pDist->seed * 0x2545F4914F6CDD1DULL) >> 32;
+
+    if (pDist->type == DIST_UNIFORM)
+    {
+        return pDist->min + random % (pDist->max - pDist->min + 1);
+    }
+
+    return pDist->sizes[random % pDist->count];
+}
+
+/**
+    @fn         void dist_print(const Dist_t *pDist)
+    @brief      打印消息长度分布
+    @author     agent
+    @param[in]  pDist       Dist_t*     长度分布
+*/
+void dist_print(const Dist_t *pDist)
+{
+    uint32_t i = 0;
+    uint64_t sum = 0;
+
+    switch (pDist->type)
+    {
+    case DIST_FIXED:
+        printf("size: fixed %u\n", pDist->min);
+        break;
+    case DIST_UNIFORM:
+        printf("size: uniform %u-%u\n", pDist->min, pDist->max);
+        break;
+    default:
+        for (i = 0; i < pDist->count; i++)
+        {
+            sum += pDist->sizes[i];
+        }
+        printf("size: recorded %u sizes min=%u avg=%.1f max=%u\n", pDist->count, pDist->min,
+               (double)sum / pDist->count, pDist->max);
+        break;
+    }
+}
+
+/**
+    @fn         void dist_free(Dist_t *pDist)
+    @brief      释放录制的长度
+    @author     agent
+    @param[in]  pDist       Dist_t*     长度分布
+*/
+void dist_free(Dist_t *pDist)
+{
+    free(pDist->sizes);
+    pDist->sizes = NULL;
+    pDist->count = 0;
+}
@@ -0,0 +1,84 @@
+/**
+    @file       frame.h
+    @brief      长度前缀消息分帧
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       每条消息前加4字节网络字节序长度. 接收端在缓冲中原地解析,
+                一次recv可解析出多条消息; 发送端用writev一次发送多条消息.
+                消息长度可按固定, 均匀或录制的分布产生.
+*/
+
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#include "stdint.h"
+#include "sys/uio.h"
+
+#define FRAME_HEAD      4           /* 长度前缀字节数 */
+#define FRAME_MAX       65536       /* 最大消息长度 */
+#define FRAME_IOV       128         /* 每次writev的iovec个数, 每条消息占两个 */
+
+/**
+接收解析器. [head, tail)为缓冲中未解析的数据,
+消息指针直接指向缓冲, 下一次frame_recv前必须处理完.
+*/
+typedef struct Frame_s
+{
+    unsigned char *buffer;
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+    uint64_t recvs;
+    uint64_t frames;
+    uint64_t bytes;             /* 消息长度之和, 不含长度前缀 */
+    uint64_t moves;             /* 不完整消息搬到缓冲开头的次数 */
+} Frame_t;
+
+/**
+发送批次. 长度前缀存放在prefix中, 消息内容不拷贝.
+*/
+typedef struct FrameBatch_s
+{
+    struct iovec iov[FRAME_IOV];
+    uint32_t prefix[FRAME_IOV / 2];
+    int count;                  /* 已填入的iovec个数 */
+    int index;                  /* 第一个未发完的iovec */
+    uint64_t writes;
+    uint64_t frames;
+} FrameBatch_t;
+
+enum
+{
+    DIST_FIXED = 0,
+    DIST_UNIFORM,
+    DIST_RECORDED,
+};
+
+/**
+消息长度分布. 复制一份结构体即可得到相同的长度序列,
+接收端据此校验回应的长度.
+*/
+typedef struct Dist_s
+{
+    int type;
+    uint32_t min;
+    uint32_t max;
+    uint32_t count;             /* 录制的长度个数 */
+    uint32_t *sizes;
+    uint64_t seed;
+} Dist_t;
+
+void frame_init(Frame_t *pFrame, unsigned char *buffer, uint32_t size);
+int frame_recv(Frame_t *pFrame, int fd, int flags);
+unsigned char *frame_next(Frame_t *pFrame, uint32_t *pLength);
+void frame_batch_init(FrameBatch_t *pBatch);
+int frame_add(FrameBatch_t *pBatch, const void *data, uint32_t length);
+int frame_flush(FrameBatch_t *pBatch, int fd);
+int dist_parse(Dist_t *pDist, const char *spec);
+uint32_t dist_next(Dist_t *pDist);
+void dist_print(const Dist_t *pDist);
+void dist_free(Dist_t *pDist);
+
+#endif
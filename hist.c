@@ -0,0 +1,162 @@
+/**
+    @file       hist.c
+    @brief      延时统计直方图
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       以2的幂划分桶的直方图, 各测试程序共用
+*/
+
+#include "stdio.h"
+#include "string.h"
+
+#include "hist.h"
+
+/**
+    @fn         uint64_t clock_ns(clockid_t id)
+    @brief      读取指定时钟
+    @author     agent
+    @param[in]  id          clockid_t   时钟类型
+    @retval     时钟值, 单位ns
+    @note       内核软件时间戳使用CLOCK_REALTIME, 比较时须用同一时钟.
+*/
+uint64_t clock_ns(clockid_t id)
+{
+    struct timespec ts;
+
+    clock_gettime(id, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+    @fn         void hist_init(Hist_t *pHist, const char *name)
+    @brief      初始化直方图
+    @author     agent
+    @param[in]  pHist       Hist_t*     直方图
+    @param[in]  name        char*       打印时显示的名称
+*/
+void hist_init(Hist_t *pHist, const char *name)
+{
+    memset(pHist, 0x00, sizeof(Hist_t));
+    pHist->name = name;
+    pHist->min = UINT64_MAX;
+}
+
+/**
+    @fn         void hist_add(Hist_t *pHist, int64_t ns)
+    @brief      添加一个样本
+    @author     agent
+    @param[in]  pHist       Hist_t*     直方图
+    @param[in]  ns          int64_t     样本值, 单位ns
+    @note       负值只计数, 不进入桶.
+*/
+void hist_add(Hist_t *pHist, int64_t ns)
+{
+    int i = 0;
+    uint64_t value = 0;
+
+    if (ns < 0)
+    {
+        pHist->negative++;
+        return;
+    }
+
+    value = (uint64_t)ns;
+    for (i = 0; (i < HIST_BUCKETS - 1) && ((value >> (i + 1)) != 0); i++)
+    {
+    }
+
+    pHist->bucket[i]++;
+    pHist->count++;
+    pHist->sum += value;
+    if (value < pHist->min) pHist->min = value;
+    if (value > pHist->max) pHist->max = value;
+}
+
+/**
+    @fn         uint64_t hist_percentile(const Hist_t *pHist, double percent)
+    @brief      估算百分位值
+    @author     agent
+    @param[in]  pHist       Hist_t*     直方图
+    @param[in]  percent     double      百分位, 例如99.9
+    @retval     所在桶的上界, 单位ns
+*/
+uint64_t hist_percentile(const Hist_t *pHist, double percent)
+{
+    int i = 0;
+    uint64_t seen = 0;
+    uint64_t target = 0;
+
+    if (pHist->count == 0)
+    {
+        return 0;
+    }
+
+    target = (uint64_t)(pHist->count * percent / 100.0);
+    if (target == 0) target = 1;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += pHist->bucket[i];
+        if (seen >= target)
+        {
+            break;
+        }
+    }
+
+    if (i >= HIST_BUCKETS - 1)
+    {
+        return pHist->max;
+    }
+
+    return (2ULL << i) < pHist->max ? (2ULL << i) : pHist->max;
+}
+
+/**
+    @fn         void hist_print(const Hist_t *pHist)
+    @brief      打印直方图
+    @author     agent
+    @param[in]  pHist       Hist_t*     直方图
+    @note       只打印非空的桶, 每个桶用#号长度表示占比.
+*/
+void hist_print(const Hist_t *pHist)
+{
+    int i = 0;
+    int j = 0;
+    int width = 0;
+
+    printf("%s: count=%llu", pHist->name, (unsigned long long)pHist->count);
+    if (pHist->negative)
+    {
+        printf(" negative=%llu", (unsigned long long)pHist->negative);
+    }
+    if (pHist->count == 0)
+    {
+        printf("\n");
+        return;
+    }
+
+    printf(" min=%.3fus avg=%.3fus max=%.3fus p50=%.3fus p99=%.3fus p99.9=%.3fus\n",
+           pHist->min / 1000.0, (double)pHist->sum / pHist->count / 1000.0, pHist->max / 1000.0,
+           hist_percentile(pHist, 50) / 1000.0, hist_percentile(pHist, 99) / 1000.0,
+           hist_percentile(pHist, 99.9) / 1000.0);
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        if (pHist->bucket[i] == 0)
+        {
+            continue;
+        }
+
+        printf("    %10.3fus ~ %10.3fus %10llu ", (i ? (1ULL << i) : 0) / 1000.0,
+               (2ULL << i) / 1000.0, (unsigned long long)pHist->bucket[i]);
+        width = (int)(pHist->bucket[i] * 50 / pHist->count);
+        for (j = 0; j < width; j++)
+        {
+            printf("#");
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,39 @@
+/**
+    @file       hist.h
+    @brief      延时统计直方图
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       以2的幂划分桶的直方图, 各测试程序共用
+*/
+
+#ifndef __HIST_H__
+#define __HIST_H__
+
+#include "stdint.h"
+#include "time.h"
+
+#define HIST_BUCKETS    40      /* 2^40 ns 约18分钟, 足够覆盖所有延时 */
+
+/**
+直方图结构体, 第i个桶统计[2^i, 2^(i+1)) ns范围内的样本.
+*/
+typedef struct Hist_s
+{
+    const char *name;
+    uint64_t count;
+    uint64_t negative;          /* 不同时钟域相减可能出现负值 */
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t bucket[HIST_BUCKETS];
+} Hist_t;
+
+uint64_t clock_ns(clockid_t id);
+void hist_init(Hist_t *pHist, const char *name);
+void hist_add(Hist_t *pHist, int64_t ns);
+uint64_t hist_percentile(const Hist_t *pHist, double percent);
+void hist_print(const Hist_t *pHist);
+
+#endif
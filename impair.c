@@ -0,0 +1,571 @@
+/**
+    @file       impair.c
+    @brief      网络损伤模拟
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       时间轮每格IMPAIR_TICK, 每格一个先进先出链表. 到期的槽从当前格取出,
+                超过一圈的槽留在格中等下一圈. 槽从缓冲池分配, 转发过程中不调用malloc.
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+
+#include "arpa/inet.h"
+
+#include "impair.h"
+
+#define IMPAIR_SEED     0x9E3779B97F4A7C15ULL
+#define IMPAIR_GAP      1000000     /* 乱序包默认额外延时1ms */
+
+/**
+    @fn         static double impair_random(Impair_t *pImpair)
+    @brief      产生[0, 1)的随机数
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @retval     随机数
+*/
+static double impair_random(Impair_t *pImpair)
+{
+    pImpair->seed ^= pImpair->seed >> 12;
+    pImpair->seed ^= pImpair->seed << 25;
+    pImpair->seed ^= pImpair->seed >> 27;
+
+    return ((pImpair->seed * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+    @fn         static int impair_time(const char *value, uint64_t *pTime)
+    @brief      解析时间
+    @author     agent
+    @param[in]  value       char*       数值, 后缀ns/us/ms/s, 默认ms
+    @param[out] pTime       uint64_t*   时间, 单位ns
+    @retval     0 成功
+    @retval     -1 失败
+*/
+static int impair_time(const char *value, uint64_t *pTime)
+{
+    char *end = NULL;
+    double number = strtod(value, &end);
+
+    if ((end == value) || (number < 0))
+    {
+        return -1;
+    }
+
+    if (strcmp(end, "ns") == 0)
+    {
+        *pTime = number;
+    }
+    else if (strcmp(end, "us") == 0)
+    {
+        *pTime = number * 1e3;
+    }
+    else if ((strcmp(end, "ms") == 0) || (*end == '\0'))
+    {
+        *pTime = number * 1e6;
+    }
+    else if (strcmp(end, "s") == 0)
+    {
+        *pTime = number * 1e9;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int impair_percent(const char *value, double *pRatio)
+    @brief      解析百分比
+    @author     agent
+    @param[in]  value       char*       数值, 可带%
+    @param[out] pRatio      double*     概率, 0~1
+    @retval     0 成功
+    @retval     -1 失败
+*/
+static int impair_percent(const char *value, double *pRatio)
+{
+    char *end = NULL;
+    double number = strtod(value, &end);
+
+    if ((end == value) || (number < 0) || (number > 100) || ((*end != '\0') && (strcmp(end, "%") != 0)))
+    {
+        return -1;
+    }
+
+    *pRatio = number / 100;
+    return 0;
+}
+
+/**
+    @fn         static int impair_rate(const char *value, uint64_t *pRate)
+    @brief      解析带宽
+    @author     agent
+    @param[in]  value       char*       数值, 后缀k/M/G, 单位bit/s
+    @param[out] pRate       uint64_t*   带宽, 单位bps
+    @retval     0 成功
+    @retval     -1 失败
+*/
+static int impair_rate(const char *value, uint64_t *pRate)
+{
+    char *end = NULL;
+    double number = strtod(value, &end);
+
+    if ((end == value) || (number < 0))
+    {
+        return -1;
+    }
+
+    switch (*end)
+    {
+    case 'k':
+    case 'K':
+        number *= 1e3;
+        end++;
+        break;
+    case 'm':
+    case 'M':
+        number *= 1e6;
+        end++;
+        break;
+    case 'g':
+    case 'G':
+        number *= 1e9;
+        end++;
+        break;
+    default:
+        break;
+    }
+
+    if ((*end != '\0') && (strcmp(end, "bps") != 0) && (strcmp(end, "bit") != 0))
+    {
+        return -1;
+    }
+
+    *pRate = number;
+    return 0;
+}
+
+/**
+    @fn         int impair_init(Impair_t *pImpair, const char *spec, int stream)
+    @brief      解析损伤参数并分配时间轮和槽
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @param[in]  spec        char*       参数, 例如delay=20ms,jitter=2ms,loss=1%,dup=0.1%,reorder=1%,gap=2ms,rate=10M
+    @param[in]  stream      int         tcp字节流
+    @retval     0 成功
+    @retval     -1 失败
+    @note       字节流只能延时, 抖动和限速, 丢包, 重复和乱序忽略;
+                抖动不会让同方向的数据越过前面的数据.
+*/
+int impair_init(Impair_t *pImpair, const char *spec, int stream)
+{
+    int ret = 0;
+    char text[256];
+    char *item = NULL;
+    char *value = NULL;
+    char *save = NULL;
+    struct timespec ts;
+
+    memset(pImpair, 0x00, sizeof(Impair_t));
+    pImpair->gap = IMPAIR_GAP;
+    pImpair->stream = stream;
+
+    snprintf(text, sizeof(text), "%s", spec);
+    for (item = strtok_r(text, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+    {
+        value = strchr(item, '=');
+        if (value == NULL)
+        {
+            printf("bad impairment %s!\n", item);
+            return -1;
+        }
+        *value++ = '\0';
+
+        if (strcmp(item, "delay") == 0)
+        {
+            ret = impair_time(value, &pImpair->delay);
+        }
+        else if (strcmp(item, "jitter") == 0)
+        {
+            ret = impair_time(value, &pImpair->jitter);
+        }
+        else if (strcmp(item, "gap") == 0)
+        {
+            ret = impair_time(value, &pImpair->gap);
+        }
+        else if (strcmp(item, "loss") == 0)
+        {
+            ret = impair_percent(value, &pImpair->loss);
+        }
+        else if (strcmp(item, "dup") == 0)
+        {
+            ret = impair_percent(value, &pImpair->dup);
+        }
+        else if (strcmp(item, "reorder") == 0)
+        {
+            ret = impair_percent(value, &pImpair->reorder);
+        }
+        else if (strcmp(item, "rate") == 0)
+        {
+            ret = impair_rate(value, &pImpair->rate);
+        }
+        else
+        {
+            ret = -1;
+        }
+
+        if (ret != 0)
+        {
+            printf("bad impairment %s=%s!\n", item, value);
+            return -1;
+        }
+    }
+
+    if (stream && ((pImpair->loss > 0) || (pImpair->dup > 0) || (pImpair->reorder > 0)))
+    {
+        printf("loss, dup and reorder are ignored on a byte stream\n");
+        pImpair->loss = 0;
+        pImpair->dup = 0;
+        pImpair->reorder = 0;
+    }
+
+    pImpair->head = calloc(IMPAIR_WHEEL, sizeof(Slot_t *));
+    pImpair->tail = calloc(IMPAIR_WHEEL, sizeof(Slot_t *));
+    if ((pImpair->head == NULL) || (pImpair->tail == NULL))
+    {
+        printf("calloc failed!%d\n", errno);
+        impair_destroy(pImpair);
+        return -1;
+    }
+
+    if (pool_init(&pImpair->pool, sizeof(Slot_t) + IMPAIR_SIZE, IMPAIR_SLOTS, 0) != 0)
+    {
+        impair_destroy(pImpair);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    pImpair->seed = IMPAIR_SEED ^ ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+    pImpair->cursor = ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec) / IMPAIR_TICK;
+
+    printf("impair: delay %.3fms jitter %.3fms loss %.2f%% dup %.2f%% reorder %.2f%% gap %.3fms rate %llubps\n",
+           pImpair->delay / 1e6, pImpair->jitter / 1e6, pImpair->loss * 100, pImpair->dup * 100,
+           pImpair->reorder * 100, pImpair->gap / 1e6, (unsigned long long)pImpair->rate);
+
+    return 0;
+}
+
+/**
+    @fn         Slot_t *impair_alloc(Impair_t *pImpair)
+    @brief      分配一个槽
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @retval     槽, 数据区长度IMPAIR_SIZE
+    @retval     NULL 槽用完, 丢弃数据时由调用者计入overflows
+*/
+Slot_t *impair_alloc(Impair_t *pImpair)
+{
+    return pool_get(&pImpair->pool);
+}
+
+/**
+    @fn         void impair_free(Impair_t *pImpair, Slot_t *pSlot)
+    @brief      释放槽
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @param[in]  pSlot       Slot_t*     槽
+*/
+void impair_free(Impair_t *pImpair, Slot_t *pSlot)
+{
+    pool_put(&pImpair->pool, pSlot);
+}
+
+/**
+    @fn         static void impair_insert(Impair_t *pImpair, Slot_t *pSlot)
+    @brief      按发送时间把槽挂到时间轮上
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @param[in]  pSlot       Slot_t*     槽
+    @note       同一格内先进先出, 同时到期的包保持到达的顺序.
+*/
+static void impair_insert(Impair_t *pImpair, Slot_t *pSlot)
+{
+    uint64_t tick = pSlot->due / IMPAIR_TICK;
+    uint32_t index = 0;
+
+    if (tick < pImpair->cursor)
+    {
+        tick = pImpair->cursor;
+    }
+    index = tick % IMPAIR_WHEEL;
+
+    pSlot->next = NULL;
+    if (pImpair->tail[index] == NULL)
+    {
+        pImpair->head[index] = pSlot;
+    }
+    else
+    {
+        pImpair->tail[index]->next = pSlot;
+    }
+    pImpair->tail[index] = pSlot;
+    pImpair->queued++;
+}
+
+/**
+    @fn         void impair_submit(Impair_t *pImpair, Slot_t *pSlot, uint64_t now)
+    @brief      提交收到的包, 计算发送时间
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @param[in]  pSlot       Slot_t*     槽, length和tag已填好, tag为0或1表示方向
+    @param[in]  now         uint64_t    当前时间, CLOCK_MONOTONIC
+    @note       顺序为丢包, 限速排队, 延时和抖动, 乱序, 重复.
+                限速按包长计算链路忙的时间, 超过带宽的包在链路上排队, 和真实瓶颈一样增加延时.
+*/
+void impair_submit(Impair_t *pImpair, Slot_t *pSlot, uint64_t now)
+{
+    int direction = pSlot->tag & 1;
+    uint64_t due = now;
+    int64_t jitter = 0;
+    Slot_t *pCopy = NULL;
+
+    pImpair->received++;
+
+    if ((pImpair->loss > 0) && (impair_random(pImpair) < pImpair->loss))
+    {
+        pImpair->lost++;
+        impair_free(pImpair, pSlot);
+        return;
+    }
+
+    if (pImpair->rate > 0)
+    {
+        if (pImpair->link[direction] < now)
+        {
+            pImpair->link[direction] = now;
+        }
+        pImpair->link[direction] += (uint64_t)pSlot->length * 8 * 1000000000ULL / pImpair->rate;
+        due = pImpair->link[direction];
+    }
+
+    due += pImpair->delay;
+    if (pImpair->jitter > 0)
+    {
+        jitter = (impair_random(pImpair) * 2 - 1) * pImpair->jitter;
+        due = ((jitter < 0) && ((uint64_t)-jitter > due - now)) ? now : due + jitter;
+    }
+
+    if ((pImpair->reorder > 0) && (impair_random(pImpair) < pImpair->reorder))
+    {
+        due += pImpair->gap;
+        pImpair->reordered++;
+    }
+
+    if (pImpair->stream)
+    {
+        if (due < pImpair->last[direction])
+        {
+            due = pImpair->last[direction];
+        }
+        pImpair->last[direction] = due;
+    }
+    pSlot->due = due;
+
+    if ((pImpair->dup > 0) && (impair_random(pImpair) < pImpair->dup))
+    {
+        pCopy = impair_alloc(pImpair);
+        if (pCopy != NULL)
+        {
+            pCopy->due = due;
+            pCopy->length = pSlot->length;
+            pCopy->tag = pSlot->tag;
+            memcpy(pCopy->data, pSlot->data, pSlot->length);
+            impair_insert(pImpair, pSlot);
+            pSlot = pCopy;
+            pImpair->duplicated++;
+        }
+        else
+        {
+            pImpair->overflows++;
+        }
+    }
+
+    impair_insert(pImpair, pSlot);
+}
+
+/**
+    @fn         Slot_t *impair_due(Impair_t *pImpair, uint64_t now)
+    @brief      取出一个到期的槽
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @param[in]  now         uint64_t    当前时间, CLOCK_MONOTONIC
+    @retval     槽, 发送后调用impair_free释放
+    @retval     NULL 没有到期的槽
+    @note       游标停在当前格, 当前格中还没到期的槽下次再检查.
+*/
+Slot_t *impair_due(Impair_t *pImpair, uint64_t now)
+{
+    uint64_t tick = now / IMPAIR_TICK;
+    uint32_t index = 0;
+    Slot_t *pSlot = NULL;
+    Slot_t *pPrev = NULL;
+
+    if (pImpair->queued == 0)
+    {
+        pImpair->cursor = tick;
+        return NULL;
+    }
+
+    /* 落后超过一圈时每格只需检查一次 */
+    if (tick > pImpair->cursor + IMPAIR_WHEEL)
+    {
+        pImpair->cursor = tick - IMPAIR_WHEEL;
+    }
+
+    for (;;)
+    {
+        index = pImpair->cursor % IMPAIR_WHEEL;
+        for (pPrev = NULL, pSlot = pImpair->head[index]; pSlot != NULL; pPrev = pSlot, pSlot = pSlot->next)
+        {
+            if (pSlot->due <= now)
+            {
+                if (pPrev == NULL)
+                {
+                    pImpair->head[index] = pSlot->next;
+                }
+                else
+                {
+                    pPrev->next = pSlot->next;
+                }
+                if (pImpair->tail[index] == pSlot)
+                {
+                    pImpair->tail[index] = pPrev;
+                }
+                pImpair->queued--;
+                pImpair->sent++;
+                return pSlot;
+            }
+        }
+
+        if (pImpair->cursor >= tick)
+        {
+            return NULL;
+        }
+        pImpair->cursor++;
+    }
+}
+
+/**
+    @fn         int64_t impair_wait(Impair_t *pImpair, uint64_t now)
+    @brief      计算到下一个槽到期的时间
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @param[in]  now         uint64_t    当前时间, CLOCK_MONOTONIC
+    @retval     等待时间, 单位ns, 0表示已有到期的槽
+    @retval     -1 没有排队的槽
+    @note       从游标向后找第一个本圈有槽的格, 属于以后几圈的槽只记下最早的时间.
+*/
+int64_t impair_wait(Impair_t *pImpair, uint64_t now)
+{
+    uint64_t i = 0;
+    uint64_t end = 0;
+    uint64_t earliest = UINT64_MAX;
+    Slot_t *pSlot = NULL;
+
+    if (pImpair->queued == 0)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < IMPAIR_WHEEL; i++)
+    {
+        end = (pImpair->cursor + i + 1) * IMPAIR_TICK;
+        for (pSlot = pImpair->head[(pImpair->cursor + i) % IMPAIR_WHEEL]; pSlot != NULL; pSlot = pSlot->next)
+        {
+            if (pSlot->due < earliest)
+            {
+                earliest = pSlot->due;
+            }
+        }
+        if (earliest < end)
+        {
+            break;
+        }
+    }
+
+    return (earliest > now) ? (int64_t)(earliest - now) : 0;
+}
+
+/**
+    @fn         int impair_addr(const char *text, struct sockaddr_in *pAddr)
+    @brief      解析代理目的地址
+    @author     agent
+    @param[in]  text        char*       地址, 例如127.0.0.1:8080
+    @param[out] pAddr       sockaddr_in* 目的地址
+    @retval     0 成功
+    @retval     -1 失败
+*/
+int impair_addr(const char *text, struct sockaddr_in *pAddr)
+{
+    char ip[64];
+    const char *colon = strrchr(text, ':');
+
+    if ((colon == NULL) || ((size_t)(colon - text) >= sizeof(ip)))
+    {
+        printf("bad target %s!\n", text);
+        return -1;
+    }
+
+    memcpy(ip, text, colon - text);
+    ip[colon - text] = '\0';
+
+    memset(pAddr, 0x00, sizeof(struct sockaddr_in));
+    pAddr->sin_family = AF_INET;
+    pAddr->sin_port = htons(strtoul(colon + 1, NULL, 10));
+    if (inet_pton(AF_INET, ip, &pAddr->sin_addr) != 1)
+    {
+        printf("bad target %s!\n", text);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         void impair_print(Impair_t *pImpair)
+    @brief      打印损伤统计
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+*/
+void impair_print(Impair_t *pImpair)
+{
+    printf("impair: received %llu sent %llu lost %llu duplicated %llu reordered %llu overflows %llu queued %u\n",
+           (unsigned long long)pImpair->received, (unsigned long long)pImpair->sent,
+           (unsigned long long)pImpair->lost, (unsigned long long)pImpair->duplicated,
+           (unsigned long long)pImpair->reordered, (unsigned long long)pImpair->overflows, pImpair->queued);
+    pool_print(&pImpair->pool);
+}
+
+/**
+    @fn         void impair_destroy(Impair_t *pImpair)
+    @brief      释放时间轮和槽
+    @author     agent
+    @param[in]  pImpair     Impair_t*   损伤参数
+    @note       排队中的槽随缓冲池一起释放.
+*/
+void impair_destroy(Impair_t *pImpair)
+{
+    free(pImpair->head);
+    free(pImpair->tail);
+    pImpair->head = NULL;
+    pImpair->tail = NULL;
+    pool_destroy(&pImpair->pool);
+}
@@ -0,0 +1,74 @@
+/**
+    @file       impair.h
+    @brief      网络损伤模拟
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       代理收到的数据放入预分配的槽, 按延时, 抖动, 丢包, 重复, 乱序和带宽限制
+                计算发送时间后挂到时间轮上, 到时间再发出. 不需要root和netem.
+*/
+
+#ifndef __IMPAIR_H__
+#define __IMPAIR_H__
+
+#include "stdint.h"
+
+#include "netinet/in.h"
+
+#include "bufpool.h"
+
+#define IMPAIR_TICK     10000       /* 时间轮精度10us */
+#define IMPAIR_WHEEL    65536       /* 时间轮格数, 一圈约655ms, 更长的延时转多圈 */
+#define IMPAIR_SLOTS    8192        /* 槽个数, 100kpps延时80ms时用满 */
+#define IMPAIR_SIZE     2048        /* 每个槽的数据长度 */
+
+/**
+槽, 后跟数据. tag由调用者使用, 例如区分转发方向.
+*/
+typedef struct Slot_s
+{
+    struct Slot_s *next;
+    uint64_t due;               /* 发送时间, CLOCK_MONOTONIC */
+    uint32_t length;
+    uint32_t tag;
+    unsigned char data[0];
+} Slot_t;
+
+typedef struct Impair_s
+{
+    uint64_t delay;             /* 以下时间单位ns */
+    uint64_t jitter;
+    uint64_t gap;               /* 乱序包额外延时 */
+    double loss;                /* 以下为概率, 0~1 */
+    double dup;
+    double reorder;
+    uint64_t rate;              /* 带宽, 单位bps, 0为不限 */
+    int stream;                 /* tcp字节流: 不丢包不重复, 同方向不乱序 */
+    uint64_t seed;
+    uint64_t link[2];           /* 每个方向链路空闲的时间 */
+    uint64_t last[2];           /* 每个方向最后一个包的发送时间 */
+    uint64_t cursor;            /* 时间轮当前格 */
+    uint32_t queued;
+    Slot_t **head;
+    Slot_t **tail;
+    Pool_t pool;
+    uint64_t received;
+    uint64_t sent;
+    uint64_t lost;
+    uint64_t duplicated;
+    uint64_t reordered;
+    uint64_t overflows;         /* 没有空闲槽 */
+} Impair_t;
+
+int impair_init(Impair_t *pImpair, const char *spec, int stream);
+Slot_t *impair_alloc(Impair_t *pImpair);
+void impair_free(Impair_t *pImpair, Slot_t *pSlot);
+void impair_submit(Impair_t *pImpair, Slot_t *pSlot, uint64_t now);
+Slot_t *impair_due(Impair_t *pImpair, uint64_t now);
+int64_t impair_wait(Impair_t *pImpair, uint64_t now);
+int impair_addr(const char *text, struct sockaddr_in *pAddr);
+void impair_print(Impair_t *pImpair);
+void impair_destroy(Impair_t *pImpair);
+
+#endif
@@ -0,0 +1,337 @@
+/**
+    @file       lowlat.c
+    @brief      低延时接收
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       busy poll, 用户态自旋, 按SO_INCOMING_CPU绑核, SCHED_FIFO, 以及CPU开销统计
+*/
+
+#define _GNU_SOURCE
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "string.h"
+#include "errno.h"
+#include "sched.h"
+
+#include "sys/mman.h"
+
+#include "hist.h"
+#include "lowlat.h"
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL     69  /* linux 5.11 */
+#endif
+
+/**
+    @fn         int lowlat_socket(int fd, int busy)
+    @brief      设置套接字为低延时接收
+    @author     agent
+    @param[in]  fd          int         套接字
+    @param[in]  busy        int         SO_BUSY_POLL时间, 单位us
+    @retval     0 成功
+    @retval     -1 失败
+    @note       busy poll需要CAP_NET_ADMIN才能设置大于sysctl的值, 失败只打印不退出,
+                套接字改为非阻塞, 由lowlat_recvfrom在用户态自旋.
+*/
+int lowlat_socket(int fd, int busy)
+{
+    int opt = 0;
+    int flags = 0;
+
+    opt = busy;
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, (char *)&opt, sizeof(opt)) != 0)
+    {
+        printf("setsockopt failed(SO_BUSY_POLL)!%d\n", errno);
+    }
+
+    opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, (char *)&opt, sizeof(opt)) != 0)
+    {
+        printf("setsockopt failed(SO_PREFER_BUSY_POLL)!%d\n", errno);
+    }
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1))
+    {
+        printf("fcntl failed(O_NONBLOCK)!%d\n", errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int lowlat_cpulist(int cpu, const char *name, cpu_set_t *pSet)
+    @brief      读取CPU拓扑中的CPU列表
+    @author     agent
+    @param[in]  cpu         int         CPU编号
+    @param[in]  name        char*       topology下的文件名, 如thread_siblings_list
+    @param[out] pSet        cpu_set_t*  列表中的CPU, 格式如0-3,8
+    @retval     0 成功
+    @retval     -1 失败
+*/
+static int lowlat_cpulist(int cpu, const char *name, cpu_set_t *pSet)
+{
+    char path[128];
+    char text[256];
+    char *p = text;
+    char *end = NULL;
+    long first = 0;
+    long last = 0;
+    FILE *fp = NULL;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    if (fgets(text, sizeof(text), fp) == NULL)
+    {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    CPU_ZERO(pSet);
+    while (*p != '\0')
+    {
+        first = strtol(p, &end, 10);
+        if (end == p)
+        {
+            break;
+        }
+        last = first;
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (; (first <= last) && (first < CPU_SETSIZE); first++)
+        {
+            CPU_SET(first, pSet);
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int lowlat_sibling(int cpu)
+    @brief      选择和cpu相邻的另一个CPU
+    @author     agent
+    @param[in]  cpu         int         要避开的CPU
+    @retval     >=0 选中的CPU
+    @retval     -1 没有其他可用的CPU
+    @note       依次选同一物理核的超线程, 同一封装的其他核, 当前亲和性中的任意其他CPU,
+                都必须在当前亲和性掩码中.
+*/
+static int lowlat_sibling(int cpu)
+{
+    static const char *s_level[] = {"thread_siblings_list", "core_siblings_list"};
+    cpu_set_t allowed;
+    cpu_set_t set;
+    int i = 0;
+    int j = 0;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < sizeof(s_level) / sizeof(s_level[0]); i++)
+    {
+        if (lowlat_cpulist(cpu, s_level[i], &set) != 0)
+        {
+            continue;
+        }
+        for (j = 0; j < CPU_SETSIZE; j++)
+        {
+            if ((j != cpu) && CPU_ISSET(j, &set) && CPU_ISSET(j, &allowed))
+            {
+                return j;
+            }
+        }
+    }
+
+    for (j = 0; j < CPU_SETSIZE; j++)
+    {
+        if ((j != cpu) && CPU_ISSET(j, &allowed))
+        {
+            return j;
+        }
+    }
+
+    return -1;
+}
+
+/**
+    @fn         int lowlat_pin(int fd, int realtime)
+    @brief      按处理该套接字软中断的CPU绑定当前线程
+    @author     agent
+    @param[in]  fd          int         套接字
+    @param[in]  realtime    int         当前线程是否为SCHED_FIFO
+    @retval     >=0 绑定的CPU
+    @retval     -1 失败或没有绑定
+    @note       SO_INCOMING_CPU在收到第一个包之后才有效, 同核处理可减少跨核唤醒和缓存迁移.
+                SCHED_FIFO的自旋线程不能和软中断在同一个CPU上, 否则ksoftirqd/NAPI被饿死,
+                而自旋等的正是这个软中断送来的包, 此时改绑相邻的CPU(优先超线程), 没有则不绑定.
+*/
+int lowlat_pin(int fd, int realtime)
+{
+    int cpu = -1;
+    int incoming = -1;
+    socklen_t length = sizeof(incoming);
+    cpu_set_t set;
+
+    if ((getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming, &length) != 0) || (incoming < 0))
+    {
+        return -1;
+    }
+
+    cpu = incoming;
+    if (realtime)
+    {
+        cpu = lowlat_sibling(incoming);
+        if (cpu < 0)
+        {
+            printf("softirq on cpu%d and no other cpu for the SCHED_FIFO spinner, not pinned\n", incoming);
+            return -1;
+        }
+        printf("softirq on cpu%d, SCHED_FIFO spinner moved to cpu%d\n", incoming, cpu);
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0)
+    {
+        printf("sched_setaffinity failed!%d\n", errno);
+        return -1;
+    }
+
+    return cpu;
+}
+
+/**
+    @fn         int lowlat_realtime(int priority)
+    @brief      设置SCHED_FIFO并锁定内存
+    @author     agent
+    @param[in]  priority    int         实时优先级 1-99
+    @retval     0 成功
+    @retval     -1 失败
+    @note       锁定内存避免缺页带来的延时抖动, 需要root权限.
+*/
+int lowlat_realtime(int priority)
+{
+    int ret = 0;
+    struct sched_param param;
+
+    memset(&param, 0x00, sizeof(struct sched_param));
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+    {
+        printf("sched_setscheduler failed(SCHED_FIFO)!%d\n", errno);
+        ret = -1;
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        printf("mlockall failed!%d\n", errno);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/**
+    @fn         ssize_t lowlat_recvfrom(int fd, void *buffer, size_t length, int flags,
+                                        struct sockaddr *pAddr, socklen_t *pLength, volatile sig_atomic_t *pQuit)
+    @brief      非阻塞自旋接收
+    @author     agent
+    @param[in]  fd          int         非阻塞套接字
+    @param[out] buffer      void*       接收缓冲
+    @param[in]  length      size_t      缓冲长度
+    @param[in]  flags       int         recvfrom标志
+    @param[out] pAddr       sockaddr*   对端地址, 可为NULL
+    @param[out] pLength     socklen_t*  地址长度, 可为NULL
+    @param[in]  pQuit       sig_atomic_t* 退出标志, 可为NULL
+    @retval     与recvfrom相同, 退出时返回-1且errno为EINTR
+    @note       没有数据时一直重试, 以一个CPU为代价换取最短的唤醒延时.
+*/
+ssize_t lowlat_recvfrom(int fd, void *buffer, size_t length, int flags,
+                        struct sockaddr *pAddr, socklen_t *pLength, volatile sig_atomic_t *pQuit)
+{
+    ssize_t ret = 0;
+
+    for (;;)
+    {
+        ret = recvfrom(fd, buffer, length, flags | MSG_DONTWAIT, pAddr, pLength);
+        if ((ret >= 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)))
+        {
+            return ret;
+        }
+
+        if ((pQuit != NULL) && *pQuit)
+        {
+            errno = EINTR;
+            return -1;
+        }
+    }
+}
+
+/**
+    @fn         void cost_start(Cost_t *pCost)
+    @brief      记录CPU开销统计起点
+    @author     agent
+    @param[out] pCost       Cost_t*     CPU开销统计
+*/
+void cost_start(Cost_t *pCost)
+{
+    pCost->wall = clock_ns(CLOCK_MONOTONIC);
+    getrusage(RUSAGE_SELF, &pCost->usage);
+}
+
+/**
+    @fn         void cost_print(const Cost_t *pCost, const char *name, uint64_t messages, uint64_t bytes)
+    @brief      打印从起点到现在的CPU开销
+    @author     agent
+    @param[in]  pCost       Cost_t*     CPU开销统计
+    @param[in]  name        char*       模式名称
+    @param[in]  messages    uint64_t    处理的消息数
+    @param[in]  bytes       uint64_t    处理的字节数
+    @note       打印CPU占用率, 每条消息和每GB的CPU时间, 用于和阻塞模式对比.
+*/
+void cost_print(const Cost_t *pCost, const char *name, uint64_t messages, uint64_t bytes)
+{
+    struct rusage usage;
+    double wall = 0;
+    double user = 0;
+    double sys = 0;
+
+    getrusage(RUSAGE_SELF, &usage);
+    wall = (clock_ns(CLOCK_MONOTONIC) - pCost->wall) / 1e9;
+    user = (usage.ru_utime.tv_sec - pCost->usage.ru_utime.tv_sec) +
+           (usage.ru_utime.tv_usec - pCost->usage.ru_utime.tv_usec) / 1e6;
+    sys = (usage.ru_stime.tv_sec - pCost->usage.ru_stime.tv_sec) +
+          (usage.ru_stime.tv_usec - pCost->usage.ru_stime.tv_usec) / 1e6;
+
+    printf("%s cpu: wall=%.3fs user=%.3fs sys=%.3fs cpu=%.1f%% messages=%llu bytes=%llu",
+           name, wall, user, sys, wall > 0 ? (user + sys) * 100 / wall : 0.0,
+           (unsigned long long)messages, (unsigned long long)bytes);
+    if (messages != 0)
+    {
+        printf(" cpu/msg=%.3fus", (user + sys) * 1e6 / messages);
+    }
+    if (bytes != 0)
+    {
+        printf(" cpu/GB=%.3fs", (user + sys) * 1e9 / bytes);
+    }
+    printf(" vcsw=%ld ivcsw=%ld\n", usage.ru_nvcsw - pCost->usage.ru_nvcsw,
+           usage.ru_nivcsw - pCost->usage.ru_nivcsw);
+}
@@ -0,0 +1,37 @@
+/**
+    @file       lowlat.h
+    @brief      低延时接收
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       busy poll, 用户态自旋, 按SO_INCOMING_CPU绑核, SCHED_FIFO, 以及CPU开销统计
+*/
+
+#ifndef __LOWLAT_H__
+#define __LOWLAT_H__
+
+#include "stdint.h"
+#include "signal.h"
+#include "sys/types.h"
+#include "sys/socket.h"
+#include "sys/resource.h"
+
+/**
+CPU开销统计, 记录开始时的时间和rusage.
+*/
+typedef struct Cost_s
+{
+    uint64_t wall;
+    struct rusage usage;
+} Cost_t;
+
+int lowlat_socket(int fd, int busy);
+int lowlat_pin(int fd, int realtime);
+int lowlat_realtime(int priority);
+ssize_t lowlat_recvfrom(int fd, void *buffer, size_t length, int flags,
+                        struct sockaddr *pAddr, socklen_t *pLength, volatile sig_atomic_t *pQuit);
+void cost_start(Cost_t *pCost);
+void cost_print(const Cost_t *pCost, const char *name, uint64_t messages, uint64_t bytes);
+
+#endif
@@ -0,0 +1,261 @@
+/**
+    @file       perfcnt.c
+    @brief      硬件性能计数器
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       用perf_event_open统计收发阶段的周期数, 指令数, 缓存未命中, 上下文切换和缺页
+*/
+
+#include "stdio.h"
+#include "unistd.h"
+#include "string.h"
+#include "errno.h"
+
+#include "sys/ioctl.h"
+#include "sys/syscall.h"
+
+#include "linux/perf_event.h"
+
+#include "perfcnt.h"
+
+#define PERF_COUNT      5
+
+/**
+计数器描述
+*/
+typedef struct PerfEvent_s
+{
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int kernel;                 /* 1:只在内核态发生, 只统计用户态时恒为0 */
+} PerfEvent_t;
+
+/**
+read返回的数据, 计数器被复用时按enabled/running换算.
+*/
+typedef struct PerfValue_s
+{
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+} PerfValue_t;
+
+static const PerfEvent_t s_event[PERF_COUNT] =
+{
+    {"cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,       0},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,     0},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,     0},
+    {"cs",           PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 1},
+    {"faults",       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,      0},
+};
+
+static int s_fd[PERF_COUNT] = {-1, -1, -1, -1, -1};
+static int s_opened = 0;
+
+/**
+    @fn         static int perf_open(const PerfEvent_t *pEvent, int user)
+    @brief      打开一个计数器
+    @author     agent
+    @param[in]  pEvent      PerfEvent_t*    计数器描述
+    @param[in]  user        int             1:只统计用户态
+    @retval     文件描述符, 失败返回-1
+    @note       inherit使之后创建的线程也被统计, 线程退出时计入本线程.
+*/
+static int perf_open(const PerfEvent_t *pEvent, int user)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0x00, sizeof(struct perf_event_attr));
+    attr.size = sizeof(struct perf_event_attr);
+    attr.type = pEvent->type;
+    attr.config = pEvent->config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = user;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+    @fn         int perf_init(void)
+    @brief      打开所有计数器
+    @author     agent
+    @retval     打开的计数器个数
+    @note       perf_event_paranoid不允许统计内核态时只统计用户态, 上下文切换只在内核态发生,
+                此时不打开, 打印为n/a而不是0. 缺页只剩用户态触发的, 不含拷贝用户缓冲时的缺页.
+                虚拟机或容器中没有硬件计数器时只用软件计数器, 全部失败也不影响测试.
+*/
+int perf_init(void)
+{
+    int i = 0;
+    int user = 0;
+    char skipped[64] = "";
+
+    for (i = 0; i < PERF_COUNT; i++)
+    {
+        s_fd[i] = perf_open(&s_event[i], 0);
+        if ((s_fd[i] == -1) && ((errno == EACCES) || (errno == EPERM)))
+        {
+            user = 1;
+            if (s_event[i].kernel)
+            {
+                snprintf(skipped + strlen(skipped), sizeof(skipped) - strlen(skipped), " %s", s_event[i].name);
+                continue;
+            }
+            s_fd[i] = perf_open(&s_event[i], 1);
+        }
+
+        if (s_fd[i] == -1)
+        {
+            printf("perf %s unavailable!%d\n", s_event[i].name, errno);
+            continue;
+        }
+        s_opened++;
+    }
+
+    if (s_opened == 0)
+    {
+        printf("perf counters unavailable, check /proc/sys/kernel/perf_event_paranoid\n");
+    }
+    else if (user)
+    {
+        printf("perf counters user space only, n/a:%s, faults exclude kernel-triggered faults\n",
+               skipped[0] ? skipped : " none");
+    }
+
+    return s_opened;
+}
+
+/**
+    @fn         void perf_begin(void)
+    @brief      清零并开始计数
+    @author     agent
+    @note       没有打开计数器时什么也不做.
+*/
+void perf_begin(void)
+{
+    int i = 0;
+
+    for (i = 0; i < PERF_COUNT; i++)
+    {
+        if (s_fd[i] != -1)
+        {
+            ioctl(s_fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(s_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/**
+    @fn         void perf_end(const char *name, uint64_t messages, uint64_t bytes)
+    @brief      停止计数并打印
+    @author     agent
+    @param[in]  name        char*       阶段名称
+    @param[in]  messages    uint64_t    本阶段处理的消息数
+    @param[in]  bytes       uint64_t    本阶段处理的字节数
+    @note       打印总数, 每条消息和每字节的开销, 用于判断瓶颈在系统调用, 缓存还是打印.
+*/
+void perf_end(const char *name, uint64_t messages, uint64_t bytes)
+{
+    int i = 0;
+    int valid[PERF_COUNT];
+    double value[PERF_COUNT];
+    PerfValue_t read_value;
+
+    if (s_opened == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < PERF_COUNT; i++)
+    {
+        valid[i] = 0;
+        value[i] = 0;
+        if (s_fd[i] == -1)
+        {
+            continue;
+        }
+
+        ioctl(s_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(s_fd[i], &read_value, sizeof(read_value)) != sizeof(read_value))
+        {
+            continue;
+        }
+
+        value[i] = read_value.value;
+        if ((read_value.running != 0) && (read_value.running < read_value.enabled))
+        {
+            value[i] = value[i] * read_value.enabled / read_value.running;
+        }
+        valid[i] = 1;
+    }
+
+    printf("perf %s:", name);
+    for (i = 0; i < PERF_COUNT; i++)
+    {
+        if (valid[i])
+        {
+            printf(" %s=%.0f", s_event[i].name, value[i]);
+        }
+        else
+        {
+            printf(" %s=n/a", s_event[i].name);
+        }
+    }
+    if (valid[0] && valid[1] && (value[0] > 0))
+    {
+        printf(" ipc=%.2f", value[1] / value[0]);
+    }
+    printf("\n");
+
+    if (messages != 0)
+    {
+        printf("perf %s per msg:", name);
+        for (i = 0; i < PERF_COUNT; i++)
+        {
+            if (valid[i])
+            {
+                printf(" %s=%.4g", s_event[i].name, value[i] / messages);
+            }
+        }
+        printf("\n");
+    }
+
+    if (bytes != 0)
+    {
+        printf("perf %s per byte:", name);
+        for (i = 0; i < PERF_COUNT; i++)
+        {
+            if (valid[i])
+            {
+                printf(" %s=%.4g", s_event[i].name, value[i] / bytes);
+            }
+        }
+        printf("\n");
+    }
+}
+
+/**
+    @fn         void perf_exit(void)
+    @brief      关闭所有计数器
+    @author     agent
+*/
+void perf_exit(void)
+{
+    int i = 0;
+
+    for (i = 0; i < PERF_COUNT; i++)
+    {
+        if (s_fd[i] != -1)
+        {
+            close(s_fd[i]);
+            s_fd[i] = -1;
+        }
+    }
+    s_opened = 0;
+}
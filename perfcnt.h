@@ -0,0 +1,21 @@
+/**
+    @file       perfcnt.h
+    @brief      硬件性能计数器
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       用perf_event_open统计收发阶段的周期数, 指令数, 缓存未命中, 上下文切换和缺页
+*/
+
+#ifndef __PERFCNT_H__
+#define __PERFCNT_H__
+
+#include "stdint.h"
+
+int perf_init(void);
+void perf_begin(void);
+void perf_end(const char *name, uint64_t messages, uint64_t bytes);
+void perf_exit(void);
+
+#endif
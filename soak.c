@@ -0,0 +1,596 @@
+/**
+    @file       soak.c
+    @brief      长时间浸泡测试统计
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       秒桶满一分钟合并成分钟桶, 分钟桶满一小时合并成小时桶. 每关闭一个分钟桶,
+                和最近一小时内正常的整分钟比较, 并把整个统计复制给写线程, 由写线程写入临时文件后改名,
+                保证快照完整, 落盘的耗时不影响收发. 写线程和快照副本是静态的, 每个进程只有一个Soak_t.
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "signal.h"
+#include "pthread.h"
+
+#include "soak.h"
+
+#define SOAK_MAGIC      0x4B414F53  /* "SOAK" */
+
+static Soak_t s_snapshot;                   /* 交给写线程的快照副本 */
+static pthread_t s_writer;
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static int s_started = 0;
+static int s_pending = 0;                   /* s_snapshot有新内容待写 */
+static int s_busy = 0;                      /* 写线程正在写s_snapshot */
+static int s_stop = 0;
+
+/**
+    @fn         static void *soak_writer(void *arg)
+    @brief      快照写线程
+    @author     agent
+    @param[in]  arg         void*       未使用
+    @retval     NULL
+    @note       停止时先写完待写的快照再退出.
+*/
+static void *soak_writer(void *arg)
+{
+    pthread_mutex_lock(&s_mutex);
+    for (;;)
+    {
+        while (!s_pending && !s_stop)
+        {
+            pthread_cond_wait(&s_cond, &s_mutex);
+        }
+        if (!s_pending)
+        {
+            break;
+        }
+
+        s_pending = 0;
+        s_busy = 1;
+        pthread_mutex_unlock(&s_mutex);
+
+        soak_save(&s_snapshot);
+
+        pthread_mutex_lock(&s_mutex);
+        s_busy = 0;
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    return NULL;
+}
+
+/**
+    @fn         static void soak_post(Soak_t *pSoak)
+    @brief      复制统计并通知写线程保存
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @retval     无
+    @note       收发线程上只有一次内存复制. 写线程还在写上一个快照时(磁盘卡住超过一分钟)
+                跳过这一次, 文件里仍是上一个完整的快照.
+*/
+static void soak_post(Soak_t *pSoak)
+{
+    if (!s_started)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    if (s_busy)
+    {
+        printf("soak snapshot writer busy, skip this minute\n");
+    }
+    else
+    {
+        memcpy(&s_snapshot, pSoak, sizeof(s_snapshot));
+        s_pending = 1;
+        pthread_cond_signal(&s_cond);
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+/**
+    @fn         static void soak_merge(Bucket_t *pTo, const Bucket_t *pFrom)
+    @brief      统计桶累加
+    @author     agent
+    @param[out] pTo         Bucket_t*   目的桶
+    @param[in]  pFrom       Bucket_t*   源桶
+    @retval     无
+*/
+static void soak_merge(Bucket_t *pTo, const Bucket_t *pFrom)
+{
+    pTo->messages += pFrom->messages;
+    pTo->bytes += pFrom->bytes;
+    pTo->errors += pFrom->errors;
+    pTo->samples += pFrom->samples;
+    pTo->latency += pFrom->latency;
+    pTo->flags |= pFrom->flags;
+    pTo->span += pFrom->span;
+
+    if (pFrom->max > pTo->max)
+    {
+        pTo->max = pFrom->max;
+    }
+}
+
+/**
+    @fn         static void soak_print(const char *name, const Bucket_t *pBucket)
+    @brief      打印一个统计桶
+    @author     agent
+    @param[in]  name        char*       桶名称
+    @param[in]  pBucket     Bucket_t*   统计桶
+    @retval     无
+*/
+static void soak_print(const char *name, const Bucket_t *pBucket)
+{
+    char date[32];
+    time_t start = pBucket->time;
+    struct tm tm;
+
+    localtime_r(&start, &tm);
+    strftime(date, sizeof(date), "%m-%d %H:%M:%S", &tm);
+
+    printf("[%s] %-6s msgs %llu bytes %llu %.3fMbps errors %llu", date, name,
+           (unsigned long long)pBucket->messages, (unsigned long long)pBucket->bytes,
+           pBucket->span ? pBucket->bytes * 8.0 / pBucket->span / 1e6 : 0.0,
+           (unsigned long long)pBucket->errors);
+
+    if (pBucket->samples)
+    {
+        printf(" lat avg %.1fus max %.1fus", pBucket->latency / 1e3 / pBucket->samples,
+               pBucket->max / 1e3);
+    }
+
+    printf("%s%s%s\n", (pBucket->flags & SOAK_STALL) ? " STALL" : "",
+           (pBucket->flags & SOAK_SLOW) ? " SLOW" : "", (pBucket->flags & SOAK_LATE) ? " LATE" : "");
+}
+
+/**
+    @fn         static void soak_baseline(Soak_t *pSoak)
+    @brief      由最近一小时内正常的整分钟计算基线
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @retval     无
+    @note       劣化的分钟不参与基线, 避免缓慢劣化把基线一起拉低.
+*/
+static void soak_baseline(Soak_t *pSoak)
+{
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    uint64_t samples = 0;
+    uint64_t latency = 0;
+    uint64_t i = 0;
+
+    for (i = 0; (i < 60) && (i < pSoak->minutes); i++)
+    {
+        const Bucket_t *pMinute = &pSoak->perMinute[(pSoak->minutes - 1 - i) % SOAK_MINUTES];
+
+        if ((pMinute->span != 60) || (pMinute->flags != 0))
+        {
+            continue;
+        }
+
+        count++;
+        bytes += pMinute->bytes;
+        samples += pMinute->samples;
+        latency += pMinute->latency;
+    }
+
+    if (count < SOAK_BASELINE)
+    {
+        pSoak->baseBytes = 0;
+        pSoak->baseLatency = 0;
+        return;
+    }
+
+    pSoak->baseBytes = bytes / count;
+    pSoak->baseLatency = samples ? latency / samples : 0;
+}
+
+/**
+    @fn         static void soak_hour(Soak_t *pSoak, uint64_t next)
+    @brief      关闭当前小时桶
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @param[in]  next        uint64_t    下一个小时的开始时间
+    @retval     无
+*/
+static void soak_hour(Soak_t *pSoak, uint64_t next)
+{
+    soak_print("hour", &pSoak->hour);
+
+    pSoak->perHour[pSoak->hours % SOAK_HOURS] = pSoak->hour;
+    pSoak->hours++;
+
+    memset(&pSoak->hour, 0, sizeof(pSoak->hour));
+    pSoak->hour.time = next;
+}
+
+/**
+    @fn         static void soak_minute(Soak_t *pSoak, uint64_t next)
+    @brief      关闭当前分钟桶, 和基线比较并交给写线程保存快照
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @param[in]  next        uint64_t    下一分钟的开始时间
+    @retval     无
+*/
+static void soak_minute(Soak_t *pSoak, uint64_t next)
+{
+    Bucket_t *pMinute = &pSoak->minute;
+    uint64_t threshold = pSoak->threshold;
+
+    /* 秒桶的STALL合并上来不算, 停顿的秒数超过阈值比例才算劣化, 偶尔一秒没有数据不报警 */
+    pMinute->flags &= ~SOAK_STALL;
+    if ((uint64_t)pSoak->stalled * 100 > 60 * threshold)
+    {
+        pMinute->flags |= SOAK_STALL;
+    }
+
+    if ((pSoak->baseBytes) && (pMinute->span == 60))
+    {
+        if (pMinute->bytes * 100 < pSoak->baseBytes * (100 - threshold))
+        {
+            pMinute->flags |= SOAK_SLOW;
+        }
+
+        if ((pSoak->baseLatency) && (pMinute->samples) &&
+            (pMinute->latency / pMinute->samples * 100 > pSoak->baseLatency * (100 + threshold)))
+        {
+            pMinute->flags |= SOAK_LATE;
+        }
+    }
+
+    soak_print("minute", pMinute);
+
+    if (pMinute->flags)
+    {
+        pSoak->degradations++;
+        printf("DEGRADED: %.3fMbps lat %.1fus stall %us, baseline %.3fMbps lat %.1fus\n",
+               pMinute->bytes * 8.0 / 60 / 1e6,
+               pMinute->samples ? pMinute->latency / 1e3 / pMinute->samples : 0.0, pSoak->stalled,
+               pSoak->baseBytes * 8.0 / 60 / 1e6, pSoak->baseLatency / 1e3);
+    }
+
+    pSoak->perMinute[pSoak->minutes % SOAK_MINUTES] = *pMinute;
+    pSoak->minutes++;
+    soak_merge(&pSoak->hour, pMinute);
+    soak_baseline(pSoak);
+
+    memset(pMinute, 0, sizeof(*pMinute));
+    pMinute->time = next;
+    pSoak->stalled = 0;
+
+    if (next % 3600 == 0)
+    {
+        soak_hour(pSoak, next);
+    }
+
+    soak_post(pSoak);
+}
+
+/**
+    @fn         static void soak_second(Soak_t *pSoak)
+    @brief      关闭当前秒桶
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @retval     无
+*/
+static void soak_second(Soak_t *pSoak)
+{
+    Bucket_t *pSecond = &pSoak->current;
+    uint64_t next = pSecond->time + 1;
+
+    pSecond->span = 1;
+
+    if ((pSecond->messages == 0) && (pSoak->baseBytes))
+    {
+        pSecond->flags |= SOAK_STALL;
+        pSoak->stalled++;
+    }
+
+    pSoak->second[pSoak->seconds % SOAK_SECONDS] = *pSecond;
+    pSoak->seconds++;
+    soak_merge(&pSoak->minute, pSecond);
+
+    memset(pSecond, 0, sizeof(*pSecond));
+    pSecond->time = next;
+
+    if (next % 60 == 0)
+    {
+        soak_minute(pSoak, next);
+    }
+}
+
+/**
+    @fn         static void soak_resume(Soak_t *pSoak, uint64_t now)
+    @brief      关闭快照里停止前未满的分钟桶和小时桶
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @param[in]  now         uint64_t    当前时间
+    @retval     无
+    @note       桶的开始时间不是当前分钟或当前小时时, 按原样存入历史, 不和基线比较.
+                span不满, 不会进入基线, 停止期间的空白也不会被当作停顿.
+*/
+static void soak_resume(Soak_t *pSoak, uint64_t now)
+{
+    if ((pSoak->minute.time != 0) && (pSoak->minute.time != now - now % 60))
+    {
+        soak_print("minute", &pSoak->minute);
+
+        pSoak->perMinute[pSoak->minutes % SOAK_MINUTES] = pSoak->minute;
+        pSoak->minutes++;
+        soak_merge(&pSoak->hour, &pSoak->minute);
+
+        memset(&pSoak->minute, 0, sizeof(pSoak->minute));
+        pSoak->stalled = 0;
+    }
+
+    if ((pSoak->hour.time != 0) && (pSoak->hour.time != now - now % 3600))
+    {
+        soak_hour(pSoak, 0);
+    }
+}
+
+/**
+    @fn         int soak_init(Soak_t *pSoak, const char *path, int threshold)
+    @brief      初始化浸泡统计, 快照文件有效时从快照继续
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @param[in]  path        char*       快照文件, NULL或空串为不保存
+    @param[in]  threshold   int         劣化阈值, 百分比
+    @retval     0 成功
+    @retval     -1 失败
+*/
+int soak_init(Soak_t *pSoak, const char *path, int threshold)
+{
+    int fd = -1;
+    int ret = 0;
+    sigset_t set;
+    sigset_t old;
+
+    if ((threshold <= 0) || (threshold >= 100))
+    {
+        printf("soak threshold %d invalid!\n", threshold);
+        return -1;
+    }
+
+    memset(pSoak, 0, sizeof(*pSoak));
+
+    if ((path != NULL) && (path[0] != '\0'))
+    {
+        fd = open(path, O_RDONLY);
+        if (fd >= 0)
+        {
+            if ((read(fd, pSoak, sizeof(*pSoak)) != sizeof(*pSoak)) || (pSoak->magic != SOAK_MAGIC) ||
+                (pSoak->size != sizeof(*pSoak)))
+            {
+                printf("soak snapshot %s invalid, start over\n", path);
+                memset(pSoak, 0, sizeof(*pSoak));
+            }
+            else
+            {
+                pSoak->restarts++;
+                printf("soak resume from %s: %llu seconds, %llu minutes, %llu hours, %llu degradations\n",
+                       path, (unsigned long long)pSoak->seconds, (unsigned long long)pSoak->minutes,
+                       (unsigned long long)pSoak->hours, (unsigned long long)pSoak->degradations);
+            }
+
+            close(fd);
+        }
+
+        snprintf(pSoak->path, sizeof(pSoak->path), "%s", path);
+
+        /* SIGINT和SIGTERM只交给收发的主线程 */
+        sigemptyset(&set);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &set, &old);
+        s_stop = 0;
+        ret = pthread_create(&s_writer, NULL, soak_writer, NULL);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (ret != 0)
+        {
+            printf("pthread_create failed!%d\n", ret);
+            return -1;
+        }
+        s_started = 1;
+    }
+
+    pSoak->magic = SOAK_MAGIC;
+    pSoak->size = sizeof(*pSoak);
+    pSoak->threshold = threshold;
+
+    /* 停止期间的空白不补桶, 未满的秒并入分钟, 从下一次soak_add的时间重新开始 */
+    soak_merge(&pSoak->minute, &pSoak->current);
+    memset(&pSoak->current, 0, sizeof(pSoak->current));
+
+    return 0;
+}
+
+/**
+    @fn         void soak_add(Soak_t *pSoak, uint64_t messages, uint64_t bytes, uint64_t errors, int64_t latency)
+    @brief      累加统计, 跨过秒, 分钟和小时边界时关闭对应的桶
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @param[in]  messages    uint64_t    消息数
+    @param[in]  bytes       uint64_t    字节数
+    @param[in]  errors      uint64_t    错误数
+    @param[in]  latency     int64_t     延时, 单位ns, -1为没有延时样本
+    @retval     无
+    @note       没有数据时也要至少每秒调用一次(全部为0), 否则停顿要到下一个数据才能发现.
+*/
+void soak_add(Soak_t *pSoak, uint64_t messages, uint64_t bytes, uint64_t errors, int64_t latency)
+{
+    uint64_t now = time(NULL);
+    Bucket_t *pSecond = &pSoak->current;
+
+    if (pSecond->time == 0)
+    {
+        pSecond->time = now;
+
+        if (pSoak->total.time == 0)
+        {
+            pSoak->total.time = now;
+        }
+
+        soak_resume(pSoak, now);
+
+        if (pSoak->minute.time == 0)
+        {
+            pSoak->minute.time = now - now % 60;
+        }
+
+        if (pSoak->hour.time == 0)
+        {
+            pSoak->hour.time = now - now % 3600;
+        }
+    }
+
+    while (pSecond->time < now)
+    {
+        soak_second(pSoak);
+
+        /* 机器挂起或时间跳变时最多补一小时的桶 */
+        if (now - pSecond->time > SOAK_SECONDS)
+        {
+            pSecond->time = now - SOAK_SECONDS;
+        }
+    }
+
+    pSecond->messages += messages;
+    pSecond->bytes += bytes;
+    pSecond->errors += errors;
+    pSoak->total.messages += messages;
+    pSoak->total.bytes += bytes;
+    pSoak->total.errors += errors;
+
+    if (latency >= 0)
+    {
+        pSecond->samples++;
+        pSecond->latency += latency;
+        pSoak->total.samples++;
+        pSoak->total.latency += latency;
+
+        if ((uint64_t)latency > pSecond->max)
+        {
+            pSecond->max = latency;
+        }
+
+        if ((uint64_t)latency > pSoak->total.max)
+        {
+            pSoak->total.max = latency;
+        }
+    }
+}
+
+/**
+    @fn         int soak_save(Soak_t *pSoak)
+    @brief      保存快照
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @retval     0 成功
+    @retval     -1 失败
+    @note       先写临时文件并落盘再改名, 写一半时崩溃不会破坏上一个快照.
+                同步写入, 收发过程中由写线程调用, 只有soak_close在主线程调用.
+*/
+int soak_save(Soak_t *pSoak)
+{
+    char temp[sizeof(pSoak->path) + 8];
+    const char *data = (const char *)pSoak;
+    size_t offset = 0;
+    ssize_t ret = -1;
+    int fd = -1;
+
+    if (pSoak->path[0] == '\0')
+    {
+        return 0;
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp", pSoak->path);
+
+    fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("open %s failed!%d\n", temp, errno);
+        return -1;
+    }
+
+    while (offset < sizeof(*pSoak))
+    {
+        ret = write(fd, data + offset, sizeof(*pSoak) - offset);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            printf("write %s failed!%d\n", temp, errno);
+            goto Exit;
+        }
+
+        offset += ret;
+    }
+
+    if (fdatasync(fd) < 0)
+    {
+        printf("fdatasync %s failed!%d\n", temp, errno);
+        goto Exit;
+    }
+
+    close(fd);
+    fd = -1;
+
+    if (rename(temp, pSoak->path) < 0)
+    {
+        printf("rename %s failed!%d\n", temp, errno);
+        return -1;
+    }
+
+    return 0;
+
+Exit:
+    close(fd);
+    return -1;
+}
+
+/**
+    @fn         void soak_close(Soak_t *pSoak)
+    @brief      打印总计, 停止写线程并同步保存快照
+    @author     agent
+    @param[in]  pSoak       Soak_t*     浸泡统计
+    @retval     无
+    @note       当前未满的秒桶和分钟桶留在快照里, 下次继续时仍在同一分钟(小时)则接着累加,
+                否则作为不满的桶关闭.
+*/
+void soak_close(Soak_t *pSoak)
+{
+    soak_add(pSoak, 0, 0, 0, -1);
+
+    pSoak->total.span = pSoak->seconds;
+    soak_print("total", &pSoak->total);
+    printf("soak %llu seconds, %llu degraded minutes, %u restarts\n", (unsigned long long)pSoak->seconds,
+           (unsigned long long)pSoak->degradations, pSoak->restarts);
+
+    if (s_started)
+    {
+        pthread_mutex_lock(&s_mutex);
+        s_stop = 1;
+        pthread_cond_signal(&s_cond);
+        pthread_mutex_unlock(&s_mutex);
+        pthread_join(s_writer, NULL);
+        s_started = 0;
+    }
+
+    soak_save(pSoak);
+}
@@ -0,0 +1,76 @@
+/**
+    @file       soak.h
+    @brief      长时间浸泡测试统计
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       最近一小时每秒, 最近一天每分钟, 之后每小时一个统计桶, 全部为固定大小的环形缓冲,
+                运行多久内存都不增长. 每分钟和基线比较吞吐和延时, 并由写线程把全部历史写入快照文件,
+                进程崩溃或重启后从快照继续.
+*/
+
+#ifndef __SOAK_H__
+#define __SOAK_H__
+
+#include "stdint.h"
+
+#define SOAK_SECONDS    3600        /* 每秒桶个数, 一小时 */
+#define SOAK_MINUTES    1440        /* 每分钟桶个数, 一天 */
+#define SOAK_HOURS      8760        /* 每小时桶个数, 一年 */
+#define SOAK_BASELINE   5           /* 基线至少需要的正常分钟数 */
+#define SOAK_THRESHOLD  30          /* 默认劣化阈值, 百分比 */
+
+#define SOAK_STALL      0x01        /* 基线有流量时整秒没有数据, 分钟桶为停顿秒数超过阈值 */
+#define SOAK_SLOW       0x02        /* 吞吐低于基线 */
+#define SOAK_LATE       0x04        /* 平均延时高于基线 */
+
+/**
+统计桶, time为桶开始的时间(CLOCK_REALTIME秒), 计数全部64位.
+*/
+typedef struct Bucket_s
+{
+    uint64_t time;
+    uint64_t messages;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t samples;           /* 延时样本数 */
+    uint64_t latency;           /* 延时之和, 单位ns */
+    uint64_t max;               /* 最大延时, 单位ns */
+    uint32_t flags;             /* SOAK_STALL等劣化标志 */
+    uint32_t span;              /* 桶内的秒数, 不满的桶不参与基线和比较 */
+} Bucket_t;
+
+/**
+浸泡统计, 整个结构体就是快照文件的内容.
+*/
+typedef struct Soak_s
+{
+    uint32_t magic;
+    uint32_t size;              /* sizeof(Soak_t), 结构变化后旧快照不再加载 */
+    uint32_t threshold;         /* 劣化阈值, 百分比 */
+    uint32_t restarts;
+    uint64_t seconds;           /* 已关闭的秒桶总数 */
+    uint64_t minutes;
+    uint64_t hours;
+    uint64_t degradations;
+    uint64_t baseBytes;         /* 基线每分钟字节数, 0为基线未建立 */
+    uint64_t baseLatency;       /* 基线平均延时, 单位ns, 0为没有延时样本 */
+    uint32_t stalled;           /* 当前分钟停顿的秒数 */
+    uint32_t reserved;
+    Bucket_t total;
+    Bucket_t current;           /* 当前秒 */
+    Bucket_t minute;            /* 当前分钟 */
+    Bucket_t hour;              /* 当前小时 */
+    Bucket_t second[SOAK_SECONDS];
+    Bucket_t perMinute[SOAK_MINUTES];
+    Bucket_t perHour[SOAK_HOURS];
+    char path[128];
+} Soak_t;
+
+int soak_init(Soak_t *pSoak, const char *path, int threshold);
+void soak_add(Soak_t *pSoak, uint64_t messages, uint64_t bytes, uint64_t errors, int64_t latency);
+int soak_save(Soak_t *pSoak);
+void soak_close(Soak_t *pSoak);
+
+#endif
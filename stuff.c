@@ -0,0 +1,374 @@
+/**
+    @file       stuff.c
+    @brief      串口字节填充分帧
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       SLIP和HDLC异步字节填充, 帧尾带CRC16或CRC32.
+                编解码按整块扫描特殊字节, 两个特殊字节之间的数据整段拷贝.
+                x86上用SSE2每次比较16字节, 其他平台每次比较8字节.
+*/
+
+#include "string.h"
+
+#if defined(__SSE2__)
+#include "emmintrin.h"
+#endif
+
+#include "stuff.h"
+
+static uint16_t s_crc16[256];
+static uint32_t s_crc32[256];
+static int s_ready = 0;
+
+/**
+    @fn         void stuff_init(void)
+    @brief      生成CRC表
+    @author     agent
+    @note       CRC16为HDLC的FCS-16(多项式0x1021反射), CRC32为以太网CRC(多项式0x04C11DB7反射).
+*/
+void stuff_init(void)
+{
+    int i = 0;
+    int j = 0;
+    uint16_t c16 = 0;
+    uint32_t c32 = 0;
+
+    for (i = 0; i < 256; i++)
+    {
+        c16 = i;
+        c32 = i;
+        for (j = 0; j < 8; j++)
+        {
+            c16 = (c16 & 1) ? (c16 >> 1) ^ 0x8408 : (c16 >> 1);
+            c32 = (c32 & 1) ? (c32 >> 1) ^ 0xEDB88320 : (c32 >> 1);
+        }
+        s_crc16[i] = c16;
+        s_crc32[i] = c32;
+    }
+
+    s_ready = 1;
+}
+
+/**
+    @fn         uint16_t crc16(const uint8_t *data, size_t length)
+    @brief      计算CRC16
+    @author     agent
+    @param[in]  data        uint8_t*    数据
+    @param[in]  length      size_t      长度
+    @retval     CRC16
+*/
+uint16_t crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    if (!s_ready) stuff_init();
+
+    while (length--)
+    {
+        crc = (crc >> 8) ^ s_crc16[(crc ^ *data++) & 0xFF];
+    }
+
+    return ~crc;
+}
+
+/**
+    @fn         uint32_t crc32(const uint8_t *data, size_t length)
+    @brief      计算CRC32
+    @author     agent
+    @param[in]  data        uint8_t*    数据
+    @param[in]  length      size_t      长度
+    @retval     CRC32
+*/
+uint32_t crc32(const uint8_t *data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    if (!s_ready) stuff_init();
+
+    while (length--)
+    {
+        crc = (crc >> 8) ^ s_crc32[(crc ^ *data++) & 0xFF];
+    }
+
+    return ~crc;
+}
+
+/**
+    @fn         size_t stuff_scan(const uint8_t *data, size_t length, uint8_t a, uint8_t b)
+    @brief      查找第一个等于a或b的字节
+    @author     agent
+    @param[in]  data        uint8_t*    数据
+    @param[in]  length      size_t      长度
+    @param[in]  a           uint8_t     特殊字节
+    @param[in]  b           uint8_t     特殊字节
+    @retval     位置, 没有找到时为length
+    @note       特殊字节很少, 整块比较没有逐字节的分支.
+*/
+size_t stuff_scan(const uint8_t *data, size_t length, uint8_t a, uint8_t b)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    int mask = 0;
+    __m128i va = _mm_set1_epi8((char)a);
+    __m128i vb = _mm_set1_epi8((char)b);
+    __m128i v;
+
+    for (; i + 16 <= length; i += 16)
+    {
+        v = _mm_loadu_si128((const __m128i *)(data + i));
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#else
+    uint64_t word = 0;
+    uint64_t x = 0;
+    uint64_t y = 0;
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    /* 异或后某字节为0即命中, (v - 0x01..) & ~v & 0x80..非0表示有0字节 */
+    for (; i + 8 <= length; i += 8)
+    {
+        memcpy(&word, data + i, 8);
+        x = word ^ (ones * a);
+        y = word ^ (ones * b);
+        if ((((x - ones) & ~x) | ((y - ones) & ~y)) & highs)
+        {
+            break;
+        }
+    }
+#endif
+
+    for (; i < length; i++)
+    {
+        if ((data[i] == a) || (data[i] == b))
+        {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+/**
+    @fn         static size_t stuff_run(int type, const uint8_t *data, size_t length, uint8_t *out)
+    @brief      对一段数据做字节填充
+    @author     agent
+    @param[in]  type        int         STUFF_SLIP或STUFF_HDLC
+    @param[in]  data        uint8_t*    数据
+    @param[in]  length      size_t      长度
+    @param[out] out         uint8_t*    输出, 至少2*length
+    @retval     输出长度
+*/
+static size_t stuff_run(int type, const uint8_t *data, size_t length, uint8_t *out)
+{
+    size_t i = 0;
+    size_t n = 0;
+    uint8_t delimiter = (type == STUFF_SLIP) ? SLIP_END : HDLC_FLAG;
+    uint8_t escape = (type == STUFF_SLIP) ? SLIP_ESC : HDLC_ESC;
+    uint8_t *p = out;
+
+    while (i < length)
+    {
+        n = stuff_scan(data + i, length - i, delimiter, escape);
+        memcpy(p, data + i, n);
+        p += n;
+        i += n;
+        if (i == length)
+        {
+            break;
+        }
+
+        *p++ = escape;
+        if (type == STUFF_SLIP)
+        {
+            *p++ = (data[i] == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+        }
+        else
+        {
+            *p++ = data[i] ^ HDLC_XOR;
+        }
+        i++;
+    }
+
+    return p - out;
+}
+
+/**
+    @fn         size_t stuff_encode(int type, int crc, const uint8_t *data, size_t length, uint8_t *out)
+    @brief      编码一帧
+    @author     agent
+    @param[in]  type        int         STUFF_SLIP或STUFF_HDLC
+    @param[in]  crc         int         CRC位数, 16或32
+    @param[in]  data        uint8_t*    帧内容
+    @param[in]  length      size_t      长度
+    @param[out] out         uint8_t*    输出, 至少2*(length+4)+2
+    @retval     输出长度
+    @note       帧界+填充后的内容+填充后的CRC(小端)+帧界. 开头的帧界让接收端丢弃线路上的杂散字节.
+*/
+size_t stuff_encode(int type, int crc, const uint8_t *data, size_t length, uint8_t *out)
+{
+    uint8_t tail[4];
+    uint32_t value = 0;
+    size_t n = 0;
+    int i = 0;
+
+    value = (crc == 32) ? crc32(data, length) : crc16(data, length);
+    for (i = 0; i < crc / 8; i++)
+    {
+        tail[i] = (value >> (i * 8)) & 0xFF;
+    }
+
+    out[n++] = (type == STUFF_SLIP) ? SLIP_END : HDLC_FLAG;
+    n += stuff_run(type, data, length, out + n);
+    n += stuff_run(type, tail, crc / 8, out + n);
+    out[n++] = (type == STUFF_SLIP) ? SLIP_END : HDLC_FLAG;
+
+    return n;
+}
+
+/**
+    @fn         void unstuff_init(Unstuff_t *pUnstuff, int type, int crc)
+    @brief      初始化解码状态
+    @author     agent
+    @param[in]  pUnstuff    Unstuff_t*  解码状态
+    @param[in]  type        int         STUFF_SLIP或STUFF_HDLC
+    @param[in]  crc         int         CRC位数, 16或32
+*/
+void unstuff_init(Unstuff_t *pUnstuff, int type, int crc)
+{
+    memset(pUnstuff, 0x00, sizeof(Unstuff_t));
+    pUnstuff->type = type;
+    pUnstuff->crc = crc;
+    if (!s_ready) stuff_init();
+}
+
+/**
+    @fn         static void unstuff_append(Unstuff_t *pUnstuff, const uint8_t *data, size_t length)
+    @brief      追加解码后的数据
+    @author     agent
+    @param[in]  pUnstuff    Unstuff_t*  解码状态
+    @param[in]  data        uint8_t*    数据
+    @param[in]  length      size_t      长度
+*/
+static void unstuff_append(Unstuff_t *pUnstuff, const uint8_t *data, size_t length)
+{
+    if (pUnstuff->drop || (pUnstuff->length + length > STUFF_MAX))
+    {
+        pUnstuff->drop = 1;
+        return;
+    }
+
+    memcpy(pUnstuff->frame + pUnstuff->length, data, length);
+    pUnstuff->length += length;
+}
+
+/**
+    @fn         const uint8_t *unstuff_next(Unstuff_t *pUnstuff, const uint8_t **pData, size_t *pLength, size_t *pFrame)
+    @brief      从接收数据中解出下一帧
+    @author     agent
+    @param[in]  pUnstuff    Unstuff_t*  解码状态
+    @param[in,out] pData    uint8_t**   接收数据, 返回时指向未处理的部分
+    @param[in,out] pLength  size_t*     接收数据长度, 返回时为未处理的长度
+    @param[out] pFrame      size_t*     帧内容长度, 不含CRC
+    @retval     帧内容, 下一次调用前有效
+    @retval     NULL 数据用完, 没有完整的帧
+    @note       CRC错误和超长的帧计数后丢弃, 连续的帧界之间的空帧忽略.
+*/
+const uint8_t *unstuff_next(Unstuff_t *pUnstuff, const uint8_t **pData, size_t *pLength, size_t *pFrame)
+{
+    size_t n = 0;
+    size_t body = 0;
+    uint8_t byte = 0;
+    uint32_t value = 0;
+    uint32_t expect = 0;
+    int i = 0;
+    int bytes = pUnstuff->crc / 8;
+    uint8_t delimiter = (pUnstuff->type == STUFF_SLIP) ? SLIP_END : HDLC_FLAG;
+    uint8_t escape = (pUnstuff->type == STUFF_SLIP) ? SLIP_ESC : HDLC_ESC;
+
+    while (*pLength > 0)
+    {
+        if (pUnstuff->escape)
+        {
+            byte = **pData;
+            if (pUnstuff->type == STUFF_SLIP)
+            {
+                byte = (byte == SLIP_ESC_END) ? SLIP_END : ((byte == SLIP_ESC_ESC) ? SLIP_ESC : byte);
+            }
+            else
+            {
+                byte ^= HDLC_XOR;
+            }
+            unstuff_append(pUnstuff, &byte, 1);
+            pUnstuff->escape = 0;
+            (*pData)++;
+            (*pLength)--;
+            continue;
+        }
+
+        n = stuff_scan(*pData, *pLength, delimiter, escape);
+        unstuff_append(pUnstuff, *pData, n);
+        *pData += n;
+        *pLength -= n;
+        if (*pLength == 0)
+        {
+            break;
+        }
+
+        byte = **pData;
+        (*pData)++;
+        (*pLength)--;
+        if (byte == escape)
+        {
+            pUnstuff->escape = 1;
+            continue;
+        }
+
+        /* 帧界 */
+        if ((pUnstuff->length == 0) && !pUnstuff->drop)
+        {
+            continue;
+        }
+
+        if (pUnstuff->drop)
+        {
+            pUnstuff->overflows++;
+            pUnstuff->drop = 0;
+            pUnstuff->length = 0;
+            continue;
+        }
+
+        if (pUnstuff->length <= bytes)
+        {
+            pUnstuff->errors++;
+            pUnstuff->length = 0;
+            continue;
+        }
+
+        body = pUnstuff->length - bytes;
+        value = (bytes == 4) ? crc32(pUnstuff->frame, body) : crc16(pUnstuff->frame, body);
+        expect = 0;
+        for (i = 0; i < bytes; i++)
+        {
+            expect |= (uint32_t)pUnstuff->frame[body + i] << (i * 8);
+        }
+        pUnstuff->length = 0;
+        if (value != expect)
+        {
+            pUnstuff->errors++;
+            continue;
+        }
+
+        pUnstuff->frames++;
+        *pFrame = body;
+        return pUnstuff->frame;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,59 @@
+/**
+    @file       stuff.h
+    @brief      串口字节填充分帧
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       SLIP和HDLC异步字节填充, 帧尾带CRC16或CRC32.
+                编解码按整块扫描特殊字节, 两个特殊字节之间的数据整段拷贝.
+*/
+
+#ifndef __STUFF_H__
+#define __STUFF_H__
+
+#include "stdint.h"
+#include "stddef.h"
+
+#define SLIP_END        0xC0
+#define SLIP_ESC        0xDB
+#define SLIP_ESC_END    0xDC
+#define SLIP_ESC_ESC    0xDD
+
+#define HDLC_FLAG       0x7E
+#define HDLC_ESC        0x7D
+#define HDLC_XOR        0x20
+
+#define STUFF_MAX       2048        /* 最大帧长度, 包括CRC */
+
+enum
+{
+    STUFF_SLIP = 0,
+    STUFF_HDLC,
+};
+
+/**
+解码状态. 数据可以分任意多次送入, 帧内容写入frame.
+*/
+typedef struct Unstuff_s
+{
+    int type;
+    int crc;                    /* CRC位数, 16或32 */
+    int escape;                 /* 上一个字节是转义字节 */
+    int drop;                   /* 帧超长, 丢弃到下一个帧界 */
+    uint32_t length;
+    uint8_t frame[STUFF_MAX];
+    uint64_t frames;
+    uint64_t errors;            /* CRC错误 */
+    uint64_t overflows;         /* 超长帧 */
+} Unstuff_t;
+
+void stuff_init(void);
+uint16_t crc16(const uint8_t *data, size_t length);
+uint32_t crc32(const uint8_t *data, size_t length);
+size_t stuff_scan(const uint8_t *data, size_t length, uint8_t a, uint8_t b);
+size_t stuff_encode(int type, int crc, const uint8_t *data, size_t length, uint8_t *out);
+void unstuff_init(Unstuff_t *pUnstuff, int type, int crc);
+const uint8_t *unstuff_next(Unstuff_t *pUnstuff, const uint8_t **pData, size_t *pLength, size_t *pFrame);
+
+#endif
@@ -8,6 +8,8 @@
     @note       程序用来测试tcp server和client
 */
 
+#define _GNU_SOURCE
+
 #include "stdio.h"
 #include "stdlib.h"
 #include "unistd.h"
@@ -15,6 +17,9 @@
 #include "string.h"
 #include "errno.h"
 #include "termios.h"
+#include "poll.h"
+#include "getopt.h"
+#include "signal.h"
 
 #include "sys/mman.h"
 #include "sys/ioctl.h"
@@ -22,9 +27,28 @@
 #include "sys/socket.h"
 #include "netinet/in.h"
 #include "arpa/inet.h"
+#include "netinet/tcp.h"
+
+#include "hist.h"
+#include "lowlat.h"
+#include "capture.h"
+#include "bufpool.h"
+#include "perfcnt.h"
+#include "frame.h"
+#include "tcpinfo.h"
+#include "impair.h"
+#include "ctl.h"
+#include "soak.h"
 
 #define DEBUG     0
 
+#define ECHO_BUFFER     (256 * 1024)    /* 用户态回应缓冲 */
+#define ECHO_PIPE       (1024 * 1024)   /* splice管道容量 */
+#define BULK_CHUNK      (64 * 1024)     /* 批量测试每次发送长度 */
+#define POOL_COUNT      16              /* 缓冲池中ECHO_BUFFER的个数 */
+#define SINK_REGION     (2 * 1024 * 1024)   /* 零拷贝接收每次映射的最大长度 */
+#define SINK_LOWAT      (64 * 1024)     /* 批量接收唤醒的最少字节数 */
+
 /**
 参数结构体, 程序需要用的参数组成一个结构体,
 这样可以解决参数传递过多问题.
@@ -35,8 +59,70 @@ typedef struct Para_s
     int type;
     int port;
     int ip;
+    int number;
+    int latency;
+    int busy;
+    int fifo;
+    int echo;
+    int size;
+    double speed;
+    char capture[128];
+    char replay[128];
+    int huge;
+    int perf;
+    char frame[128];
+    int sample;
+    char output[128];
+    char target[64];
+    char impair[256];
+    int agent;                  /* 代理控制端口 */
+    char plan[128];             /* 协调端计划文件 */
+    int soak;                   /* 浸泡测试 */
+    char snapshot[128];         /* 浸泡统计快照文件 */
+    int threshold;              /* 劣化阈值, 百分比 */
+    int sink;                   /* 批量接收 */
 } Para_t;
 
+enum
+{
+    ECHO_PRINT = 0,             /* 打印后回应 */
+    ECHO_COPY,                  /* 用户态大缓冲回应 */
+    ECHO_SPLICE,                /* socket->pipe->socket 内核内回应 */
+};
+
+static char *s_echo[] =
+{
+    "print",
+    "copy",
+    "splice",
+};
+
+enum
+{
+    SINK_NONE = 0,
+    SINK_RECV,                  /* recv到页对齐的大缓冲 */
+    SINK_ZEROCOPY,              /* TCP_ZEROCOPY_RECEIVE把接收页映射到用户态 */
+};
+
+static char *s_sink[] =
+{
+    "none",
+    "recv",
+    "zerocopy",
+};
+
+static Pool_t s_pool;
+static Sampler_t s_sampler;
+static Soak_t s_soak;
+static volatile sig_atomic_t s_quit = 0;
+
+static struct option s_option[] =
+{
+    {"perf", no_argument, NULL, 'P'},
+    {"soak", optional_argument, NULL, 'W'},
+    {NULL, 0, NULL, 0},
+};
+
 static char *s_string[] =
 {
     "Client",
@@ -45,6 +131,24 @@ static char *s_string[] =
 
 static int tcp_server(Para_t *pPara);
 static int tcp_client(Para_t *pPara);
+static int lat_server(int fd, Para_t *pPara);
+static int lat_client(int fd, Para_t *pPara);
+static int recv_full(int fd, unsigned char *buffer, int length, Para_t *pPara);
+static int send_all(int fd, const unsigned char *buffer, int length);
+static int echo_server(int fd, Para_t *pPara);
+static int bulk_client(int fd, Para_t *pPara);
+static void install_quit(void);
+static int cap_server(int fd, Capture_t *pCapture);
+static int cap_client(int fd, Para_t *pPara);
+static int frame_server(int fd, Para_t *pPara);
+static int frame_client(int fd, Para_t *pPara);
+static void conn_close(int fd, Para_t *pPara);
+static int tcp_proxy(int fd, Para_t *pPara);
+static int tcp_main(int argc, char *argv[]);
+static int soak_client(int fd, Para_t *pPara);
+static int soak_timeout(int fd);
+static int sink_server(int fd, Para_t *pPara);
+static int sink_client(int fd, Para_t *pPara);
 
 /**
     @fn         static int print_usage(void)
@@ -56,13 +160,60 @@ static int tcp_client(Para_t *pPara);
 */
 static int print_usage(void)
 {
-    printf("Usage: tcp -[sc] <ip> <port> \n"
+    printf("Usage: tcp -[sc] <ip> <port> -n <number> -L -B <usec> -F <priority> -[eE]\n"
+           "           -C <file> -S <MB> -R <file> -x <speed> -H --perf -f <size>\n"
+           "           -T <usec> -O <file> -X <ip:port> -J <impairments> -A <port> -K <plan>\n"
+           "           --soak[=<file>] -Q <percent> -[zZ]\n"
            "\t-s: tcp server\n"
            "\t-c: tcp client\n"
            "\t-i: ip address 192.168.1.101\n"
            "\t-p: server or client port\n"
+           "\t-n: client round trips\n"
+           "\t-L: round trip latency and cpu cost report\n"
+           "\t-B: busy poll receive, SO_BUSY_POLL usec, implies -L\n"
+           "\t-F: SCHED_FIFO priority and mlockall\n"
+           "\t-e: bulk echo, server copies through large user buffer\n"
+           "\t-E: bulk echo, server splices socket->pipe->socket\n"
+           "\t    client with -e/-E streams -n 64KB chunks and checks the echo\n"
+           "\t-C: server captures received data to file\n"
+           "\t-S: capture file size MB, default 64\n"
+           "\t-R: client replays captured file\n"
+           "\t-x: replay speed, 1 real time, 0 as fast as possible\n"
+           "\t-H: hugepage backed and mlocked buffer pool\n"
+           "\t--perf: cycles/instructions/cache-misses/cs/faults per message and byte\n"
+           "\t-f: length-prefixed messages, server echoes per message,\n"
+           "\t    client sends -n messages sized fixed:256, uniform:64-4096, file:sizes.txt or cap:field.cap\n"
+           "\t-T: sample TCP_INFO of every connection at this interval\n"
+           "\t-O: TCP_INFO samples file, .json for JSON, default tcpinfo.csv\n"
+           "\t-X: impairment proxy, server connects every accepted connection to ip:port\n"
+           "\t-J: impairments delay=20ms,jitter=2ms,rate=10M, loss/dup/reorder are left to tcp\n"
+           "\t-A: agent, run server and client roles for a controller on this control port\n"
+           "\t-K: controller, run the plan file on agents and print a merged report\n"
+           "\t    plan lines: server|client <agent ip:port> <tcp arguments>\n"
+           "\t--soak: run until ctrl+c with per second/minute/hour statistics in fixed memory,\n"
+           "\t    no hex dump, client ping-pongs 256 bytes, history is saved to and resumed from file\n"
+           "\t-Q: soak degradation threshold against the last hour, percent, default 30\n"
+           "\t-z: bulk receive, server recv into page aligned 256KB buffers and discards\n"
+           "\t-Z: bulk receive, server maps received pages with TCP_ZEROCOPY_RECEIVE, falls back to -z\n"
+           "\t    client with -z/-Z streams -n 64KB chunks without echo, both print cpu per GB\n"
            "Example: tcp -s -i 192.168.1.200 -p 8080\n"
            "Example: tcp -c -i 192.168.1.200 -p 8080\n"
+           "Example: tcp -s -i 192.168.1.200 -p 8080 -B 50 -F 50\n"
+           "Example: tcp -c -i 192.168.1.200 -p 8080 -n 100000 -B 50\n"
+           "Example: tcp -s -i 192.168.1.200 -p 8080 -E\n"
+           "Example: tcp -c -i 192.168.1.200 -p 8080 -e -n 100000\n"
+           "Example: tcp -s -i 192.168.1.200 -p 8080 -C field.cap\n"
+           "Example: tcp -c -i 192.168.1.200 -p 8080 -R field.cap -x 1\n"
+           "Example: tcp -s -i 192.168.1.200 -p 8080 -f echo\n"
+           "Example: tcp -c -i 192.168.1.200 -p 8080 -n 1000000 -f uniform:64-4096\n"
+           "Example: tcp -c -i 192.168.1.200 -p 8080 -e -n 100000 -T 10000 -O bulk.json\n"
+           "Example: tcp -s -p 9000 -X 127.0.0.1:8080 -J delay=20ms,jitter=2ms,rate=10M\n"
+           "Example: tcp -A 7000\n"
+           "Example: tcp -K bulk.plan\n"
+           "Example: tcp -s -i 192.168.1.200 -p 8080 --soak=server.soak\n"
+           "Example: tcp -c -i 192.168.1.200 -p 8080 --soak=client.soak -Q 20\n"
+           "Example: tcp -s -i 192.168.1.200 -p 8080 -Z\n"
+           "Example: tcp -c -i 192.168.1.200 -p 8080 -Z -n 100000\n"
           );
 
     return 0;
@@ -84,7 +235,7 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
     int ret = 0;
     int valid = 0;
 
-    while ((ret = getopt(argc, argv, "sci:p:")) != -1)
+    while ((ret = getopt_long(argc, argv, "sci:p:n:LB:F:eEC:S:R:x:HPf:T:O:X:J:A:K:Q:zZ", s_option, NULL)) != -1)
     {
         switch (ret)
         {
@@ -110,6 +261,78 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
             printf("pPara->port:%d \n",pPara->port);
 #endif
             break;
+        case 'n':
+            pPara->number = strtoul(optarg, NULL, 10);
+            break;
+        case 'L':
+            pPara->latency = 1;
+            break;
+        case 'B':
+            pPara->latency = 1;
+            pPara->busy = strtoul(optarg, NULL, 10);
+            if (pPara->busy == 0) pPara->busy = 1;
+            break;
+        case 'F':
+            pPara->fifo = strtoul(optarg, NULL, 10);
+            break;
+        case 'e':
+            pPara->echo = ECHO_COPY;
+            break;
+        case 'E':
+            pPara->echo = ECHO_SPLICE;
+            break;
+        case 'C':
+            strncpy(pPara->capture, optarg, sizeof(pPara->capture) - 1);
+            break;
+        case 'S':
+            pPara->size = strtoul(optarg, NULL, 10);
+            break;
+        case 'R':
+            strncpy(pPara->replay, optarg, sizeof(pPara->replay) - 1);
+            break;
+        case 'x':
+            pPara->speed = strtod(optarg, NULL);
+            break;
+        case 'H':
+            pPara->huge = 1;
+            break;
+        case 'P':
+            pPara->perf = 1;
+            break;
+        case 'f':
+            strncpy(pPara->frame, optarg, sizeof(pPara->frame) - 1);
+            break;
+        case 'T':
+            pPara->sample = strtoul(optarg, NULL, 10);
+            break;
+        case 'O':
+            strncpy(pPara->output, optarg, sizeof(pPara->output) - 1);
+            break;
+        case 'X':
+            strncpy(pPara->target, optarg, sizeof(pPara->target) - 1);
+            break;
+        case 'J':
+            strncpy(pPara->impair, optarg, sizeof(pPara->impair) - 1);
+            break;
+        case 'A':
+            pPara->agent = strtoul(optarg, NULL, 10);
+            break;
+        case 'K':
+            strncpy(pPara->plan, optarg, sizeof(pPara->plan) - 1);
+            break;
+        case 'W':
+            pPara->soak = 1;
+            if (optarg != NULL) strncpy(pPara->snapshot, optarg, sizeof(pPara->snapshot) - 1);
+            break;
+        case 'Q':
+            pPara->threshold = strtoul(optarg, NULL, 10);
+            break;
+        case 'z':
+            pPara->sink = SINK_RECV;
+            break;
+        case 'Z':
+            pPara->sink = SINK_ZEROCOPY;
+            break;
         }
     }
 
@@ -121,7 +344,7 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
     }
 
     /* 参数不符合逻辑 */
-    if ((valid != 1))
+    if (((valid != 1) && !pPara->agent && !pPara->plan[0]) || (pPara->target[0] && !pPara->mode))
     {
         print_usage();
         return -1;
@@ -141,6 +364,21 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
     @note       函数根据模式分别调用发送和接收函数。
 */
 int main(int argc, char *argv[])
+{
+    return tcp_main(argc, argv);
+}
+
+/**
+    @fn         static int tcp_main(int argc, char *argv[])
+    @brief      按命令行参数运行一次测试
+    @author     agent
+    @param[in]  argc        int         参数个数
+    @param[in]  argv        char**      参数指针数组
+    @retval     0 成功
+    @retval     -1 失败
+    @note       代理收到协调端的run命令后, 在子进程中用命令中的参数再次调用本函数.
+*/
+static int tcp_main(int argc, char *argv[])
 {
     int ret = 0;
     Para_t para;
@@ -148,6 +386,11 @@ int main(int argc, char *argv[])
     /* 默认参数 */
     memset(&para, 0x00, sizeof(Para_t));
     para.port = 8080;
+    para.number = 1;
+    para.size = CAPTURE_SIZE;
+    para.speed = 1;
+    para.threshold = SOAK_THRESHOLD;
+    strcpy(para.output, "tcpinfo.csv");
 
     /* 解析参数 */
     ret = parse_usage(argc, argv, &para);
@@ -157,8 +400,54 @@ int main(int argc, char *argv[])
         goto Exit;
     }
 
+    /* 代理和协调端 */
+    if (para.agent)
+    {
+        return agent_run(para.agent, tcp_main, argv[0]);
+    }
+    if (para.plan[0] != 0)
+    {
+        return ctl_run(para.plan);
+    }
+
     printf("%s ip=0x%x port=%d\n", s_string[para.mode],para.ip, para.port);
 
+    /* 收发缓冲在启动时一次分配 */
+    ret = pool_init(&s_pool, ECHO_BUFFER, POOL_COUNT, para.huge ? (POOL_HUGE | POOL_LOCK) : 0);
+    if (ret != 0)
+    {
+        ret = -1;
+        goto Exit;
+    }
+
+    if (para.perf)
+    {
+        perf_init();
+    }
+
+    if (para.sample && (sampler_start(&s_sampler, para.sample) != 0))
+    {
+        ret = -1;
+        goto Exit;
+    }
+
+    /* 协调端发送stop时按ctrl+c结束 */
+    if (ctl_agent())
+    {
+        install_quit();
+    }
+
+    /* 浸泡测试, ctrl+c后保存快照 */
+    if (para.soak)
+    {
+        if (soak_init(&s_soak, para.snapshot, para.threshold) != 0)
+        {
+            ret = -1;
+            goto Exit;
+        }
+        install_quit();
+    }
+
     if (para.mode)
     {
         ret = tcp_server(&para);
@@ -168,6 +457,16 @@ int main(int argc, char *argv[])
         ret = tcp_client(&para);
     }
 
+    if (para.soak)
+    {
+        soak_close(&s_soak);
+    }
+
+    sampler_stop(&s_sampler);
+    pool_print(&s_pool);
+    pool_destroy(&s_pool);
+    perf_exit();
+
 Exit:
     return ret;
 }
@@ -192,11 +491,15 @@ static int tcp_server(Para_t *pPara)
     struct sockaddr_in client;
     socklen_t socketLength = 0;
     int length = 0;
-    int sum = 0;
+    uint64_t sum = 0;
+    uint64_t messages = 0;
+    uint64_t start = 0;
+    Capture_t capture;
 
     /* 必须清零 */
     memset(&server, 0x00, sizeof(struct sockaddr_in));
     memset(&client, 0x00, sizeof(struct sockaddr_in));
+    memset(&capture, 0x00, sizeof(Capture_t));
 
     for (i = 0; i < 256; i++)
     {
@@ -236,31 +539,147 @@ static int tcp_server(Para_t *pPara)
         perror("Listen err:");
         goto Exit;
     }
+    ctl_ready();
+
+    /* 浸泡测试, 没有连接时也每秒统计一次 */
+    if (pPara->soak)
+    {
+        soak_timeout(fd_server);
+    }
 
 #if DEBUG
     printf("The server is listenning...\n");
     printf("Before accept:socktfd_client is %d\n",fd_client);
 #endif
 
+    /* 抓包模式, 所有连接写入同一个文件 */
+    if (pPara->capture[0] != 0)
+    {
+        if (capture_open(&capture, pPara->capture, pPara->size) != 0)
+        {
+            ret = -3;
+            goto Exit;
+        }
+        install_quit();
+    }
+
+    /* 代理模式, ctrl+c打印统计后退出 */
+    if (pPara->target[0] != 0)
+    {
+        install_quit();
+    }
+
     for(;;)
     {
-        printf("press ctrl+c to quit.\n");
+        /* 浸泡测试accept超时后不重复打印 */
+        if (fd_client != -1)
+        {
+            printf("press ctrl+c to quit.\n");
+        }
+        socketLength = sizeof(client);
         if( (fd_client = accept(fd_server, (struct sockaddr*)&client,&socketLength)) == -1 )
         {
-            perror("accept err:");
+            if (pPara->soak && !s_quit && (errno == EAGAIN))
+            {
+                soak_add(&s_soak, 0, 0, 0, -1);
+                continue;
+            }
+
+            if (!s_quit)
+            {
+                perror("accept err:");
+            }
             goto Exit;
         }
-        
+        sampler_add(&s_sampler, fd_client);
+
+        /* 代理模式, 连接目的地址后双向转发 */
+        if (pPara->target[0] != 0)
+        {
+            tcp_proxy(fd_client, pPara);
+            conn_close(fd_client, pPara);
+            continue;
+        }
+
+        /* 延时测试模式, 只回应不打印 */
+        if (pPara->latency)
+        {
+            lat_server(fd_client, pPara);
+            conn_close(fd_client, pPara);
+            continue;
+        }
+
+        /* 抓包模式, 回应但不打印 */
+        if (pPara->capture[0] != 0)
+        {
+            cap_server(fd_client, &capture);
+            conn_close(fd_client, pPara);
+            continue;
+        }
+
+        /* 分帧回应模式 */
+        if (pPara->frame[0] != 0)
+        {
+            frame_server(fd_client, pPara);
+            conn_close(fd_client, pPara);
+            continue;
+        }
+
+        /* 批量接收模式 */
+        if (pPara->sink)
+        {
+            sink_server(fd_client, pPara);
+            conn_close(fd_client, pPara);
+            continue;
+        }
+
+        /* 批量回应模式 */
+        if (pPara->echo != ECHO_PRINT)
+        {
+            echo_server(fd_client, pPara);
+            conn_close(fd_client, pPara);
+            continue;
+        }
+
+        if (pPara->soak)
+        {
+            soak_timeout(fd_client);
+        }
+
+        perf_begin();
+        start = clock_ns(CLOCK_MONOTONIC);
+        messages = 0;
+        sum = 0;
         while(1)
         {
             length = recv(fd_client,buffer,sizeof(buffer), 0);
 
+            /* 浸泡测试接收超时, 统计一个空秒 */
+            if (pPara->soak && (length < 0) && (errno == EAGAIN) && !s_quit)
+            {
+                soak_add(&s_soak, 0, 0, 0, -1);
+                continue;
+            }
+
             // 当client关闭连接时recv返回0，当发生错误时返回-1，无论哪种情况都跳转到accept
             if(length <= 0)
             {
                 break;
             }
 
+            /* 浸泡测试不打印, 只回应和统计 */
+            if (pPara->soak)
+            {
+                if (send_all(fd_client, buffer, length) != length)
+                {
+                    break;
+                }
+                soak_add(&s_soak, 1, length, 0, -1);
+                messages++;
+                sum += length;
+                continue;
+            }
+
             printf("--- ");
             for (i = 0; i < length; i++)
             {
@@ -270,12 +689,28 @@ static int tcp_server(Para_t *pPara)
 
             printf("---length%u tcp port=%d\n", length, pPara->port);
 
-            /* 回应接收到的数据 */
-            sendto(fd_client, buffer, length, 0, (struct sockaddr *)&server, socketLength);
+            /* 回应接收到的数据, 已连接的套接字不需要目的地址 */
+            if (send_all(fd_client, buffer, length) != length)
+            {
+                break;
+            }
+            messages++;
+            sum += length;
+        }
+        perf_end("tcp server", messages, sum);
+        ctl_result(pPara->soak ? "soak" : "server", messages, sum, 0, clock_ns(CLOCK_MONOTONIC) - start, NULL);
+
+        conn_close(fd_client, pPara);
+
+        if (s_quit)
+        {
+            goto Exit;
         }
     }
 
 Exit:
+    capture_close(&capture);
+
     /* 关闭套接字 */
     if (fd_server != 0)
     {
@@ -293,9 +728,8 @@ static int tcp_client(Para_t *pPara)
     struct sockaddr_in client;
     unsigned char buffer[256];
     int length = 0;
-    int sum = 0;
     int i = 0;
-    socklen_t socketLength = 0;
+    uint64_t start = 0;
 
     for(i = 0; i < sizeof(buffer); i++)
     {
@@ -328,7 +762,52 @@ static int tcp_client(Para_t *pPara)
         perror("Connext err:");
         goto Exit;        
     }
+    sampler_add(&s_sampler, fd_client);
+
+    /* 延时测试模式 */
+    if (pPara->latency)
+    {
+        ret = lat_client(fd_client, pPara);
+        goto Exit;
+    }
+
+    /* 分帧测试 */
+    if (pPara->frame[0] != 0)
+    {
+        ret = frame_client(fd_client, pPara);
+        goto Exit;
+    }
+
+    /* 批量接收测试 */
+    if (pPara->sink)
+    {
+        ret = sink_client(fd_client, pPara);
+        goto Exit;
+    }
+
+    /* 批量回应测试 */
+    if (pPara->echo != ECHO_PRINT)
+    {
+        ret = bulk_client(fd_client, pPara);
+        goto Exit;
+    }
+
+    /* 回放模式 */
+    if (pPara->replay[0] != 0)
+    {
+        ret = cap_client(fd_client, pPara);
+        goto Exit;
+    }
 
+    /* 浸泡测试 */
+    if (pPara->soak)
+    {
+        ret = soak_client(fd_client, pPara);
+        goto Exit;
+    }
+
+    perf_begin();
+    start = clock_ns(CLOCK_MONOTONIC);
     length = send(fd_client, buffer, sizeof(buffer), 0);
     if(length > 0)
     {
@@ -337,7 +816,7 @@ static int tcp_client(Para_t *pPara)
 
     printf("Wait for a response from server.\n");
     memset(buffer, 0 ,sizeof(buffer));
-    length = recvfrom(fd_client, buffer, sizeof(buffer), 0, (struct sockaddr *)&client, &socketLength);
+    length = recv_full(fd_client, buffer, sizeof(buffer), pPara);
 
     printf("--- ");
     for (i = 0; i < length; i++)
@@ -346,12 +825,1538 @@ static int tcp_client(Para_t *pPara)
         if (((i + 1) % 16) == 0) printf("\n    ");
     }
     printf("---length = %u udp client\n",length);
+    perf_end("tcp client", 1, sizeof(buffer) + (length > 0 ? length : 0));
+    ctl_result("client", 1, sizeof(buffer) + (length > 0 ? length : 0), length != sizeof(buffer),
+               clock_ns(CLOCK_MONOTONIC) - start, NULL);
 
 Exit:
     if (fd_client != -1)
     {
-        close(fd_client);
+        conn_close(fd_client, pPara);
     }
 
     return ret;
 }
+
+/**
+    @fn         static int lat_prepare(int fd, Para_t *pPara)
+    @brief      设置延时测试连接
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       关闭Nagle, 按参数打开busy poll和SCHED_FIFO.
+*/
+static int lat_prepare(int fd, Para_t *pPara)
+{
+    int opt = 1;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&opt, sizeof(opt));
+
+    if (pPara->busy && (lowlat_socket(fd, pPara->busy) != 0))
+    {
+        return -1;
+    }
+
+    if (pPara->fifo)
+    {
+        lowlat_realtime(pPara->fifo);
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int recv_full(int fd, unsigned char *buffer, int length, Para_t *pPara)
+    @brief      接收指定长度的数据
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[out] buffer      char*       接收缓冲
+    @param[in]  length      int         要接收的长度
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     length 成功
+    @retval     <=0 对端关闭或出错
+    @note       tcp是字节流, 一次recv不一定能收完整个回应.
+*/
+static int recv_full(int fd, unsigned char *buffer, int length, Para_t *pPara)
+{
+    int got = 0;
+    int ret = 0;
+
+    while (got < length)
+    {
+        if (pPara->busy)
+        {
+            ret = lowlat_recvfrom(fd, buffer + got, length - got, 0, NULL, NULL, NULL);
+        }
+        else
+        {
+            ret = recv(fd, buffer + got, length - got, 0);
+        }
+
+        if (ret <= 0)
+        {
+            return ret;
+        }
+        got += ret;
+    }
+
+    return got;
+}
+
+/**
+    @fn         static int lat_server(int fd, Para_t *pPara)
+    @brief      延时测试的回应端
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       收到什么回应什么, 连接关闭时打印CPU开销.
+*/
+static int lat_server(int fd, Para_t *pPara)
+{
+    unsigned char buffer[256];
+    int length = 0;
+    int cpu = -1;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    Cost_t cost;
+
+    if (lat_prepare(fd, pPara) != 0)
+    {
+        return -1;
+    }
+
+    cost_start(&cost);
+    perf_begin();
+    for (;;)
+    {
+        if (pPara->busy)
+        {
+            length = lowlat_recvfrom(fd, buffer, sizeof(buffer), 0, NULL, NULL, NULL);
+        }
+        else
+        {
+            length = recv(fd, buffer, sizeof(buffer), 0);
+        }
+
+        if (length <= 0)
+        {
+            break;
+        }
+
+        if (pPara->busy && (cpu < 0))
+        {
+            cpu = lowlat_pin(fd, pPara->fifo);
+            printf("pinned cpu=%d\n", cpu);
+        }
+
+        if (send(fd, buffer, length, 0) != length)
+        {
+            break;
+        }
+
+        messages++;
+        bytes += length;
+    }
+
+    cost_print(&cost, pPara->busy ? "busy-poll" : "blocking", messages, bytes);
+    perf_end(pPara->busy ? "busy-poll" : "blocking", messages, bytes);
+    ctl_result("echo", messages, bytes, 0, 0, NULL);
+
+    return 0;
+}
+
+/**
+    @fn         static int lat_client(int fd, Para_t *pPara)
+    @brief      延时测试的发起端
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       发送256字节后等待完整回应, 统计往返时间直方图和CPU开销.
+*/
+static int lat_client(int fd, Para_t *pPara)
+{
+    unsigned char buffer[256];
+    unsigned char echo[256];
+    int i = 0;
+    int cpu = -1;
+    uint64_t start = 0;
+    uint64_t first = 0;
+    const char *name = pPara->busy ? "busy-poll" : "blocking";
+    Hist_t hist;
+    Cost_t cost;
+
+    for (i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = i;
+    }
+
+    if (lat_prepare(fd, pPara) != 0)
+    {
+        return -1;
+    }
+
+    hist_init(&hist, name);
+    cost_start(&cost);
+    perf_begin();
+    first = clock_ns(CLOCK_MONOTONIC);
+    for (i = 0; i < pPara->number; i++)
+    {
+        start = clock_ns(CLOCK_MONOTONIC);
+        if (send(fd, buffer, sizeof(buffer), 0) != sizeof(buffer))
+        {
+            printf("send failed!%d\n", errno);
+            break;
+        }
+
+        if (recv_full(fd, echo, sizeof(echo), pPara) != sizeof(echo))
+        {
+            printf("recv failed!%d\n", errno);
+            break;
+        }
+        hist_add(&hist, (int64_t)(clock_ns(CLOCK_MONOTONIC) - start));
+
+        if (pPara->busy && (cpu < 0))
+        {
+            cpu = lowlat_pin(fd, pPara->fifo);
+            printf("pinned cpu=%d\n", cpu);
+        }
+    }
+
+    printf("=== tcp round trip, port=%d ===\n", pPara->port);
+    hist_print(&hist);
+    cost_print(&cost, name, i, (uint64_t)i * sizeof(buffer));
+    perf_end(name, i, (uint64_t)i * sizeof(buffer));
+    ctl_result(name, i, (uint64_t)i * sizeof(buffer), pPara->number - i, clock_ns(CLOCK_MONOTONIC) - first, &hist);
+
+    return (i == pPara->number) ? 0 : -1;
+}
+
+/**
+    @fn         static int send_all(int fd, const unsigned char *buffer, int length)
+    @brief      发送全部数据
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  buffer      char*       数据
+    @param[in]  length      int         长度
+    @retval     length 成功
+    @retval     -1 失败
+    @note       send可能只发送一部分, 需要循环直到发完.
+*/
+static int send_all(int fd, const unsigned char *buffer, int length)
+{
+    int sent = 0;
+    int ret = 0;
+
+    while (sent < length)
+    {
+        ret = send(fd, buffer + sent, length - sent, 0);
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        sent += ret;
+    }
+
+    return sent;
+}
+
+/**
+    @fn         static int echo_copy(int fd, uint64_t *pBytes)
+    @brief      用户态大缓冲回应
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[out] pBytes      uint64_t*   回应的字节数
+    @retval     0 对端关闭
+    @retval     -1 失败
+*/
+static int echo_copy(int fd, uint64_t *pBytes)
+{
+    int length = 0;
+    unsigned char *buffer = pool_get(&s_pool);
+
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    for (;;)
+    {
+        length = recv(fd, buffer, s_pool.size, 0);
+        if (length <= 0)
+        {
+            break;
+        }
+
+        if (send_all(fd, buffer, length) != length)
+        {
+            length = -1;
+            break;
+        }
+        *pBytes += length;
+    }
+
+    pool_put(&s_pool, buffer);
+
+    return length;
+}
+
+/**
+    @fn         static int echo_splice(int fd, uint64_t *pBytes)
+    @brief      用splice在内核中回应
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[out] pBytes      uint64_t*   回应的字节数
+    @retval     0 对端关闭
+    @retval     -1 失败
+    @retval     -2 不支持splice, 需要退回用户态
+    @note       数据从socket进入管道再回到socket, 不经过用户态缓冲.
+*/
+static int echo_splice(int fd, uint64_t *pBytes)
+{
+    int ret = 0;
+    int pipefd[2] = {-1, -1};
+    ssize_t length = 0;
+    ssize_t sent = 0;
+
+    if (pipe(pipefd) == -1)
+    {
+        printf("pipe failed!%d\n", errno);
+        return -2;
+    }
+
+    /* 管道越大每次搬运越多, 失败则用默认的64KB */
+    fcntl(pipefd[1], F_SETPIPE_SZ, ECHO_PIPE);
+
+    for (;;)
+    {
+        length = splice(fd, NULL, pipefd[1], NULL, ECHO_PIPE, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (length == 0)
+        {
+            ret = 0;
+            break;
+        }
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ret = ((errno == EINVAL) && (*pBytes == 0)) ? -2 : -1;
+            break;
+        }
+
+        /* 管道中的数据必须全部送出, 否则下一次splice会阻塞 */
+        while (length > 0)
+        {
+            sent = splice(pipefd[0], NULL, fd, NULL, length, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (sent <= 0)
+            {
+                if ((sent == -1) && (errno == EINTR))
+                {
+                    continue;
+                }
+                ret = -1;
+                goto Exit;
+            }
+            length -= sent;
+            *pBytes += sent;
+        }
+    }
+
+Exit:
+    close(pipefd[0]);
+    close(pipefd[1]);
+
+    return ret;
+}
+
+/**
+    @fn         static int echo_server(int fd, Para_t *pPara)
+    @brief      批量回应一个连接
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       连接关闭后打印回应速率和CPU开销.
+*/
+static int echo_server(int fd, Para_t *pPara)
+{
+    int ret = 0;
+    int mode = pPara->echo;
+    uint64_t bytes = 0;
+    uint64_t start = 0;
+    double seconds = 0;
+    Cost_t cost;
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    cost_start(&cost);
+    perf_begin();
+
+    if (mode == ECHO_SPLICE)
+    {
+        ret = echo_splice(fd, &bytes);
+        if (ret == -2)
+        {
+            printf("splice unsupported, fall back to copy\n");
+            mode = ECHO_COPY;
+        }
+    }
+
+    if (mode == ECHO_COPY)
+    {
+        ret = echo_copy(fd, &bytes);
+    }
+
+    seconds = (clock_ns(CLOCK_MONOTONIC) - start) / 1e9;
+    printf("echo %s: bytes=%llu time=%.3fs rate=%.3fGbps\n", s_echo[mode], (unsigned long long)bytes,
+           seconds, seconds > 0 ? bytes * 8 / seconds / 1e9 : 0.0);
+    cost_print(&cost, s_echo[mode], 0, bytes);
+    perf_end(s_echo[mode], 0, bytes);
+    ctl_result(s_echo[mode], 0, bytes, 0, (uint64_t)(seconds * 1e9), NULL);
+
+    return ret;
+}
+
+/**
+    @fn         static int bulk_client(int fd, Para_t *pPara)
+    @brief      批量回应测试的发起端
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       发送和接收同时进行, 否则双方缓冲填满后会互相等待.
+                接收到的数据按0-255规律校验.
+*/
+static int bulk_client(int fd, Para_t *pPara)
+{
+    int i = 0;
+    int ret = 0;
+    int length = 0;
+    int flags = 0;
+    int errors = 0;             /* 校验失败的接收次数 */
+    uint64_t total = (uint64_t)pPara->number * BULK_CHUNK;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t start = 0;
+    double seconds = 0;
+    unsigned char *pSend = pool_get(&s_pool);
+    unsigned char *pRecv = pSend + BULK_CHUNK * 2;
+    struct pollfd pfd;
+    Cost_t cost;
+
+    if (pSend == NULL)
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    /* 发送缓冲多放一个周期, 任意偏移开始都是连续的0-255 */
+    for (i = 0; i < BULK_CHUNK * 2; i++)
+    {
+        pSend[i] = i;
+    }
+
+    flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    cost_start(&cost);
+    perf_begin();
+    while (received < total)
+    {
+        pfd.fd = fd;
+        pfd.events = POLLIN | ((sent < total) ? POLLOUT : 0);
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 1000) <= 0)
+        {
+            printf("poll timeout!%d\n", errno);
+            ret = -1;
+            break;
+        }
+
+        if ((pfd.revents & POLLOUT) && (sent < total))
+        {
+            length = BULK_CHUNK;
+            if (total - sent < length) length = total - sent;
+            length = send(fd, pSend + (sent & 0xFF), length, 0);
+            if (length > 0)
+            {
+                sent += length;
+            }
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            length = recv(fd, pRecv, BULK_CHUNK, 0);
+            if (length == 0)
+            {
+                printf("server closed!\n");
+                ret = -1;
+                break;
+            }
+            if (length > 0)
+            {
+                if (memcmp(pRecv, pSend + (received & 0xFF), length) != 0)
+                {
+                    errors++;
+                }
+                received += length;
+            }
+        }
+    }
+
+    seconds = (clock_ns(CLOCK_MONOTONIC) - start) / 1e9;
+    printf("bulk echo: sent=%llu received=%llu errors=%d time=%.3fs rate=%.3fGbps\n",
+           (unsigned long long)sent, (unsigned long long)received, errors, seconds,
+           seconds > 0 ? received * 8 / seconds / 1e9 : 0.0);
+    cost_print(&cost, "bulk", 0, sent + received);
+    perf_end("bulk", 0, sent + received);
+    ctl_result("bulk", 0, received, errors, (uint64_t)(seconds * 1e9), NULL);
+    pool_put(&s_pool, pSend);
+
+    return (errors == 0) ? ret : -1;
+}
+
+/**
+    @fn         static int sink_recv(int fd, uint64_t *pBytes)
+    @brief      recv到页对齐的大缓冲后丢弃
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[out] pBytes      uint64_t*   接收的字节数
+    @retval     0 对端关闭
+    @retval     -1 失败
+*/
+static int sink_recv(int fd, uint64_t *pBytes)
+{
+    int length = 0;
+    unsigned char *buffer = pool_get(&s_pool);
+
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    for (;;)
+    {
+        length = recv(fd, buffer, s_pool.size, 0);
+        if (length <= 0)
+        {
+            if ((length == -1) && (errno == EINTR))
+            {
+                continue;
+            }
+            break;
+        }
+        *pBytes += length;
+    }
+
+    pool_put(&s_pool, buffer);
+
+    return length;
+}
+
+/**
+    @fn         static int sink_zerocopy(int fd, uint64_t *pBytes, uint64_t *pMapped)
+    @brief      用TCP_ZEROCOPY_RECEIVE把接收到的页映射到用户态
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[out] pBytes      uint64_t*   接收的字节数
+    @param[out] pMapped     uint64_t*   其中映射(没有拷贝)的字节数
+    @retval     0 对端关闭
+    @retval     -1 失败
+    @retval     -2 不支持零拷贝接收, 需要退回recv
+    @note       映射区只读, 下一次getsockopt会先解除上一次的映射.
+                不足一页或没有页对齐的数据(recv_skip_hint)仍然要recv拷贝出来.
+*/
+static int sink_zerocopy(int fd, uint64_t *pBytes, uint64_t *pMapped)
+{
+    int ret = 0;
+    int length = 0;
+    unsigned char *region = NULL;
+    unsigned char *buffer = NULL;
+    struct tcp_zerocopy_receive zc;
+    socklen_t zcLength = 0;
+    struct pollfd pfd;
+
+    region = mmap(NULL, SINK_REGION, PROT_READ, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED)
+    {
+        printf("mmap socket failed!%d\n", errno);
+        return -2;
+    }
+
+    buffer = pool_get(&s_pool);
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        ret = -1;
+        goto Exit;
+    }
+
+    for (;;)
+    {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("poll failed!%d\n", errno);
+            ret = -1;
+            break;
+        }
+
+        memset(&zc, 0x00, sizeof(zc));
+        zc.address = (uint64_t)(unsigned long)region;
+        zc.length = SINK_REGION;
+        zcLength = sizeof(zc);
+        if (getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zcLength) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            /* 没有数据并且对端已关闭 */
+            if (errno == EIO)
+            {
+                ret = 0;
+                break;
+            }
+
+            ret = (*pBytes == 0) ? -2 : -1;
+            if (ret == -1)
+            {
+                printf("getsockopt failed(TCP_ZEROCOPY_RECEIVE)!%d\n", errno);
+            }
+            break;
+        }
+
+        *pBytes += zc.length;
+        *pMapped += zc.length;
+
+        /* 没有映射的数据从socket拷贝出来, 两者都为0时recv判断对端是否关闭 */
+        if ((zc.recv_skip_hint != 0) || (zc.length == 0))
+        {
+            length = recv(fd, buffer, (zc.recv_skip_hint != 0) ? zc.recv_skip_hint : s_pool.size, 0);
+            if (length == 0)
+            {
+                ret = 0;
+                break;
+            }
+            if (length == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                ret = -1;
+                break;
+            }
+            *pBytes += length;
+        }
+    }
+
+Exit:
+    if (buffer != NULL)
+    {
+        pool_put(&s_pool, buffer);
+    }
+    munmap(region, SINK_REGION);
+
+    return ret;
+}
+
+/**
+    @fn         static int sink_server(int fd, Para_t *pPara)
+    @brief      批量接收一个连接
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       只接收不回应, 连接关闭后打印速率和每GB的CPU时间.
+                两种方式都设置SO_RCVLOWAT, 每次唤醒处理的数据量相同.
+*/
+static int sink_server(int fd, Para_t *pPara)
+{
+    int ret = 0;
+    int mode = pPara->sink;
+    int lowat = SINK_LOWAT;
+    uint64_t bytes = 0;
+    uint64_t mapped = 0;
+    uint64_t start = 0;
+    double seconds = 0;
+    Cost_t cost;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVLOWAT, &lowat, sizeof(lowat));
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    cost_start(&cost);
+    perf_begin();
+
+    if (mode == SINK_ZEROCOPY)
+    {
+        ret = sink_zerocopy(fd, &bytes, &mapped);
+        if (ret == -2)
+        {
+            printf("zerocopy receive unsupported, fall back to recv\n");
+            mode = SINK_RECV;
+        }
+    }
+
+    if (mode == SINK_RECV)
+    {
+        ret = sink_recv(fd, &bytes);
+    }
+
+    seconds = (clock_ns(CLOCK_MONOTONIC) - start) / 1e9;
+    printf("sink %s: bytes=%llu mapped=%llu copied=%llu time=%.3fs rate=%.3fGbps\n", s_sink[mode],
+           (unsigned long long)bytes, (unsigned long long)mapped, (unsigned long long)(bytes - mapped),
+           seconds, seconds > 0 ? bytes * 8 / seconds / 1e9 : 0.0);
+    cost_print(&cost, s_sink[mode], 0, bytes);
+    perf_end(s_sink[mode], 0, bytes);
+    ctl_result(s_sink[mode], 0, bytes, 0, (uint64_t)(seconds * 1e9), NULL);
+
+    return ret;
+}
+
+/**
+    @fn         static int sink_client(int fd, Para_t *pPara)
+    @brief      批量接收测试的发送端
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       连续发送-n个64KB, 不等待回应.
+*/
+static int sink_client(int fd, Para_t *pPara)
+{
+    int i = 0;
+    int ret = 0;
+    uint64_t sent = 0;
+    uint64_t start = 0;
+    double seconds = 0;
+    unsigned char *pSend = pool_get(&s_pool);
+    Cost_t cost;
+
+    if (pSend == NULL)
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    for (i = 0; i < BULK_CHUNK; i++)
+    {
+        pSend[i] = i;
+    }
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    cost_start(&cost);
+    perf_begin();
+    for (i = 0; i < pPara->number; i++)
+    {
+        if (send_all(fd, pSend, BULK_CHUNK) != BULK_CHUNK)
+        {
+            printf("send failed!%d\n", errno);
+            ret = -1;
+            break;
+        }
+        sent += BULK_CHUNK;
+    }
+
+    /* 等对端收完关闭, 时间才包括全部数据 */
+    shutdown(fd, SHUT_WR);
+    while (recv(fd, pSend, BULK_CHUNK, 0) > 0)
+    {
+    }
+
+    seconds = (clock_ns(CLOCK_MONOTONIC) - start) / 1e9;
+    printf("sink send: sent=%llu time=%.3fs rate=%.3fGbps\n", (unsigned long long)sent, seconds,
+           seconds > 0 ? sent * 8 / seconds / 1e9 : 0.0);
+    cost_print(&cost, "sink send", 0, sent);
+    perf_end("sink send", 0, sent);
+    ctl_result("sink-send", 0, sent, 0, (uint64_t)(seconds * 1e9), NULL);
+    pool_put(&s_pool, pSend);
+
+    return ret;
+}
+
+/**
+    @fn         static void signal_quit(int sig)
+    @brief      ctrl+c信号处理
+    @author     agent
+    @param[in]  sig         int         信号
+    @note       只设置退出标志, 阻塞的accept/recv会以EINTR返回.
+*/
+static void signal_quit(int sig)
+{
+    s_quit = 1;
+}
+
+/**
+    @fn         static void install_quit(void)
+    @brief      安装ctrl+c信号处理
+    @author     agent
+    @note       不设置SA_RESTART, 让阻塞的系统调用返回, 以便关闭抓包文件.
+*/
+static void install_quit(void)
+{
+    struct sigaction action;
+
+    memset(&action, 0x00, sizeof(struct sigaction));
+    action.sa_handler = signal_quit;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+/**
+    @fn         static int cap_server(int fd, Capture_t *pCapture)
+    @brief      接收数据写入抓包文件并回应
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pCapture    Capture_t*  抓包文件
+    @retval     0 对端关闭
+    @retval     -1 失败或退出
+    @note       每次recv返回的数据为一条记录, 记录时间即到达时间.
+*/
+static int cap_server(int fd, Capture_t *pCapture)
+{
+    int length = -1;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t start = clock_ns(CLOCK_MONOTONIC);
+    unsigned char *buffer = pool_get(&s_pool);
+
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    perf_begin();
+    while (!s_quit)
+    {
+        length = recv(fd, buffer, s_pool.size, 0);
+        if (length <= 0)
+        {
+            break;
+        }
+
+        capture_write(pCapture, buffer, length, 0);
+
+        if (send_all(fd, buffer, length) != length)
+        {
+            length = -1;
+            break;
+        }
+        messages++;
+        bytes += length;
+    }
+    perf_end("tcp capture", messages, bytes);
+    ctl_result("capture", messages, bytes, length < 0, clock_ns(CLOCK_MONOTONIC) - start, NULL);
+
+    pool_put(&s_pool, buffer);
+
+    return s_quit ? -1 : length;
+}
+
+/**
+    @fn         static int cap_client(int fd, Para_t *pPara)
+    @brief      按抓包文件的长度和时间间隔回放
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       服务端会回应数据, 每次发送后把回应读掉, 避免双方缓冲填满.
+*/
+static int cap_client(int fd, Para_t *pPara)
+{
+    int ret = 0;
+    int length = 0;
+    Capture_t capture;
+    CaptureRecord_t *record = NULL;
+    uint64_t first = 0;
+    uint64_t last = 0;
+    uint64_t start = 0;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t echo = 0;
+    unsigned char *buffer = NULL;
+
+    if (capture_load(&capture, pPara->replay) != 0)
+    {
+        return -3;
+    }
+
+    buffer = pool_get(&s_pool);
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        capture_close(&capture);
+        return -1;
+    }
+
+    printf("replay %s records=%llu speed=%.2f\n", pPara->replay,
+           (unsigned long long)capture.head->records, pPara->speed);
+    start = clock_ns(CLOCK_MONOTONIC);
+    perf_begin();
+    while ((record = capture_next(&capture)) != NULL)
+    {
+        if (records == 0)
+        {
+            first = record->time;
+        }
+        last = record->time;
+        capture_wait(first, start, record->time, pPara->speed);
+
+        if (send_all(fd, (unsigned char *)(record + 1), record->length) != record->length)
+        {
+            printf("send failed!%d\n", errno);
+            ret = -21;
+            break;
+        }
+        records++;
+        bytes += record->length;
+
+        while ((length = recv(fd, buffer, s_pool.size, MSG_DONTWAIT)) > 0)
+        {
+            echo += length;
+        }
+    }
+
+    /* 关闭发送方向后收完剩余回应, 发送失败时不再等待, 保留发送的错误码 */
+    shutdown(fd, SHUT_WR);
+    while ((ret == 0) && (echo < bytes))
+    {
+        length = recv(fd, buffer, s_pool.size, 0);
+        if (length < 0)
+        {
+            printf("recv failed!%d\n", errno);
+            ret = -1;
+            break;
+        }
+        if (length == 0)
+        {
+            break;
+        }
+        echo += length;
+    }
+
+    printf("replayed records=%llu bytes=%llu echo=%llu captured %.3fs replayed %.3fs\n",
+           (unsigned long long)records, (unsigned long long)bytes, (unsigned long long)echo,
+           (last - first) / 1e9, (clock_ns(CLOCK_MONOTONIC) - start) / 1e9);
+    perf_end("tcp replay", records, bytes + echo);
+    ctl_result("replay", records, bytes + echo, ret != 0, clock_ns(CLOCK_MONOTONIC) - start, NULL);
+    capture_close(&capture);
+    pool_put(&s_pool, buffer);
+
+    return ret;
+}
+
+/**
+    @fn         static void frame_report(const char *name, Frame_t *pFrame, FrameBatch_t *pBatch, uint64_t start)
+    @brief      打印分帧收发统计
+    @author     agent
+    @param[in]  name        char*           名称
+    @param[in]  pFrame      Frame_t*        接收解析器
+    @param[in]  pBatch      FrameBatch_t*   发送批次
+    @param[in]  start       uint64_t        开始时间, CLOCK_MONOTONIC
+*/
+static void frame_report(const char *name, Frame_t *pFrame, FrameBatch_t *pBatch, uint64_t start)
+{
+    double seconds = (clock_ns(CLOCK_MONOTONIC) - start) / 1e9;
+
+    if (seconds <= 0) seconds = 1e-9;
+    printf("%s: messages=%llu bytes=%llu time=%.3fs %.0fmsgs/s %.3fGbps\n", name,
+           (unsigned long long)pFrame->frames, (unsigned long long)pFrame->bytes, seconds,
+           pFrame->frames / seconds, pFrame->bytes * 8 / seconds / 1e9);
+    printf("%s: recvs=%llu msgs/recv=%.2f writevs=%llu msgs/writev=%.2f moves=%llu\n", name,
+           (unsigned long long)pFrame->recvs, pFrame->recvs ? (double)pFrame->frames / pFrame->recvs : 0,
+           (unsigned long long)pBatch->writes, pBatch->writes ? (double)pBatch->frames / pBatch->writes : 0,
+           (unsigned long long)pFrame->moves);
+}
+
+/**
+    @fn         static int frame_server(int fd, Para_t *pPara)
+    @brief      按消息回应
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 对端关闭
+    @retval     -1 失败
+    @note       一次recv解析出的所有消息原地加入发送批次, 用writev一起回应,
+                回应发完后才接收下一批, 消息内容不拷贝.
+*/
+static int frame_server(int fd, Para_t *pPara)
+{
+    int ret = 0;
+    int opt = 1;
+    uint32_t length = 0;
+    uint64_t start = 0;
+    unsigned char *data = NULL;
+    unsigned char *buffer = pool_get(&s_pool);
+    Frame_t frame;
+    FrameBatch_t batch;
+    Cost_t cost;
+
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&opt, sizeof(opt));
+    frame_init(&frame, buffer, s_pool.size);
+    frame_batch_init(&batch);
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    cost_start(&cost);
+    perf_begin();
+    for (;;)
+    {
+        ret = frame_recv(&frame, fd, 0);
+        if (ret <= 0)
+        {
+            if ((ret == -1) && (errno == EINTR))
+            {
+                continue;
+            }
+            if (ret == -1)
+            {
+                printf("recv failed!%d\n", errno);
+            }
+            break;
+        }
+
+        while ((data = frame_next(&frame, &length)) != NULL)
+        {
+            if (frame_add(&batch, data, length) != 0)
+            {
+                if (frame_flush(&batch, fd) != 1)
+                {
+                    ret = -1;
+                    goto Exit;
+                }
+                frame_add(&batch, data, length);
+            }
+        }
+
+        if (frame_flush(&batch, fd) != 1)
+        {
+            ret = -1;
+            break;
+        }
+    }
+
+Exit:
+    frame_report("frame echo", &frame, &batch, start);
+    cost_print(&cost, "frame echo", frame.frames, frame.bytes);
+    perf_end("frame echo", frame.frames, frame.bytes);
+    ctl_result("frame-echo", frame.frames, frame.bytes, 0, clock_ns(CLOCK_MONOTONIC) - start, NULL);
+    pool_put(&s_pool, buffer);
+
+    return ret;
+}
+
+/**
+    @fn         static int frame_client(int fd, Para_t *pPara)
+    @brief      按长度分布发送-n条消息并校验回应
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       发送和接收同时进行. 消息内容直接引用0-255规律的发送缓冲,
+                接收端用同一随机序列得到每条回应应有的长度, 校验长度和内容.
+*/
+static int frame_client(int fd, Para_t *pPara)
+{
+    int i = 0;
+    int ret = 0;
+    int opt = 1;
+    int flags = 0;
+    int errors = 0;
+    uint32_t length = 0;
+    uint32_t next = 0;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t start = 0;
+    unsigned char *data = NULL;
+    unsigned char *pSend = NULL;
+    unsigned char *pRecv = NULL;
+    struct pollfd pfd;
+    Dist_t tx;
+    Dist_t rx;
+    Frame_t frame;
+    FrameBatch_t batch;
+    Cost_t cost;
+
+    if (dist_parse(&tx, pPara->frame) != 0)
+    {
+        return -1;
+    }
+    rx = tx;
+    dist_print(&tx);
+
+    pSend = pool_get(&s_pool);
+    pRecv = pool_get(&s_pool);
+    if ((pSend == NULL) || (pRecv == NULL))
+    {
+        printf("buffer pool empty!\n");
+        ret = -1;
+        goto Exit;
+    }
+
+    /* 多放一个周期, 任意偏移开始都是连续的0-255 */
+    for (i = 0; i < FRAME_MAX + 256; i++)
+    {
+        pSend[i] = i;
+    }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&opt, sizeof(opt));
+    flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    frame_init(&frame, pRecv, s_pool.size);
+    frame_batch_init(&batch);
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    cost_start(&cost);
+    perf_begin();
+    while (received < pPara->number)
+    {
+        pfd.fd = fd;
+        pfd.events = POLLIN | (((sent < pPara->number) || (batch.count != 0)) ? POLLOUT : 0);
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 1000) <= 0)
+        {
+            printf("poll timeout!%d\n", errno);
+            ret = -1;
+            break;
+        }
+
+        if (pfd.revents & POLLOUT)
+        {
+            /* 批次有空位就继续填充, 批次满时已取出的长度留到下一次 */
+            while ((batch.count < FRAME_IOV) && (sent < pPara->number))
+            {
+                if (next == 0)
+                {
+                    next = dist_next(&tx);
+                }
+                if (frame_add(&batch, pSend + (sent & 0xFF), next) != 0)
+                {
+                    break;
+                }
+                next = 0;
+                sent++;
+            }
+
+            if (frame_flush(&batch, fd) == -1)
+            {
+                printf("writev failed!%d\n", errno);
+                ret = -1;
+                break;
+            }
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            ret = frame_recv(&frame, fd, 0);
+            if (ret == 0)
+            {
+                printf("server closed!\n");
+                ret = -1;
+                break;
+            }
+            if ((ret == -1) && (errno != EAGAIN) && (errno != EINTR))
+            {
+                printf("recv failed!%d\n", errno);
+                break;
+            }
+            ret = 0;
+
+            while ((data = frame_next(&frame, &length)) != NULL)
+            {
+                if ((length != dist_next(&rx)) || (memcmp(data, pSend + (received & 0xFF), length) != 0))
+                {
+                    errors++;
+                }
+                received++;
+            }
+        }
+    }
+
+    printf("frame client: sent=%llu errors=%d\n", (unsigned long long)sent, errors);
+    frame_report("frame client", &frame, &batch, start);
+    cost_print(&cost, "frame client", frame.frames, frame.bytes);
+    perf_end("frame client", frame.frames, frame.bytes);
+    ctl_result("frame", frame.frames, frame.bytes, errors, clock_ns(CLOCK_MONOTONIC) - start, NULL);
+
+Exit:
+    if (pSend != NULL) pool_put(&s_pool, pSend);
+    if (pRecv != NULL) pool_put(&s_pool, pRecv);
+    dist_free(&tx);
+
+    return (errors == 0) ? ret : -1;
+}
+
+/**
+    @fn         static void conn_close(int fd, Para_t *pPara)
+    @brief      关闭连接
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @note       带-T时先停止采样, 打印TCP_INFO摘要并导出样本, 再关闭套接字.
+*/
+static void conn_close(int fd, Para_t *pPara)
+{
+    int conn = sampler_del(&s_sampler, fd);
+
+    if (conn > 0)
+    {
+        sampler_summary(&s_sampler, conn);
+        sampler_dump(&s_sampler, pPara->output);
+    }
+
+    close(fd);
+}
+
+/**
+    @fn         static int tcp_proxy(int fd, Para_t *pPara)
+    @brief      带损伤的tcp代理
+    @author     agent
+    @param[in]  fd          int         已接受的连接
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       每次最多读一个槽的数据, 按字节流方式计算到期时间, 到期后按顺序写到另一端.
+                槽用完或一个方向排队过多时停止读, 由tcp窗口把压力传回发送端, 限速因此能反映到吞吐上.
+                一端关闭后, 该方向的数据发完再关闭另一端的写方向, 两个方向都结束后返回.
+*/
+static int tcp_proxy(int fd, Para_t *pPara)
+{
+    int i = 0;
+    int n = 0;
+    int ret = 0;
+    int opt = 1;
+    int done = 0;
+    int64_t wait = 0;
+    uint64_t now = 0;
+    struct pollfd fds[2];
+    struct timespec timeout;
+    struct sockaddr_in target;
+    Slot_t *pSlot = NULL;
+    Slot_t *pHead[2] = {NULL, NULL};    /* 已到期未写完的槽, 按方向排队 */
+    Slot_t *pTail[2] = {NULL, NULL};
+    uint32_t offset[2] = {0, 0};        /* 队头槽已写出的长度 */
+    uint32_t inflight[2] = {0, 0};
+    int eof[2] = {0, 0};
+    int shut[2] = {0, 0};
+    uint64_t bytes[2] = {0, 0};
+    uint64_t start = clock_ns(CLOCK_MONOTONIC);
+    Impair_t impair;
+
+    memset(&impair, 0x00, sizeof(Impair_t));
+    fds[0].fd = fd;
+    fds[1].fd = -1;
+
+    if ((impair_addr(pPara->target, &target) != 0) || (impair_init(&impair, pPara->impair, 1) != 0))
+    {
+        ret = -1;
+        goto Exit;
+    }
+
+    fds[1].fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fds[1].fd == -1)
+    {
+        printf("socket failed!%d\n", errno);
+        ret = -1;
+        goto Exit;
+    }
+
+    if (connect(fds[1].fd, (struct sockaddr *)&target, sizeof(struct sockaddr_in)) == -1)
+    {
+        printf("connect failed!%d\n", errno);
+        ret = -1;
+        goto Exit;
+    }
+    sampler_add(&s_sampler, fds[1].fd);
+
+    for (i = 0; i < 2; i++)
+    {
+        setsockopt(fds[i].fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        fcntl(fds[i].fd, F_SETFL, fcntl(fds[i].fd, F_GETFL) | O_NONBLOCK);
+    }
+    printf("proxy -> %s\n", pPara->target);
+
+    while (!s_quit && !done)
+    {
+        /* 到期的槽按方向排到写队列 */
+        now = clock_ns(CLOCK_MONOTONIC);
+        while ((pSlot = impair_due(&impair, now)) != NULL)
+        {
+            i = pSlot->tag;
+            pSlot->next = NULL;
+            if (pTail[i] == NULL)
+            {
+                pHead[i] = pSlot;
+            }
+            else
+            {
+                pTail[i]->next = pSlot;
+            }
+            pTail[i] = pSlot;
+        }
+
+        /* 方向i从fds[i]读, 写到fds[1 - i] */
+        for (i = 0; i < 2; i++)
+        {
+            while (pHead[i] != NULL)
+            {
+                n = send(fds[1 - i].fd, pHead[i]->data + offset[i], pHead[i]->length - offset[i], MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (n < 0)
+                {
+                    if (errno == EAGAIN)
+                    {
+                        break;
+                    }
+                    printf("send failed!%d\n", errno);
+                    ret = -1;
+                    goto Exit;
+                }
+
+                offset[i] += n;
+                bytes[i] += n;
+                if (offset[i] < pHead[i]->length)
+                {
+                    break;
+                }
+
+                pSlot = pHead[i];
+                pHead[i] = pSlot->next;
+                if (pHead[i] == NULL)
+                {
+                    pTail[i] = NULL;
+                }
+                offset[i] = 0;
+                inflight[i]--;
+                impair_free(&impair, pSlot);
+            }
+
+            if (eof[i] && (inflight[i] == 0) && !shut[i])
+            {
+                shutdown(fds[1 - i].fd, SHUT_WR);
+                shut[i] = 1;
+            }
+        }
+        done = shut[0] && shut[1];
+
+        for (i = 0; i < 2; i++)
+        {
+            fds[i].events = 0;
+            if (!eof[i] && (inflight[i] < IMPAIR_SLOTS / 2))
+            {
+                fds[i].events |= POLLIN;
+            }
+            if (pHead[1 - i] != NULL)
+            {
+                fds[i].events |= POLLOUT;
+            }
+        }
+
+        wait = impair_wait(&impair, now);
+        timeout.tv_sec = wait / 1000000000;
+        timeout.tv_nsec = wait % 1000000000;
+        if (done || (ppoll(fds, 2, (wait < 0) ? NULL : &timeout, NULL) <= 0))
+        {
+            continue;
+        }
+
+        for (i = 0; i < 2; i++)
+        {
+            while (!(fds[i].revents & POLLNVAL) && (fds[i].events & POLLIN) && (fds[i].revents != 0))
+            {
+                pSlot = impair_alloc(&impair);
+                if (pSlot == NULL)
+                {
+                    break;
+                }
+
+                n = recv(fds[i].fd, pSlot->data, IMPAIR_SIZE, MSG_DONTWAIT);
+                if (n <= 0)
+                {
+                    impair_free(&impair, pSlot);
+                    if (n == 0)
+                    {
+                        eof[i] = 1;
+                    }
+                    else if ((errno != EAGAIN) && (errno != EINTR))
+                    {
+                        printf("recv failed!%d\n", errno);
+                        ret = -1;
+                        goto Exit;
+                    }
+                    break;
+                }
+
+                pSlot->length = n;
+                pSlot->tag = i;
+                inflight[i]++;
+                impair_submit(&impair, pSlot, clock_ns(CLOCK_MONOTONIC));
+                if (inflight[i] >= IMPAIR_SLOTS / 2)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+Exit:
+    printf("proxy: forward %llu bytes reverse %llu bytes\n", (unsigned long long)bytes[0], (unsigned long long)bytes[1]);
+    ctl_result("proxy", 0, bytes[0] + bytes[1], ret != 0, clock_ns(CLOCK_MONOTONIC) - start, NULL);
+    if (impair.head != NULL)
+    {
+        impair_print(&impair);
+    }
+    impair_destroy(&impair);
+    if (fds[1].fd != -1)
+    {
+        conn_close(fds[1].fd, pPara);
+    }
+
+    return ret;
+}
+
+/**
+    @fn         static int soak_timeout(int fd)
+    @brief      设置浸泡测试的接收超时
+    @author     agent
+    @param[in]  fd          int         套接字
+    @retval     0 成功
+    @retval     -1 失败
+    @note       接收和accept最多阻塞1秒, 没有数据时也能关闭统计桶并发现停顿.
+*/
+static int soak_timeout(int fd)
+{
+    struct timeval timeout;
+
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+    {
+        printf("setsockopt failed(SO_RCVTIMEO)!%d\n", errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int soak_client(int fd, Para_t *pPara)
+    @brief      浸泡测试的发送端
+    @author     agent
+    @param[in]  fd          int         已连接的套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       一问一答发送256字节直到ctrl+c, 每个回应统计往返延时并校验内容,
+                第一个字节是序号, 收到上一轮的残留数据也能发现.
+*/
+static int soak_client(int fd, Para_t *pPara)
+{
+    unsigned char buffer[256];
+    unsigned char reply[256];
+    uint64_t round = 0;
+    uint64_t start = 0;
+    uint64_t begin = clock_ns(CLOCK_MONOTONIC);
+    uint64_t messages = 0;
+    uint64_t errors = 0;
+    int result = 0;
+    int got = 0;
+    int ret = 0;
+    int opt = 1;
+    int i = 0;
+
+    for (i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = i;
+    }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&opt, sizeof(opt));
+    if (soak_timeout(fd) != 0)
+    {
+        return -1;
+    }
+
+    printf("press ctrl+c to quit.\n");
+    while (!s_quit)
+    {
+        buffer[0] = round++;
+        start = clock_ns(CLOCK_MONOTONIC);
+        if (send_all(fd, buffer, sizeof(buffer)) != sizeof(buffer))
+        {
+            printf("send failed!%d\n", errno);
+            result = -1;
+            break;
+        }
+
+        for (got = 0; got < sizeof(reply); )
+        {
+            ret = recv(fd, reply + got, sizeof(reply) - got, 0);
+            if (ret > 0)
+            {
+                got += ret;
+            }
+            else if ((ret < 0) && (errno == EAGAIN) && !s_quit)
+            {
+                soak_add(&s_soak, 0, 0, 0, -1);
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (got != sizeof(reply))
+        {
+            if (s_quit)
+            {
+                break;
+            }
+
+            printf("recv failed!%d\n", ret ? errno : 0);
+            result = -1;
+            break;
+        }
+
+        i = (memcmp(buffer, reply, sizeof(reply)) != 0);
+        messages++;
+        errors += i;
+        soak_add(&s_soak, 1, sizeof(reply), i, clock_ns(CLOCK_MONOTONIC) - start);
+    }
+
+    ctl_result("soak", messages, messages * sizeof(reply), errors, clock_ns(CLOCK_MONOTONIC) - begin, NULL);
+
+    return result;
+}
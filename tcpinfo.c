@@ -0,0 +1,372 @@
+/**
+    @file       tcpinfo.c
+    @brief      TCP_INFO定时采样
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       采样线程按固定间隔读取每个活动连接的TCP_INFO, 写入预分配的环形缓冲,
+                连接结束后打印摘要并导出CSV或JSON.
+                glibc的tcp_info没有delivery_rate等字段, 这里使用内核头文件的定义.
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "stddef.h"
+#include "time.h"
+#include "sys/socket.h"
+#include "netinet/in.h"
+#include "linux/tcp.h"
+
+#include "tcpinfo.h"
+#include "hist.h"
+
+/* 旧内核返回的tcp_info较短, 没有的字段为0 */
+#define TCPI_HAS(len, field)    ((len) >= offsetof(struct tcp_info, field) + sizeof(((struct tcp_info *)0)->field))
+
+/**
+    @fn         static void sampler_take(Sampler_t *pSampler, int slot, uint64_t now)
+    @brief      对一个连接采样一次
+    @author     agent
+    @param[in]  pSampler    Sampler_t*  采样器
+    @param[in]  slot        int         连接位置
+    @param[in]  now         uint64_t    采样时间, CLOCK_MONOTONIC
+    @note       调用者持有锁.
+*/
+static void sampler_take(Sampler_t *pSampler, int slot, uint64_t now)
+{
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+    TcpSample_t *pSample = NULL;
+
+    memset(&info, 0x00, sizeof(info));
+    if (getsockopt(pSampler->fd[slot], IPPROTO_TCP, TCP_INFO, &info, &length) != 0)
+    {
+        return;
+    }
+
+    pSample = &pSampler->ring[pSampler->head % SAMPLE_RING];
+    memset(pSample, 0x00, sizeof(TcpSample_t));
+    pSample->time = now - pSampler->start;
+    pSample->conn = pSampler->conn[slot];
+    pSample->rtt = info.tcpi_rtt;
+    pSample->rttvar = info.tcpi_rttvar;
+    pSample->cwnd = info.tcpi_snd_cwnd;
+    pSample->retrans = info.tcpi_total_retrans;
+    pSample->unacked = info.tcpi_unacked;
+    if (TCPI_HAS(length, tcpi_bytes_acked)) pSample->acked = info.tcpi_bytes_acked;
+    if (TCPI_HAS(length, tcpi_delivery_rate)) pSample->delivery = info.tcpi_delivery_rate;
+    if (TCPI_HAS(length, tcpi_busy_time)) pSample->busy = info.tcpi_busy_time;
+    if (TCPI_HAS(length, tcpi_rwnd_limited)) pSample->rwnd = info.tcpi_rwnd_limited;
+    if (TCPI_HAS(length, tcpi_sndbuf_limited)) pSample->sndbuf = info.tcpi_sndbuf_limited;
+    pSampler->head++;
+}
+
+/**
+    @fn         static void *sampler_thread(void *arg)
+    @brief      采样线程
+    @author     agent
+    @param[in]  arg         Sampler_t*  采样器
+    @note       按绝对时间休眠, 间隔不随采样耗时漂移.
+*/
+static void *sampler_thread(void *arg)
+{
+    int i = 0;
+    uint64_t next = 0;
+    struct timespec ts;
+    Sampler_t *pSampler = (Sampler_t *)arg;
+
+    next = pSampler->start;
+    while (pSampler->running)
+    {
+        next += pSampler->interval;
+        ts.tv_sec = next / 1000000000ULL;
+        ts.tv_nsec = next % 1000000000ULL;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        pthread_mutex_lock(&pSampler->mutex);
+        for (i = 0; i < SAMPLE_CONNS; i++)
+        {
+            if (pSampler->fd[i] != -1)
+            {
+                sampler_take(pSampler, i, next);
+            }
+        }
+        pthread_mutex_unlock(&pSampler->mutex);
+    }
+
+    return NULL;
+}
+
+/**
+    @fn         int sampler_start(Sampler_t *pSampler, int interval)
+    @brief      分配环形缓冲并启动采样线程
+    @author     agent
+    @param[in]  pSampler    Sampler_t*  采样器
+    @param[in]  interval    int         采样间隔, 单位us
+    @retval     0 成功
+    @retval     -1 失败
+*/
+int sampler_start(Sampler_t *pSampler, int interval)
+{
+    int i = 0;
+
+    memset(pSampler, 0x00, sizeof(Sampler_t));
+    for (i = 0; i < SAMPLE_CONNS; i++)
+    {
+        pSampler->fd[i] = -1;
+    }
+
+    pSampler->ring = calloc(SAMPLE_RING, sizeof(TcpSample_t));
+    if (pSampler->ring == NULL)
+    {
+        printf("calloc failed!%d\n", errno);
+        return -1;
+    }
+
+    pthread_mutex_init(&pSampler->mutex, NULL);
+    pSampler->interval = (uint64_t)(interval > 0 ? interval : 1) * 1000;
+    pSampler->start = clock_ns(CLOCK_MONOTONIC);
+    pSampler->next = 1;
+    pSampler->running = 1;
+    if (pthread_create(&pSampler->thread, NULL, sampler_thread, pSampler) != 0)
+    {
+        printf("pthread_create failed!%d\n", errno);
+        pSampler->running = 0;
+        free(pSampler->ring);
+        pSampler->ring = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         int sampler_add(Sampler_t *pSampler, int fd)
+    @brief      开始采样一个连接
+    @author     agent
+    @param[in]  pSampler    Sampler_t*  采样器
+    @param[in]  fd          int         已连接的套接字
+    @retval     >0 连接编号
+    @retval     -1 未启动或连接数已满
+*/
+int sampler_add(Sampler_t *pSampler, int fd)
+{
+    int i = 0;
+    int conn = -1;
+
+    if (pSampler->ring == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&pSampler->mutex);
+    for (i = 0; i < SAMPLE_CONNS; i++)
+    {
+        if (pSampler->fd[i] == -1)
+        {
+            pSampler->fd[i] = fd;
+            pSampler->conn[i] = pSampler->next++;
+            conn = pSampler->conn[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pSampler->mutex);
+
+    return conn;
+}
+
+/**
+    @fn         int sampler_del(Sampler_t *pSampler, int fd)
+    @brief      停止采样一个连接
+    @author     agent
+    @param[in]  pSampler    Sampler_t*  采样器
+    @param[in]  fd          int         套接字
+    @retval     >0 连接编号
+    @retval     -1 没有采样该连接
+    @note       必须在close之前调用, 返回后采样线程不会再访问该套接字.
+                删除前再采一次, 保留连接结束时的累计值.
+*/
+int sampler_del(Sampler_t *pSampler, int fd)
+{
+    int i = 0;
+    int conn = -1;
+
+    if (pSampler->ring == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&pSampler->mutex);
+    for (i = 0; i < SAMPLE_CONNS; i++)
+    {
+        if (pSampler->fd[i] == fd)
+        {
+            sampler_take(pSampler, i, clock_ns(CLOCK_MONOTONIC));
+            pSampler->fd[i] = -1;
+            conn = pSampler->conn[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pSampler->mutex);
+
+    return conn;
+}
+
+/**
+    @fn         void sampler_summary(Sampler_t *pSampler, int conn)
+    @brief      打印一个连接的采样摘要
+    @author     agent
+    @param[in]  pSampler    Sampler_t*  采样器
+    @param[in]  conn        int         连接编号
+    @note       受限时间占busy时间的比例可以看出瓶颈在接收窗口还是发送缓冲.
+*/
+void sampler_summary(Sampler_t *pSampler, int conn)
+{
+    uint64_t i = 0;
+    uint64_t first = 0;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint32_t cwnd = 0;
+    uint64_t delivery = 0;
+    TcpSample_t *pSample = NULL;
+    TcpSample_t *pLast = NULL;
+
+    if ((pSampler->ring == NULL) || (conn <= 0))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pSampler->mutex);
+    first = (pSampler->head > SAMPLE_RING) ? pSampler->head - SAMPLE_RING : 0;
+    for (i = first; i < pSampler->head; i++)
+    {
+        pSample = &pSampler->ring[i % SAMPLE_RING];
+        if (pSample->conn != conn)
+        {
+            continue;
+        }
+
+        count++;
+        sum += pSample->rtt;
+        if (pSample->rtt < min) min = pSample->rtt;
+        if (pSample->rtt > max) max = pSample->rtt;
+        if (pSample->cwnd > cwnd) cwnd = pSample->cwnd;
+        if (pSample->delivery > delivery) delivery = pSample->delivery;
+        pLast = pSample;
+    }
+
+    if (count != 0)
+    {
+        printf("tcp_info conn=%d samples=%llu rtt min=%uus avg=%lluus max=%uus cwnd max=%u retrans=%u "
+               "delivery max=%.3fGbps busy=%.3fms rwnd_limited=%.1f%% sndbuf_limited=%.1f%%\n",
+               conn, (unsigned long long)count, min, (unsigned long long)(sum / count), max, cwnd,
+               pLast->retrans, delivery * 8 / 1e9, pLast->busy / 1000.0,
+               pLast->busy ? pLast->rwnd * 100.0 / pLast->busy : 0,
+               pLast->busy ? pLast->sndbuf * 100.0 / pLast->busy : 0);
+    }
+    pthread_mutex_unlock(&pSampler->mutex);
+}
+
+/**
+    @fn         int sampler_dump(Sampler_t *pSampler, const char *path)
+    @brief      导出环形缓冲中的样本
+    @author     agent
+    @param[in]  pSampler    Sampler_t*  采样器
+    @param[in]  path        char*       文件名, .json结尾时导出JSON, 否则导出CSV
+    @retval     0 成功
+    @retval     -1 失败
+    @note       按时间顺序导出环形缓冲中保留的所有样本, 每次覆盖原文件.
+*/
+int sampler_dump(Sampler_t *pSampler, const char *path)
+{
+    uint64_t i = 0;
+    uint64_t first = 0;
+    int json = 0;
+    size_t length = strlen(path);
+    FILE *file = NULL;
+    TcpSample_t *pSample = NULL;
+
+    if (pSampler->ring == NULL)
+    {
+        return -1;
+    }
+
+    file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("open %s failed!%d\n", path, errno);
+        return -1;
+    }
+
+    json = (length > 5) && (strcmp(path + length - 5, ".json") == 0);
+    if (json)
+    {
+        fprintf(file, "[\n");
+    }
+    else
+    {
+        fprintf(file, "time_us,conn,rtt_us,rttvar_us,cwnd,retrans,unacked,delivery_bps,"
+                      "busy_us,rwnd_limited_us,sndbuf_limited_us,bytes_acked\n");
+    }
+
+    pthread_mutex_lock(&pSampler->mutex);
+    first = (pSampler->head > SAMPLE_RING) ? pSampler->head - SAMPLE_RING : 0;
+    for (i = first; i < pSampler->head; i++)
+    {
+        pSample = &pSampler->ring[i % SAMPLE_RING];
+        if (json)
+        {
+            fprintf(file, "{\"time_us\":%llu,\"conn\":%u,\"rtt_us\":%u,\"rttvar_us\":%u,\"cwnd\":%u,"
+                          "\"retrans\":%u,\"unacked\":%u,\"delivery_bps\":%llu,\"busy_us\":%llu,"
+                          "\"rwnd_limited_us\":%llu,\"sndbuf_limited_us\":%llu,\"bytes_acked\":%llu}%s\n",
+                    (unsigned long long)(pSample->time / 1000), pSample->conn, pSample->rtt, pSample->rttvar,
+                    pSample->cwnd, pSample->retrans, pSample->unacked, (unsigned long long)pSample->delivery * 8,
+                    (unsigned long long)pSample->busy, (unsigned long long)pSample->rwnd,
+                    (unsigned long long)pSample->sndbuf, (unsigned long long)pSample->acked,
+                    (i + 1 < pSampler->head) ? "," : "");
+        }
+        else
+        {
+            fprintf(file, "%llu,%u,%u,%u,%u,%u,%u,%llu,%llu,%llu,%llu,%llu\n",
+                    (unsigned long long)(pSample->time / 1000), pSample->conn, pSample->rtt, pSample->rttvar,
+                    pSample->cwnd, pSample->retrans, pSample->unacked, (unsigned long long)pSample->delivery * 8,
+                    (unsigned long long)pSample->busy, (unsigned long long)pSample->rwnd,
+                    (unsigned long long)pSample->sndbuf, (unsigned long long)pSample->acked);
+        }
+    }
+    printf("tcp_info: %llu samples to %s\n", (unsigned long long)(pSampler->head - first), path);
+    pthread_mutex_unlock(&pSampler->mutex);
+
+    if (json)
+    {
+        fprintf(file, "]\n");
+    }
+    fclose(file);
+
+    return 0;
+}
+
+/**
+    @fn         void sampler_stop(Sampler_t *pSampler)
+    @brief      停止采样线程并释放环形缓冲
+    @author     agent
+    @param[in]  pSampler    Sampler_t*  采样器
+*/
+void sampler_stop(Sampler_t *pSampler)
+{
+    if (pSampler->ring == NULL)
+    {
+        return;
+    }
+
+    pSampler->running = 0;
+    pthread_join(pSampler->thread, NULL);
+    pthread_mutex_destroy(&pSampler->mutex);
+    free(pSampler->ring);
+    pSampler->ring = NULL;
+}
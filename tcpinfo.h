@@ -0,0 +1,61 @@
+/**
+    @file       tcpinfo.h
+    @brief      TCP_INFO定时采样
+    @copyright  senbo
+    @author     agent
+    @version    V1.0
+    @date       2026.10.18 V1.0 创建
+    @note       采样线程按固定间隔读取每个活动连接的TCP_INFO, 写入预分配的环形缓冲,
+                连接结束后打印摘要并导出CSV或JSON.
+*/
+
+#ifndef __TCPINFO_H__
+#define __TCPINFO_H__
+
+#include "stdint.h"
+#include "pthread.h"
+
+#define SAMPLE_CONNS    16          /* 同时采样的最多连接数 */
+#define SAMPLE_RING     65536       /* 环形缓冲样本数, 满后覆盖最旧的样本 */
+
+/**
+一个采样点, 时间相对采样开始, 累计量直接保存内核的值.
+*/
+typedef struct TcpSample_s
+{
+    uint64_t time;              /* 单位ns */
+    uint32_t conn;              /* 连接编号, 从1开始 */
+    uint32_t rtt;               /* 单位us */
+    uint32_t rttvar;
+    uint32_t cwnd;              /* 单位mss */
+    uint32_t retrans;           /* 累计重传段数 */
+    uint32_t unacked;
+    uint64_t delivery;          /* 交付速率, 单位Bps */
+    uint64_t busy;              /* 以下累计时间单位us */
+    uint64_t rwnd;
+    uint64_t sndbuf;
+    uint64_t acked;             /* 累计确认字节数 */
+} TcpSample_t;
+
+typedef struct Sampler_s
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    volatile int running;
+    int fd[SAMPLE_CONNS];
+    uint32_t conn[SAMPLE_CONNS];
+    uint32_t next;              /* 下一个连接编号 */
+    uint64_t interval;          /* 单位ns */
+    uint64_t start;
+    uint64_t head;              /* 已写入的样本总数 */
+    TcpSample_t *ring;
+} Sampler_t;
+
+int sampler_start(Sampler_t *pSampler, int interval);
+int sampler_add(Sampler_t *pSampler, int fd);
+int sampler_del(Sampler_t *pSampler, int fd);
+void sampler_summary(Sampler_t *pSampler, int conn);
+int sampler_dump(Sampler_t *pSampler, const char *path);
+void sampler_stop(Sampler_t *pSampler);
+
+#endif
@@ -8,6 +8,8 @@
     @note       程序用来测试串口发送与接收
 */
 
+#define _GNU_SOURCE
+
 #include "stdio.h"
 #include "stdlib.h"
 #include "unistd.h"
@@ -15,9 +17,39 @@
 #include "string.h"
 #include "errno.h"
 #include "termios.h"
+#include "signal.h"
+#include "stdint.h"
+#include "getopt.h"
+#include "poll.h"
 
 #include "sys/mman.h"
 #include "sys/ioctl.h"
+#include "linux/serial.h"
+
+#include "sys/socket.h"
+#include "netinet/in.h"
+#include "netinet/tcp.h"
+#include "arpa/inet.h"
+
+#include "hist.h"
+#include "capture.h"
+#include "bufpool.h"
+#include "perfcnt.h"
+#include "stuff.h"
+#include "soak.h"
+
+#define TTYS_BUFFER     4096        /* 缓冲池中每个缓冲长度 */
+#define POOL_COUNT      32          /* 网关模式每个串口占两个缓冲 */
+
+#define RS_SYNC         0xA5        /* 轮询帧同步字节 */
+#define RS_TIMEOUT_MS   100         /* 等待应答超时, 另加收发延时 */
+#define RS_STEPS        64          /* 最多扫描的延时组合数 */
+
+#define STUFF_HEAD      12          /* 帧开头的发送时间和序号 */
+#define STUFF_END       0xFFFFFFFF  /* 结束帧序号 */
+
+#define GW_PORTS        8           /* 网关最多串口数 */
+#define GW_CLIENTS      4           /* 每个tcp端口最多客户端数 */
 
 /**
 参数结构体, 程序需要用的参数组成一个结构体,
@@ -32,8 +64,58 @@ typedef struct Para_s
     int check;
     char name[64];
     char path[128];
+    int size;
+    double speed;
+    char capture[128];
+    char replay[128];
+    int huge;
+    int perf;
+    int rs485;
+    int before[2];              /* RTS发送前延时扫描范围, 单位ms */
+    int after[2];               /* RTS发送后延时扫描范围, 单位ms */
+    int poll;
+    int stuff;                  /* -1不分帧, 否则STUFF_SLIP或STUFF_HDLC */
+    int crc;
+    int frames;
+    char gateway[GW_PORTS][64];
+    int gateways;
+    int gap;                    /* 网关字节间隔超时, 单位us, 0按3.5个字符计算 */
+    int soak;                   /* 浸泡测试 */
+    char snapshot[128];         /* 浸泡统计快照文件 */
+    int threshold;              /* 劣化阈值, 百分比 */
 } Para_t;
 
+/**
+RS-485轮询帧, 主站发送POLL, 从站原样带回序号应答RESP.
+*/
+typedef struct RsFrame_s
+{
+    uint8_t sync;
+    uint8_t type;
+    uint16_t seq;
+    uint32_t reserved;
+} RsFrame_t;
+
+enum
+{
+    RS_POLL = 1,
+    RS_RESP,
+};
+
+/**
+一组延时的扫描结果.
+*/
+typedef struct RsResult_s
+{
+    int before;
+    int after;
+    int ok;
+    int timeouts;
+    int errors;
+    double rate;                /* 每秒轮询次数 */
+    uint64_t p99;               /* 应答转向时间, 单位ns */
+} RsResult_t;
+
 static char *s_string[] =
 {
     "Read",
@@ -47,8 +129,71 @@ static char *s_string2[] =
     "even",
 };
 
+/**
+网关的一个串口. 串口收到的数据先攒在rx中, 字节间隔超时或攒满-n字节后发往网络;
+网络收到的数据放入tx, 串口可写时写出.
+*/
+typedef struct Gateway_s
+{
+    char path[128];
+    int udp;
+    int port;
+    int tty;
+    int sock;                   /* tcp监听或udp套接字 */
+    int client[GW_CLIENTS];
+    struct sockaddr_in peer;
+    int known;                  /* udp对端已知 */
+    unsigned char *rx;
+    int rxLength;
+    uint64_t first;             /* rx中第一个字节读到的时间 */
+    uint64_t last;              /* rx中最后一个字节读到的时间 */
+    unsigned char *tx;
+    int txHead;
+    int txTail;
+    uint64_t pending;           /* tx中最早的数据收到的时间 */
+    uint64_t up;                /* 串口到网络字节数 */
+    uint64_t down;              /* 网络到串口字节数 */
+    uint64_t flushes;
+    uint64_t fulls;             /* 攒满-n字节发送的次数, 其余为超时发送 */
+    uint64_t drops;             /* 网络或串口来不及发送丢弃的字节数 */
+    char upName[160];
+    char downName[160];
+    Hist_t upHist;
+    Hist_t downHist;
+} Gateway_t;
+
+static char *s_stuff[] =
+{
+    "slip",
+    "hdlc",
+};
+
+static volatile sig_atomic_t s_quit = 0;
+static Pool_t s_pool;
+static Soak_t s_soak;
+
+static struct option s_option[] =
+{
+    {"perf", no_argument, NULL, 'P'},
+    {"soak", optional_argument, NULL, 'W'},
+    {NULL, 0, NULL, 0},
+};
+
 static int send_data(Para_t *pPara);
 static int receive_data(Para_t *pPara);
+static void install_quit(void);
+static int cap_send(int fd, Para_t *pPara);
+static int cap_receive(int fd, Para_t *pPara);
+static speed_t baud_flag(int baud);
+static int rs_range(const char *spec, Para_t *pPara);
+static int tty_open(Para_t *pPara, int vtime, int vmin);
+static int rs485_set(int fd, int before, int after);
+static int rs_master(int fd, Para_t *pPara);
+static int rs_slave(int fd, Para_t *pPara);
+static int st_send(int fd, Para_t *pPara);
+static int st_receive(int fd, Para_t *pPara);
+static int gw_run(Para_t *pPara);
+static uint64_t tty_errors(int fd);
 
 /**
     @fn         static int print_usage(void)
@@ -61,14 +206,44 @@ static int receive_data(Para_t *pPara);
 static int print_usage(void)
 {
     printf("Usage: ttys -[rw] <device> -[b] <baud> -[n] <number> -c <check>\n"
+           "            -C <file> -S <MB> -R <file> -x <speed> -H --perf -4 -D <delays> -M\n"
+           "            -f <slip|hdlc> -k <16|32> -N <frames> -G <gateway> -t <usec>\n"
+           "            --soak[=<file>] -Q <percent>\n"
            "\t-r: recive data\n"
            "\t-w: send data\n"
            "\t-b: baud rate\n"
            "\t-n: send number\n"
            "\t-c: check type 0:none 1:odd 2:even\n"
+           "\t-C: capture received data to file\n"
+           "\t-S: capture file size MB, default 64\n"
+           "\t-R: replay captured file\n"
+           "\t-x: replay speed, 1 real time, 0 as fast as possible\n"
+           "\t-H: hugepage backed and mlocked buffer pool\n"
+           "\t--perf: cycles/instructions/cache-misses/cs/faults per message and byte\n"
+           "\t-4: RS-485 mode, TIOCSRS485 with RTS on send\n"
+           "\t-D: RTS delay before,after send in ms, ranges sweep in poll mode, e.g. 0-5,0-2, implies -4\n"
+           "\t-M: poll-response loop, -w is master sending -n polls per delay setting, -r is slave\n"
+           "\t-f: SLIP or HDLC byte stuffed frames of -n bytes with crc, frames/s, overhead and latency\n"
+           "\t-k: frame crc bits 16 or 32, default 16\n"
+           "\t-N: frames to send, default 1000\n"
+           "\t-G: gateway ttyS0,tcp:<port> or ttyS0,udp:<port>[,<ip>:<port>], repeat for more ports\n"
+           "\t-t: gateway inter-character timeout usec, default 3.5 characters, flush at -n bytes\n"
+           "\t--soak: send -n bytes or receive until ctrl+c with per second/minute/hour statistics\n"
+           "\t    in fixed memory, no hex dump, errors are uart frame/parity/overrun counts,\n"
+           "\t    history is saved to and resumed from file\n"
+           "\t-Q: soak degradation threshold against the last hour, percent, default 30\n"
            "\tdevice: ttyS device path\n"
            "Example: ttys -w ttyS0 -b 115200 -n 256\n"
            "Example: ttys -r ttyS0 -b 115200\n"
+           "Example: ttys -r ttyS0 -b 115200 -C field.cap\n"
+           "Example: ttys -w ttyS1 -b 115200 -R field.cap -x 1\n"
+           "Example: ttys -r ttyS2 -b 921600 -M -4\n"
+           "Example: ttys -w ttyS1 -b 921600 -M -D 0-3,0-3 -n 500\n"
+           "Example: ttys -r ttyS2 -b 3000000 -f hdlc -k 32\n"
+           "Example: ttys -w ttyS1 -b 3000000 -f hdlc -k 32 -n 256 -N 100000\n"
+           "Example: ttys -G ttyS1,tcp:4001 -G ttyS2,udp:4002,192.168.1.5:4002 -b 115200 -t 500\n"
+           "Example: ttys -r ttyS2 -b 921600 --soak=ttyS2.soak\n"
+           "Example: ttys -w ttyS1 -b 921600 -n 1024 --soak\n"
           );
 
     return 0;
@@ -90,7 +265,7 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
     int ret = 0;
     int valid = 0;
 
-    while ((ret = getopt(argc, argv, "r:w:b:n:c:")) != -1)
+    while ((ret = getopt_long(argc, argv, "r:w:b:n:c:C:S:R:x:HP4D:Mf:k:N:G:t:Q:", s_option, NULL)) != -1)
     {
         switch (ret)
         {
@@ -118,6 +293,63 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
             pPara->check &= 0x03;
             if (pPara->check > 2) pPara->check = 0;
             break;
+        case 'C':
+            strncpy(pPara->capture, optarg, sizeof(pPara->capture) - 1);
+            break;
+        case 'S':
+            pPara->size = strtoul(optarg, NULL, 10);
+            break;
+        case 'R':
+            strncpy(pPara->replay, optarg, sizeof(pPara->replay) - 1);
+            break;
+        case 'x':
+            pPara->speed = strtod(optarg, NULL);
+            break;
+        case 'H':
+            pPara->huge = 1;
+            break;
+        case 'P':
+            pPara->perf = 1;
+            break;
+        case '4':
+            pPara->rs485 = 1;
+            break;
+        case 'D':
+            pPara->rs485 = 1;
+            if (rs_range(optarg, pPara) != 0)
+            {
+                print_usage();
+                return -1;
+            }
+            break;
+        case 'M':
+            pPara->poll = 1;
+            break;
+        case 'f':
+            pPara->stuff = (strcmp(optarg, "hdlc") == 0) ? STUFF_HDLC : STUFF_SLIP;
+            break;
+        case 'k':
+            pPara->crc = (strtoul(optarg, NULL, 10) == 32) ? 32 : 16;
+            break;
+        case 'N':
+            pPara->frames = strtoul(optarg, NULL, 10);
+            break;
+        case 'G':
+            if (pPara->gateways < GW_PORTS)
+            {
+                strncpy(pPara->gateway[pPara->gateways++], optarg, sizeof(pPara->gateway[0]) - 1);
+            }
+            break;
+        case 't':
+            pPara->gap = strtoul(optarg, NULL, 10);
+            break;
+        case 'W':
+            pPara->soak = 1;
+            if (optarg != NULL) strncpy(pPara->snapshot, optarg, sizeof(pPara->snapshot) - 1);
+            break;
+        case 'Q':
+            pPara->threshold = strtoul(optarg, NULL, 10);
+            break;
         default:
             print_usage();
             return -1;
@@ -131,8 +363,8 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
         return -1;
     }
 
-    /* 参数不符合逻辑 */
-    if ((valid != 1))
+    /* 参数不符合逻辑, 网关模式不需要-r/-w */
+    if ((valid + (pPara->gateways ? 1 : 0)) != 1)
     {
         print_usage();
         return -1;
@@ -160,24 +392,12 @@ int main(int argc, char *argv[])
     memset(&para, 0x00, sizeof(Para_t));
     para.baud = 115200;
     para.number = 256;
-    switch (para.baud)
-    {
-    case 9600:
-        para.baud2 = B9600;
-        break;
-    case 19200:
-        para.baud2 = B19200;
-        break;
-    case 38400:
-        para.baud2 = B38400;
-        break;
-    case 57600:
-        para.baud2 = B57600;
-        break;
-    case 115200:
-    default:
-        para.baud2 = B115200;
-    }
+    para.size = CAPTURE_SIZE;
+    para.speed = 1;
+    para.stuff = -1;
+    para.crc = 16;
+    para.frames = 1000;
+    para.threshold = SOAK_THRESHOLD;
 
     /* 解析参数 */
     ret = parse_usage(argc, argv, &para);
@@ -187,11 +407,42 @@ int main(int argc, char *argv[])
         goto Exit;
     }
 
+    /* 波特率必须在解析参数之后转换, 否则-b不起作用 */
+    para.baud2 = baud_flag(para.baud);
+
     /* 打印解析的参数 */
-    printf("%s %s baud=%d number=%d 8bit %s\n", s_string[para.mode], para.path,
+    printf("%s %s baud=%d number=%d 8bit %s\n", para.gateways ? "Gateway" : s_string[para.mode], para.path,
            para.baud, para.number, s_string2[para.check]);
 
-    if (para.mode)
+    /* 收发缓冲在启动时一次分配 */
+    ret = pool_init(&s_pool, TTYS_BUFFER, POOL_COUNT, para.huge ? (POOL_HUGE | POOL_LOCK) : 0);
+    if (ret != 0)
+    {
+        ret = -1;
+        goto Exit;
+    }
+
+    if (para.perf)
+    {
+        perf_init();
+    }
+
+    /* 浸泡测试, ctrl+c后保存快照 */
+    if (para.soak)
+    {
+        if (soak_init(&s_soak, para.snapshot, para.threshold) != 0)
+        {
+            ret = -1;
+            goto Exit;
+        }
+        install_quit();
+    }
+
+    if (para.gateways)
+    {
+        ret = gw_run(&para);
+    }
+    else if (para.mode)
     {
         ret = send_data(&para);
     }
@@ -200,6 +451,15 @@ int main(int argc, char *argv[])
         ret = receive_data(&para);
     }
 
+    if (para.soak)
+    {
+        soak_close(&s_soak);
+    }
+
+    pool_print(&s_pool);
+    pool_destroy(&s_pool);
+    perf_exit();
+
 Exit:
     return ret;
 }
@@ -220,8 +480,9 @@ static int send_data(Para_t *pPara)
     int ret = 0;
     int sent = 0;
     unsigned char buffer[1024] = {0};
-    struct termios option;
     int ctrlbits = 0;
+    uint64_t errors = 0;
+    uint64_t count = 0;
 
     /* 测试发送数据0x00 - 0xFF */
     for (i = 0; i < sizeof(buffer); i++)
@@ -230,44 +491,71 @@ static int send_data(Para_t *pPara)
     }
 
     /* 打开发送串口 */
-    fd = open(pPara->path, O_RDWR, 0);
+    fd = tty_open(pPara, 0, 1);
     if (fd == -1)
     {
-        printf("open %s failed!%d\n", pPara->path, errno);
         return -21;
     }
 
-    /* 获取以前参数 */
-    ret = tcgetattr(fd, &option);
+    if (pPara->rs485)
+    {
+        /* RS-485由驱动在发送时控制RTS */
+        rs485_set(fd, pPara->before[0], pPara->after[0]);
+    }
+    else
+    {
+        /* 422模式必须设置RTS才能发送 */
+        ctrlbits = TIOCM_RTS;
+        ret = ioctl(fd, TIOCMBIC, &ctrlbits);
+    }
 
-    /* 设置波特率 */
-    ret = cfsetispeed(&option, pPara->baud2);
-    ret = cfsetospeed(&option, pPara->baud2);
+    /* 轮询应答模式 */
+    if (pPara->poll)
+    {
+        ret = rs_master(fd, pPara);
+        goto Exit;
+    }
 
-    /* 数据位8位 停止位1位 奇校验 */
-    option.c_cflag |= (CLOCAL | CREAD);
-    option.c_cflag |= PARENB;
-    option.c_cflag |= PARODD;
-    option.c_cflag &= ~CSTOPB;
-    option.c_cflag &= ~CSIZE;
-    option.c_cflag |= CS8;
-    option.c_cflag &= ~CRTSCTS; /* 取消硬件流控制 */
+    /* 分帧模式 */
+    if (pPara->stuff >= 0)
+    {
+        ret = st_send(fd, pPara);
+        goto Exit;
+    }
 
-    /* 原始模式 */
-    option.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-    option.c_iflag &= ~(IXON | IXOFF | IXANY | INLCR | ICRNL | IGNCR);
-    option.c_oflag &= ~(OPOST | ONLCR | OCRNL);
-    option.c_cc[VTIME] = 0;
-    option.c_cc[VMIN] = 1;
+    /* 回放模式 */
+    if (pPara->replay[0] != 0)
+    {
+        ret = cap_send(fd, pPara);
+        goto Exit;
+    }
 
-    /* 设置模式并清空缓冲区 */
-    ret = tcsetattr(fd, TCSAFLUSH, &option);
+    /* 浸泡测试, 连续发送直到ctrl+c */
+    if (pPara->soak)
+    {
+        printf("press ctrl+c to quit.\n");
+        errors = tty_errors(fd);
+        while (!s_quit)
+        {
+            sent = write(fd, buffer, pPara->number);
+            if ((sent < 0) && (errno != EINTR))
+            {
+                printf("write failed!%d\n", errno);
+                ret = -22;
+                goto Exit;
+            }
+            tcdrain(fd);
 
-    /* 422模式必须设置RTS才能发送 */
-    ctrlbits = TIOCM_RTS;
-    ret = ioctl(fd, TIOCMBIC, &ctrlbits);
+            count = tty_errors(fd);
+            soak_add(&s_soak, (sent > 0) ? 1 : 0, (sent > 0) ? sent : 0, count - errors, -1);
+            errors = count;
+        }
+        ret = 0;
+        goto Exit;
+    }
 
     /* 发送串口发送数据 */
+    perf_begin();
     sent = write(fd, buffer, pPara->number);
     if (sent != pPara->number)
     {
@@ -275,6 +563,8 @@ static int send_data(Para_t *pPara)
         ret = -22;
         goto Exit;
     }
+    tcdrain(fd);
+    perf_end("ttys send", 1, sent);
 
 Exit:
     /* 关闭串口 */
@@ -301,60 +591,93 @@ static int receive_data(Para_t *pPara)
     int fd = 0;
     unsigned char buffer[1024] = {0};
     int length = 0;
-    int sum = 0;
+    uint64_t sum = 0;
     int i = 0;
-    struct termios option;
+    uint64_t messages = 0;
+    uint64_t errors = 0;
+    uint64_t count = 0;
 
-    /* 打开接收串口 */
-    fd = open(pPara->path, O_RDWR | O_NOCTTY);
+    /* 打开接收串口, 接收8个字节或字节间隔0.1秒时read返回,
+       浸泡测试有数据就返回, 1秒没有数据返回0 */
+    fd = tty_open(pPara, 10, pPara->soak ? 0 : 8);
     if (fd == -1)
     {
-        printf("open %s failed!%d\n", pPara->path, errno);
         return -21;
     }
 
-    /* 获取以前参数 */
-    ret = tcgetattr(fd, &option);
+    if (pPara->rs485)
+    {
+        rs485_set(fd, pPara->before[0], pPara->after[0]);
+    }
 
-    /* 设置波特率 */
-    ret = cfsetispeed(&option, pPara->baud2);
-    ret = cfsetospeed(&option, pPara->baud2);
+    /* 轮询应答模式 */
+    if (pPara->poll)
+    {
+        ret = rs_slave(fd, pPara);
+        goto Exit;
+    }
 
-    /* 数据位8位 停止位1位 奇校验 */
-    option.c_cflag |= (CLOCAL | CREAD);
-    option.c_cflag |= PARENB;
-    option.c_cflag |= PARODD;
-    option.c_cflag &= ~CSTOPB;
-    option.c_cflag &= ~CSIZE;
-    option.c_cflag |= CS8;
-    option.c_cflag &= ~CRTSCTS; /* 取消硬件流控制 */
+    /* 分帧模式 */
+    if (pPara->stuff >= 0)
+    {
+        ret = st_receive(fd, pPara);
+        goto Exit;
+    }
 
-    /* 原始模式 */
-    option.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-    option.c_iflag &= ~(IXON | IXOFF | IXANY | INLCR | ICRNL | IGNCR);
-    option.c_oflag &= ~(OPOST | ONLCR | OCRNL);
-    option.c_cc[VTIME] = 10;    /* 10分之1秒为单位 */
-    option.c_cc[VMIN] = 8;      /* 接收X个函数返回 */
+    /* 抓包模式 */
+    if (pPara->capture[0] != 0)
+    {
+        ret = cap_receive(fd, pPara);
+        goto Exit;
+    }
 
-    /* 设置模式并清空缓冲区 */
-    tcsetattr(fd, TCSAFLUSH, &option);
+    /* 统计性能计数器时, ctrl+c后要打印结果 */
+    if (pPara->perf)
+    {
+        install_quit();
+    }
 
     /* 打印接收数据 */
     printf("press ctrl+c to quit.\n");
-    for (; ; sum += length)
+    errors = tty_errors(fd);
+    perf_begin();
+    for (;;)
     {
         length = read(fd, buffer, sizeof(buffer));
-        if (length == 0)
+        if ((length == 0) && !pPara->soak)
         {
             printf("read return 0!\n");
         }
         if (length == -1)
         {
+            if (s_quit)
+            {
+                break;
+            }
             printf("read failed!%d\n", errno);
             ret = -21;
             goto Exit;
         }
 
+        if (length > 0)
+        {
+            sum += length;
+            messages++;
+        }
+
+        /* 浸泡测试不打印, 超时返回0时统计一个空秒 */
+        if (pPara->soak)
+        {
+            count = tty_errors(fd);
+            soak_add(&s_soak, (length > 0) ? 1 : 0, length, count - errors, -1);
+            errors = count;
+            if (s_quit)
+            {
+                break;
+            }
+            continue;
+        }
+
         printf("--- ");
         for (i = 0; i < length; i++)
         {
@@ -363,6 +686,7 @@ static int receive_data(Para_t *pPara)
         }
         printf("--- %s\n", pPara->name);
     }
+    perf_end("ttys receive", messages, sum);
 
     ret = 0;
 
@@ -375,3 +699,1457 @@ Exit:
 
     return ret;
 }
+
+/**
+    @fn         static void signal_quit(int sig)
+    @brief      ctrl+c信号处理
+    @author     agent
+    @param[in]  sig         int         信号
+    @note       只设置退出标志, 阻塞的read会以EINTR返回.
+*/
+static void signal_quit(int sig)
+{
+    s_quit = 1;
+}
+
+/**
+    @fn         static void install_quit(void)
+    @brief      安装ctrl+c信号处理
+    @author     agent
+    @note       不设置SA_RESTART, 让阻塞的系统调用返回, 以便关闭抓包文件.
+*/
+static void install_quit(void)
+{
+    struct sigaction action;
+
+    memset(&action, 0x00, sizeof(struct sigaction));
+    action.sa_handler = signal_quit;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+/**
+    @fn         static int cap_receive(int fd, Para_t *pPara)
+    @brief      接收串口数据写入抓包文件
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       每次read返回的数据为一条记录, 长度由VMIN/VTIME决定.
+*/
+static int cap_receive(int fd, Para_t *pPara)
+{
+    int ret = 0;
+    int length = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    unsigned char *buffer = NULL;
+    Capture_t capture;
+
+    if (capture_open(&capture, pPara->capture, pPara->size) != 0)
+    {
+        return -3;
+    }
+
+    buffer = pool_get(&s_pool);
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        capture_close(&capture);
+        return -1;
+    }
+
+    install_quit();
+    printf("capture to %s, press ctrl+c to quit.\n", pPara->capture);
+    perf_begin();
+    while (!s_quit)
+    {
+        length = read(fd, buffer, s_pool.size);
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("read failed!%d\n", errno);
+            ret = -21;
+            break;
+        }
+
+        if (length > 0)
+        {
+            capture_write(&capture, buffer, length, 0);
+            messages++;
+            bytes += length;
+        }
+    }
+
+    perf_end("ttys capture", messages, bytes);
+    capture_close(&capture);
+    pool_put(&s_pool, buffer);
+
+    return ret;
+}
+
+/**
+    @fn         static int cap_send(int fd, Para_t *pPara)
+    @brief      按抓包文件的长度和时间间隔回放
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       倍速受波特率限制, 数据发完后用tcdrain等待发送完成.
+*/
+static int cap_send(int fd, Para_t *pPara)
+{
+    int ret = 0;
+    int sent = 0;
+    Capture_t capture;
+    CaptureRecord_t *record = NULL;
+    uint64_t first = 0;
+    uint64_t last = 0;
+    uint64_t start = 0;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint32_t offset = 0;
+
+    if (capture_load(&capture, pPara->replay) != 0)
+    {
+        return -3;
+    }
+
+    printf("replay %s records=%llu speed=%.2f\n", pPara->replay,
+           (unsigned long long)capture.head->records, pPara->speed);
+    start = clock_ns(CLOCK_MONOTONIC);
+    perf_begin();
+    while ((record = capture_next(&capture)) != NULL)
+    {
+        if (records == 0)
+        {
+            first = record->time;
+        }
+        last = record->time;
+        capture_wait(first, start, record->time, pPara->speed);
+
+        for (offset = 0; offset < record->length; offset += sent)
+        {
+            sent = write(fd, (unsigned char *)(record + 1) + offset, record->length - offset);
+            if (sent <= 0)
+            {
+                printf("write failed!%d\n", errno);
+                ret = -22;
+                goto Exit;
+            }
+        }
+        records++;
+        bytes += record->length;
+    }
+
+    tcdrain(fd);
+
+Exit:
+    printf("replayed records=%llu bytes=%llu captured %.3fs replayed %.3fs\n",
+           (unsigned long long)records, (unsigned long long)bytes, (last - first) / 1e9,
+           (clock_ns(CLOCK_MONOTONIC) - start) / 1e9);
+    perf_end("ttys replay", records, bytes);
+    capture_close(&capture);
+
+    return ret;
+}
+
+/**
+    @fn         static speed_t baud_flag(int baud)
+    @brief      波特率转换为termios标志
+    @author     agent
+    @param[in]  baud        int         波特率
+    @retval     termios波特率标志, 不支持时为B115200
+*/
+static speed_t baud_flag(int baud)
+{
+    switch (baud)
+    {
+    case 1200:      return B1200;
+    case 2400:      return B2400;
+    case 4800:      return B4800;
+    case 9600:      return B9600;
+    case 19200:     return B19200;
+    case 38400:     return B38400;
+    case 57600:     return B57600;
+    case 115200:    return B115200;
+    case 230400:    return B230400;
+    case 460800:    return B460800;
+    case 500000:    return B500000;
+    case 576000:    return B576000;
+    case 921600:    return B921600;
+    case 1000000:   return B1000000;
+    case 1152000:   return B1152000;
+    case 1500000:   return B1500000;
+    case 2000000:   return B2000000;
+    case 2500000:   return B2500000;
+    case 3000000:   return B3000000;
+    case 3500000:   return B3500000;
+    case 4000000:   return B4000000;
+    default:
+        printf("baud %d unsupported, use 115200\n", baud);
+        return B115200;
+    }
+}
+
+/**
+    @fn         static int rs_range(const char *spec, Para_t *pPara)
+    @brief      解析RS-485延时
+    @author     agent
+    @param[in]  spec        char*       before,after, 每项可以是n或n-m
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 格式错误或组合数超过RS_STEPS
+    @note       超过RS_STEPS的扫描只能测一部分, 最快组合会从不完整的结果中选出, 直接拒绝.
+*/
+static int rs_range(const char *spec, Para_t *pPara)
+{
+    int i = 0;
+    int *range[2] = {pPara->before, pPara->after};
+    char *end = NULL;
+    long long steps = 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        range[i][0] = strtol(spec, &end, 10);
+        range[i][1] = range[i][0];
+        if (end == spec)
+        {
+            return -1;
+        }
+        if (*end == '-')
+        {
+            spec = end + 1;
+            range[i][1] = strtol(spec, &end, 10);
+        }
+        if ((range[i][0] < 0) || (range[i][1] < range[i][0]))
+        {
+            return -1;
+        }
+        if (i == 0)
+        {
+            if (*end != ',')
+            {
+                return -1;
+            }
+            spec = end + 1;
+        }
+    }
+
+    steps = (long long)(pPara->before[1] - pPara->before[0] + 1) * (pPara->after[1] - pPara->after[0] + 1);
+    if (steps > RS_STEPS)
+    {
+        printf("-D sweeps %lld delay settings, at most %d!\n", steps, RS_STEPS);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int tty_open(Para_t *pPara, int vtime, int vmin)
+    @brief      打开并配置串口
+    @author     agent
+    @param[in]  pPara       Para_t      内部参数结构体
+    @param[in]  vtime       int         字节间隔超时, 单位0.1秒
+    @param[in]  vmin        int         read最少返回的字节数
+    @retval     >=0 串口
+    @retval     -1 失败
+    @note       8位数据位, 1位停止位, 校验按-c设置, 无流控, 原始模式.
+*/
+static int tty_open(Para_t *pPara, int vtime, int vmin)
+{
+    int fd = -1;
+    struct termios option;
+
+    fd = open(pPara->path, O_RDWR | O_NOCTTY);
+    if (fd == -1)
+    {
+        printf("open %s failed!%d\n", pPara->path, errno);
+        return -1;
+    }
+
+    /* 获取以前参数 */
+    tcgetattr(fd, &option);
+
+    /* 设置波特率 */
+    cfsetispeed(&option, pPara->baud2);
+    cfsetospeed(&option, pPara->baud2);
+
+    /* 数据位8位 停止位1位 */
+    option.c_cflag |= (CLOCAL | CREAD);
+    option.c_cflag &= ~(PARENB | PARODD);
+    if (pPara->check == 1) option.c_cflag |= (PARENB | PARODD);
+    if (pPara->check == 2) option.c_cflag |= PARENB;
+    option.c_cflag &= ~CSTOPB;
+    option.c_cflag &= ~CSIZE;
+    option.c_cflag |= CS8;
+    option.c_cflag &= ~CRTSCTS; /* 取消硬件流控制 */
+
+    /* 原始模式 */
+    option.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+    option.c_iflag &= ~(IXON | IXOFF | IXANY | INLCR | ICRNL | IGNCR);
+    option.c_oflag &= ~(OPOST | ONLCR | OCRNL);
+    option.c_cc[VTIME] = vtime;
+    option.c_cc[VMIN] = vmin;
+
+    /* 设置模式并清空缓冲区 */
+    tcsetattr(fd, TCSAFLUSH, &option);
+
+    return fd;
+}
+
+/**
+    @fn         static uint64_t tty_errors(int fd)
+    @brief      读取串口累计的线路错误数
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @retval     帧错误, 校验错误, 硬件和缓冲溢出之和, 驱动不支持TIOCGICOUNT时为0
+*/
+static uint64_t tty_errors(int fd)
+{
+    struct serial_icounter_struct count;
+
+    memset(&count, 0x00, sizeof(count));
+    if (ioctl(fd, TIOCGICOUNT, &count) != 0)
+    {
+        return 0;
+    }
+
+    return (uint64_t)(uint32_t)count.frame + (uint32_t)count.parity + (uint32_t)count.overrun +
+           (uint32_t)count.buf_overrun;
+}
+
+/**
+    @fn         static int rs485_set(int fd, int before, int after)
+    @brief      设置RS-485模式
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @param[in]  before      int         发送前RTS有效的延时, 单位ms
+    @param[in]  after       int         发送完RTS保持的延时, 单位ms
+    @retval     0 成功
+    @retval     -1 驱动不支持
+    @note       发送时RTS为有效电平打开驱动器, 发送完成后释放总线.
+*/
+static int rs485_set(int fd, int before, int after)
+{
+    struct serial_rs485 rs485;
+
+    memset(&rs485, 0x00, sizeof(struct serial_rs485));
+    ioctl(fd, TIOCGRS485, &rs485);
+
+    rs485.flags |= SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+    rs485.flags &= ~SER_RS485_RTS_AFTER_SEND;
+    rs485.delay_rts_before_send = before;
+    rs485.delay_rts_after_send = after;
+    if (ioctl(fd, TIOCSRS485, &rs485) != 0)
+    {
+        printf("ioctl failed(TIOCSRS485)!%d\n", errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static uint64_t rs_frame_ns(Para_t *pPara, int bytes)
+    @brief      计算数据在线路上的传输时间
+    @author     agent
+    @param[in]  pPara       Para_t      内部参数结构体
+    @param[in]  bytes       int         字节数
+    @retval     传输时间, 单位ns
+    @note       每个字节1位起始位, 8位数据位, 可选校验位, 1位停止位.
+*/
+static uint64_t rs_frame_ns(Para_t *pPara, int bytes)
+{
+    int bits = 10 + (pPara->check ? 1 : 0);
+
+    return (uint64_t)bytes * bits * 1000000000ULL / pPara->baud;
+}
+
+/**
+    @fn         static int rs_read(int fd, unsigned char *buffer, int length, int timeout)
+    @brief      在超时时间内接收指定长度
+    @author     agent
+    @param[in]  fd          int         串口, VMIN=0 VTIME=0
+    @param[out] buffer      char*       接收缓冲
+    @param[in]  length      int         长度
+    @param[in]  timeout     int         超时, 单位ms
+    @retval     实际接收的字节数, 小于length表示超时
+*/
+static int rs_read(int fd, unsigned char *buffer, int length, int timeout)
+{
+    int got = 0;
+    int ret = 0;
+    uint64_t deadline = clock_ns(CLOCK_MONOTONIC) + (uint64_t)timeout * 1000000;
+    uint64_t now = 0;
+    struct pollfd pfd;
+
+    while (got < length)
+    {
+        now = clock_ns(CLOCK_MONOTONIC);
+        if (now >= deadline)
+        {
+            break;
+        }
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, (int)((deadline - now + 999999) / 1000000));
+        if (ret <= 0)
+        {
+            if ((ret == -1) && (errno == EINTR) && !s_quit)
+            {
+                continue;
+            }
+            break;
+        }
+
+        ret = read(fd, buffer + got, length - got);
+        if (ret > 0)
+        {
+            got += ret;
+        }
+    }
+
+    return got;
+}
+
+/**
+    @fn         static int rs_master(int fd, Para_t *pPara)
+    @brief      RS-485轮询主站, 扫描RTS延时
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       每组延时发送-n次轮询, 等待从站应答. tcdrain返回时轮询帧已发出,
+                到收完应答的时间减去应答帧的传输时间即为转向时间, 包括本站
+                发送后延时, 从站处理和从站发送前延时. 最后给出没有超时和错误的
+                最快组合. 驱动不支持TIOCSRS485时只测一次.
+*/
+static int rs_master(int fd, Para_t *pPara)
+{
+    int i = 0;
+    int got = 0;
+    int count = 0;
+    int best = -1;
+    int before = 0;
+    int after = 0;
+    int supported = 1;
+    uint64_t start = 0;
+    uint64_t sent = 0;
+    uint64_t drained = 0;
+    uint64_t done = 0;
+    uint64_t wire = rs_frame_ns(pPara, sizeof(RsFrame_t));
+    RsFrame_t request;
+    RsFrame_t resp;
+    RsResult_t result[RS_STEPS];
+    struct termios option;
+    RsResult_t *pResult = NULL;
+    Hist_t hist;
+    Hist_t cycle;
+
+    /* 应答按poll等待, 不能阻塞在read上 */
+    tcgetattr(fd, &option);
+    option.c_cc[VTIME] = 0;
+    option.c_cc[VMIN] = 0;
+    tcsetattr(fd, TCSANOW, &option);
+
+    install_quit();
+    printf("rs485 master: %d polls per setting, frame %lluus on wire\n", pPara->number,
+           (unsigned long long)wire / 1000);
+    for (before = pPara->before[0]; (before <= pPara->before[1]) && supported && !s_quit; before++)
+    {
+        for (after = pPara->after[0]; (after <= pPara->after[1]) && supported && !s_quit && (count < RS_STEPS); after++)
+        {
+            if (pPara->rs485 && (rs485_set(fd, before, after) != 0))
+            {
+                printf("rs485 unsupported, measure without driver enable delays\n");
+                supported = 0;
+            }
+
+            pResult = &result[count++];
+            memset(pResult, 0x00, sizeof(RsResult_t));
+            pResult->before = before;
+            pResult->after = after;
+            hist_init(&hist, "turnaround");
+            hist_init(&cycle, "poll cycle");
+            tcflush(fd, TCIOFLUSH);
+
+            start = clock_ns(CLOCK_MONOTONIC);
+            for (i = 0; (i < pPara->number) && !s_quit; i++)
+            {
+                request.sync = RS_SYNC;
+                request.type = RS_POLL;
+                request.seq = i;
+                request.reserved = 0;
+                sent = clock_ns(CLOCK_MONOTONIC);
+                if (write(fd, &request, sizeof(request)) != sizeof(request))
+                {
+                    printf("write failed!%d\n", errno);
+                    pResult->errors++;
+                    continue;
+                }
+                tcdrain(fd);
+                drained = clock_ns(CLOCK_MONOTONIC);
+
+                got = rs_read(fd, (unsigned char *)&resp, sizeof(resp), RS_TIMEOUT_MS + before + after);
+                done = clock_ns(CLOCK_MONOTONIC);
+                if (got != sizeof(resp))
+                {
+                    pResult->timeouts++;
+                    tcflush(fd, TCIFLUSH);
+                    continue;
+                }
+                if ((resp.sync != RS_SYNC) || (resp.type != RS_RESP) || (resp.seq != request.seq))
+                {
+                    pResult->errors++;
+                    tcflush(fd, TCIFLUSH);
+                    continue;
+                }
+
+                hist_add(&hist, (int64_t)(done - drained - wire));
+                hist_add(&cycle, (int64_t)(done - sent));
+                pResult->ok++;
+            }
+
+            pResult->rate = pResult->ok * 1e9 / (clock_ns(CLOCK_MONOTONIC) - start);
+            pResult->p99 = hist_percentile(&hist, 99);
+            printf("before=%dms after=%dms ok=%d timeouts=%d errors=%d %.1fpolls/s\n", before, after,
+                   pResult->ok, pResult->timeouts, pResult->errors, pResult->rate);
+            hist_print(&hist);
+            hist_print(&cycle);
+
+            if ((pResult->ok != 0) && (pResult->timeouts == 0) && (pResult->errors == 0) &&
+                ((best < 0) || (pResult->rate > result[best].rate)))
+            {
+                best = count - 1;
+            }
+        }
+    }
+
+    if (best >= 0)
+    {
+        printf("fastest stable: before=%dms after=%dms %.1fpolls/s turnaround p99=%.3fus\n",
+               result[best].before, result[best].after, result[best].rate, result[best].p99 / 1000.0);
+    }
+    else
+    {
+        printf("no stable setting\n");
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int rs_slave(int fd, Para_t *pPara)
+    @brief      RS-485轮询从站
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       收到完整轮询帧后立即应答. 同步字节不对时丢弃输入重新同步.
+*/
+static int rs_slave(int fd, Para_t *pPara)
+{
+    int got = 0;
+    int ret = 0;
+    uint64_t polls = 0;
+    uint64_t errors = 0;
+    RsFrame_t request;
+    struct termios option;
+
+    /* 每收到一个字节就返回, 自己拼帧 */
+    tcgetattr(fd, &option);
+    option.c_cc[VTIME] = 0;
+    option.c_cc[VMIN] = 1;
+    tcsetattr(fd, TCSANOW, &option);
+
+    install_quit();
+    printf("rs485 slave, press ctrl+c to quit.\n");
+    while (!s_quit)
+    {
+        ret = read(fd, (unsigned char *)&request + got, sizeof(request) - got);
+        if (ret <= 0)
+        {
+            if ((ret == -1) && (errno != EINTR))
+            {
+                printf("read failed!%d\n", errno);
+                break;
+            }
+            continue;
+        }
+
+        got += ret;
+        if ((got > 0) && (request.sync != RS_SYNC))
+        {
+            errors++;
+            got = 0;
+            tcflush(fd, TCIFLUSH);
+            continue;
+        }
+        if (got < sizeof(request))
+        {
+            continue;
+        }
+        got = 0;
+
+        if (request.type != RS_POLL)
+        {
+            errors++;
+            continue;
+        }
+
+        request.type = RS_RESP;
+        if (write(fd, &request, sizeof(request)) != sizeof(request))
+        {
+            printf("write failed!%d\n", errno);
+            break;
+        }
+        polls++;
+    }
+
+    printf("rs485 slave: polls=%llu errors=%llu\n", (unsigned long long)polls, (unsigned long long)errors);
+
+    return 0;
+}
+
+/**
+    @fn         static int write_all(int fd, const unsigned char *buffer, int length)
+    @brief      写入全部数据
+    @author     agent
+    @param[in]  fd          int         串口
+    @param[in]  buffer      char*       数据
+    @param[in]  length      int         长度
+    @retval     length 成功
+    @retval     -1 失败
+*/
+static int write_all(int fd, const unsigned char *buffer, int length)
+{
+    int sent = 0;
+    int ret = 0;
+
+    while (sent < length)
+    {
+        ret = write(fd, buffer + sent, length - sent);
+        if (ret <= 0)
+        {
+            if ((ret == -1) && (errno == EINTR))
+            {
+                continue;
+            }
+            return -1;
+        }
+        sent += ret;
+    }
+
+    return sent;
+}
+
+/**
+    @fn         static int st_send(int fd, Para_t *pPara)
+    @brief      发送SLIP/HDLC帧
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       每帧-n字节, 开头为发送时间和序号, 其余为0-255, 共发送-N帧, 最后发送结束帧.
+                打印帧速率, 填充开销和编码耗时. 线路速率上限按每字节10或11位计算.
+*/
+static int st_send(int fd, Para_t *pPara)
+{
+    int i = 0;
+    int ret = 0;
+    int size = pPara->number;
+    size_t length = 0;
+    uint64_t now = 0;
+    uint64_t start = 0;
+    uint64_t encode = 0;
+    uint64_t wire = 0;
+    uint32_t seq = 0;
+    double seconds = 0;
+    unsigned char payload[1024];
+    unsigned char *out = pool_get(&s_pool);
+
+    if (out == NULL)
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    if (size < STUFF_HEAD) size = STUFF_HEAD;
+    for (i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = i;
+    }
+
+    printf("%s crc%d: %d frames of %d bytes\n", s_stuff[pPara->stuff], pPara->crc, pPara->frames, size);
+    start = clock_ns(CLOCK_MONOTONIC);
+    perf_begin();
+    for (i = 0; i <= pPara->frames; i++)
+    {
+        /* 最后一帧序号为STUFF_END, 通知接收端打印统计 */
+        seq = (i == pPara->frames) ? STUFF_END : i;
+        now = clock_ns(CLOCK_REALTIME);
+        memcpy(payload, &now, sizeof(now));
+        memcpy(payload + sizeof(now), &seq, sizeof(seq));
+
+        now = clock_ns(CLOCK_MONOTONIC);
+        length = stuff_encode(pPara->stuff, pPara->crc, payload, size, out);
+        encode += clock_ns(CLOCK_MONOTONIC) - now;
+
+        if (write_all(fd, out, length) != length)
+        {
+            printf("write failed!%d\n", errno);
+            ret = -22;
+            break;
+        }
+        if (seq != STUFF_END)
+        {
+            wire += length;
+        }
+    }
+    tcdrain(fd);
+
+    i = (i > pPara->frames) ? pPara->frames : i;
+    seconds = (clock_ns(CLOCK_MONOTONIC) - start) / 1e9;
+    printf("sent frames=%d wire=%llu overhead=%.2f%% %.1fframes/s line limit %.1fframes/s encode %.1fns/frame %.1fMB/s\n",
+           i, (unsigned long long)wire,
+           i ? (wire * 100.0 / ((uint64_t)i * (size + pPara->crc / 8)) - 100) : 0,
+           seconds > 0 ? i / seconds : 0,
+           wire ? pPara->baud / (10.0 + (pPara->check ? 1 : 0)) / ((double)wire / i) : 0,
+           i ? (double)encode / i : 0, encode ? (uint64_t)i * size * 1e3 / encode : 0);
+    perf_end("ttys frame send", i, wire);
+    pool_put(&s_pool, out);
+
+    return ret;
+}
+
+/**
+    @fn         static void st_report(Unstuff_t *pUnstuff, Hist_t *pHist, uint64_t bytes, uint64_t lost,
+                                      uint64_t decode, uint64_t wire, uint64_t first, uint64_t last)
+    @brief      打印接收统计
+    @author     agent
+    @param[in]  pUnstuff    Unstuff_t*  解码状态
+    @param[in]  pHist       Hist_t*     帧延时直方图
+    @param[in]  bytes       uint64_t    帧内容字节数
+    @param[in]  lost        uint64_t    序号缺口
+    @param[in]  decode      uint64_t    解码耗时, 单位ns
+    @param[in]  wire        uint64_t    接收的线路字节数
+    @param[in]  first       uint64_t    第一帧时间
+    @param[in]  last        uint64_t    最后一帧时间
+*/
+static void st_report(Unstuff_t *pUnstuff, Hist_t *pHist, uint64_t bytes, uint64_t lost,
+                      uint64_t decode, uint64_t wire, uint64_t first, uint64_t last)
+{
+    double seconds = (last - first) / 1e9;
+
+    printf("received frames=%llu crc errors=%llu overflows=%llu lost=%llu %.1fframes/s %.3fMbps decode %.2fns/byte\n",
+           (unsigned long long)pHist->count, (unsigned long long)pUnstuff->errors,
+           (unsigned long long)pUnstuff->overflows, (unsigned long long)lost,
+           seconds > 0 ? pHist->count / seconds : 0, seconds > 0 ? bytes * 8 / seconds / 1e6 : 0,
+           wire ? (double)decode / wire : 0);
+    hist_print(pHist);
+}
+
+/**
+    @fn         static int st_receive(int fd, Para_t *pPara)
+    @brief      接收SLIP/HDLC帧
+    @author     agent
+    @param[in]  fd          int         已配置好的串口
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       校验CRC和序号, 用帧中的发送时间统计每帧延时(两端时钟须同步, 同机测试最准确).
+                收到结束帧或ctrl+c时打印统计.
+*/
+static int st_receive(int fd, Para_t *pPara)
+{
+    int ret = 0;
+    int length = 0;
+    size_t left = 0;
+    size_t size = 0;
+    uint32_t seq = 0;
+    uint32_t next = 0;
+    uint64_t now = 0;
+    uint64_t sent = 0;
+    uint64_t start = 0;
+    uint64_t bytes = 0;
+    uint64_t lost = 0;
+    uint64_t decode = 0;
+    uint64_t wire = 0;
+    uint64_t first = 0;
+    uint64_t last = 0;
+    const uint8_t *data = NULL;
+    const uint8_t *frame = NULL;
+    unsigned char *buffer = pool_get(&s_pool);
+    struct termios option;
+    Unstuff_t *pUnstuff = pool_get(&s_pool);
+    Hist_t hist;
+
+    if ((buffer == NULL) || (pUnstuff == NULL))
+    {
+        printf("buffer pool empty!\n");
+        ret = -1;
+        goto Exit;
+    }
+
+    /* 有数据就返回, 不等VMIN凑齐 */
+    tcgetattr(fd, &option);
+    option.c_cc[VTIME] = 0;
+    option.c_cc[VMIN] = 1;
+    tcsetattr(fd, TCSANOW, &option);
+
+    unstuff_init(pUnstuff, pPara->stuff, pPara->crc);
+    hist_init(&hist, "frame latency");
+    install_quit();
+    printf("%s crc%d receive, press ctrl+c to quit.\n", s_stuff[pPara->stuff], pPara->crc);
+    perf_begin();
+    while (!s_quit)
+    {
+        length = read(fd, buffer, s_pool.size);
+        now = clock_ns(CLOCK_REALTIME);
+        if (length <= 0)
+        {
+            if ((length == -1) && (errno != EINTR))
+            {
+                printf("read failed!%d\n", errno);
+                ret = -21;
+                break;
+            }
+            continue;
+        }
+
+        data = buffer;
+        left = length;
+        wire += length;
+        start = clock_ns(CLOCK_MONOTONIC);
+        while ((frame = unstuff_next(pUnstuff, &data, &left, &size)) != NULL)
+        {
+            if (size < STUFF_HEAD)
+            {
+                continue;
+            }
+            memcpy(&sent, frame, sizeof(sent));
+            memcpy(&seq, frame + sizeof(sent), sizeof(seq));
+
+            if (seq == STUFF_END)
+            {
+                decode += clock_ns(CLOCK_MONOTONIC) - start;
+                st_report(pUnstuff, &hist, bytes, lost, decode, wire, first, last);
+                perf_end("ttys frame receive", hist.count, bytes);
+                perf_begin();
+                hist_init(&hist, "frame latency");
+                pUnstuff->errors = 0;
+                pUnstuff->overflows = 0;
+                next = 0;
+                bytes = 0;
+                lost = 0;
+                decode = 0;
+                wire = 0;
+                start = clock_ns(CLOCK_MONOTONIC);
+                continue;
+            }
+
+            if (seq > next)
+            {
+                lost += seq - next;
+            }
+            next = seq + 1;
+            if (hist.count == 0)
+            {
+                first = now;
+            }
+            last = now;
+            hist_add(&hist, (int64_t)(now - sent));
+            bytes += size;
+        }
+        decode += clock_ns(CLOCK_MONOTONIC) - start;
+    }
+
+    if (hist.count != 0)
+    {
+        st_report(pUnstuff, &hist, bytes, lost, decode, wire, first, last);
+        perf_end("ttys frame receive", hist.count, bytes);
+    }
+
+Exit:
+    if (buffer != NULL) pool_put(&s_pool, buffer);
+    if (pUnstuff != NULL) pool_put(&s_pool, pUnstuff);
+
+    return ret;
+}
+
+/**
+    @fn         static int gw_parse(const char *spec, Gateway_t *pGw)
+    @brief      解析网关参数
+    @author     agent
+    @param[in]  spec        char*       ttyS0,tcp:4001 或 ttyS0,udp:4001[,192.168.1.5:4001]
+    @param[out] pGw         Gateway_t*  网关串口
+    @retval     0 成功
+    @retval     -1 失败
+    @note       udp没有指定对端时, 串口数据发给最后一个发来数据的地址.
+*/
+static int gw_parse(const char *spec, Gateway_t *pGw)
+{
+    char name[64];
+    char proto[8];
+    char ip[32];
+    int peer = 0;
+    int n = 0;
+
+    memset(pGw, 0x00, sizeof(Gateway_t));
+    n = sscanf(spec, "%63[^,],%7[^:]:%d,%31[^:]:%d", name, proto, &pGw->port, ip, &peer);
+    if ((n != 3) && (n != 5))
+    {
+        printf("bad gateway %s!\n", spec);
+        return -1;
+    }
+
+    if (strcmp(proto, "udp") == 0)
+    {
+        pGw->udp = 1;
+    }
+    else if (strcmp(proto, "tcp") != 0)
+    {
+        printf("bad gateway %s!\n", spec);
+        return -1;
+    }
+
+    if (n == 5)
+    {
+        pGw->peer.sin_family = AF_INET;
+        pGw->peer.sin_port = htons(peer);
+        if (!pGw->udp || (inet_pton(AF_INET, ip, &pGw->peer.sin_addr) != 1))
+        {
+            printf("bad gateway %s!\n", spec);
+            return -1;
+        }
+        pGw->known = 2;
+    }
+
+    snprintf(pGw->path, sizeof(pGw->path), "/dev/%s", name);
+    snprintf(pGw->upName, sizeof(pGw->upName), "%s -> %s:%d", name, proto, pGw->port);
+    snprintf(pGw->downName, sizeof(pGw->downName), "%s:%d -> %s", proto, pGw->port, name);
+    hist_init(&pGw->upHist, pGw->upName);
+    hist_init(&pGw->downHist, pGw->downName);
+
+    return 0;
+}
+
+/**
+    @fn         static int gw_open(Gateway_t *pGw, Para_t *pPara)
+    @brief      打开网关的串口和套接字
+    @author     agent
+    @param[in]  pGw         Gateway_t*  网关串口
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     -1 失败
+    @note       串口非阻塞, VMIN=0 VTIME=0, 由事件循环按字节间隔超时决定何时发送;
+                驱动支持时打开ASYNC_LOW_LATENCY, 收到的数据不经过工作队列延迟.
+*/
+static int gw_open(Gateway_t *pGw, Para_t *pPara)
+{
+    int i = 0;
+    int opt = 1;
+    Para_t para = *pPara;
+    struct serial_struct serial;
+    struct sockaddr_in local;
+
+    pGw->tty = -1;
+    pGw->sock = -1;
+    for (i = 0; i < GW_CLIENTS; i++)
+    {
+        pGw->client[i] = -1;
+    }
+
+    pGw->rx = pool_get(&s_pool);
+    pGw->tx = pool_get(&s_pool);
+    if ((pGw->rx == NULL) || (pGw->tx == NULL))
+    {
+        printf("buffer pool empty!\n");
+        return -1;
+    }
+
+    strcpy(para.path, pGw->path);
+    pGw->tty = tty_open(&para, 0, 0);
+    if (pGw->tty == -1)
+    {
+        return -1;
+    }
+    fcntl(pGw->tty, F_SETFL, fcntl(pGw->tty, F_GETFL) | O_NONBLOCK);
+    if (ioctl(pGw->tty, TIOCGSERIAL, &serial) == 0)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(pGw->tty, TIOCSSERIAL, &serial);
+    }
+    if (pPara->rs485)
+    {
+        rs485_set(pGw->tty, pPara->before[0], pPara->after[0]);
+    }
+
+    pGw->sock = socket(AF_INET, pGw->udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (pGw->sock == -1)
+    {
+        printf("socket failed!%d\n", errno);
+        return -1;
+    }
+    setsockopt(pGw->sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&local, 0x00, sizeof(struct sockaddr_in));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(pGw->port);
+    local.sin_addr.s_addr = INADDR_ANY;
+    if (bind(pGw->sock, (struct sockaddr *)&local, sizeof(struct sockaddr_in)) == -1)
+    {
+        printf("bind failed!%d\n", errno);
+        return -1;
+    }
+
+    if (!pGw->udp && (listen(pGw->sock, GW_CLIENTS) == -1))
+    {
+        printf("listen failed!%d\n", errno);
+        return -1;
+    }
+
+    printf("gateway %s <-> %s:%d\n", pGw->path, pGw->udp ? "udp" : "tcp", pGw->port);
+
+    return 0;
+}
+
+/**
+    @fn         static void gw_close(Gateway_t *pGw)
+    @brief      关闭网关的串口和套接字
+    @author     agent
+    @param[in]  pGw         Gateway_t*  网关串口
+*/
+static void gw_close(Gateway_t *pGw)
+{
+    int i = 0;
+
+    for (i = 0; i < GW_CLIENTS; i++)
+    {
+        if (pGw->client[i] != -1)
+        {
+            close(pGw->client[i]);
+        }
+    }
+    if (pGw->sock != -1)
+    {
+        close(pGw->sock);
+    }
+    if (pGw->tty != -1)
+    {
+        close(pGw->tty);
+    }
+    if (pGw->rx != NULL)
+    {
+        pool_put(&s_pool, pGw->rx);
+    }
+    if (pGw->tx != NULL)
+    {
+        pool_put(&s_pool, pGw->tx);
+    }
+}
+
+/**
+    @fn         static void gw_flush(Gateway_t *pGw, int full)
+    @brief      把串口攒下的数据发往网络
+    @author     agent
+    @param[in]  pGw         Gateway_t*  网关串口
+    @param[in]  full        int         1:攒满-n字节 0:字节间隔超时
+    @note       延时从读到第一个字节算到发送完成, 包括等待字节间隔超时的时间.
+                tcp客户端的发送缓冲满说明它不再读, 关闭它而不是阻塞整个循环.
+*/
+static void gw_flush(Gateway_t *pGw, int full)
+{
+    int i = 0;
+    int n = 0;
+    int sent = 0;
+
+    if (pGw->udp)
+    {
+        if (pGw->known && (sendto(pGw->sock, pGw->rx, pGw->rxLength, 0, (struct sockaddr *)&pGw->peer,
+                                  sizeof(struct sockaddr_in)) == pGw->rxLength))
+        {
+            sent = 1;
+        }
+    }
+    else
+    {
+        for (i = 0; i < GW_CLIENTS; i++)
+        {
+            if (pGw->client[i] == -1)
+            {
+                continue;
+            }
+
+            n = send(pGw->client[i], pGw->rx, pGw->rxLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n != pGw->rxLength)
+            {
+                printf("%s client too slow, closed!%d\n", pGw->upName, errno);
+                close(pGw->client[i]);
+                pGw->client[i] = -1;
+                continue;
+            }
+            sent = 1;
+        }
+    }
+
+    if (sent)
+    {
+        hist_add(&pGw->upHist, (int64_t)(clock_ns(CLOCK_MONOTONIC) - pGw->first));
+        pGw->up += pGw->rxLength;
+    }
+    else
+    {
+        pGw->drops += pGw->rxLength;
+    }
+    pGw->flushes++;
+    pGw->fulls += full;
+    pGw->rxLength = 0;
+}
+
+/**
+    @fn         static void gw_write(Gateway_t *pGw, uint64_t now)
+    @brief      把网络收到的数据写入串口
+    @author     agent
+    @param[in]  pGw         Gateway_t*  网关串口
+    @param[in]  now         uint64_t    当前时间
+    @note       延时从收到最早的一段数据算到全部交给串口驱动, 不包括线路上的发送时间.
+*/
+static void gw_write(Gateway_t *pGw, uint64_t now)
+{
+    int n = write(pGw->tty, pGw->tx + pGw->txHead, pGw->txTail - pGw->txHead);
+
+    if (n > 0)
+    {
+        pGw->txHead += n;
+    }
+
+    if (pGw->txHead == pGw->txTail)
+    {
+        hist_add(&pGw->downHist, (int64_t)(clock_ns(CLOCK_MONOTONIC) - pGw->pending));
+        pGw->txHead = 0;
+        pGw->txTail = 0;
+    }
+}
+
+/**
+    @fn         static int gw_receive(Gateway_t *pGw, int fd, uint64_t now)
+    @brief      从网络接收数据放入串口发送缓冲
+    @author     agent
+    @param[in]  pGw         Gateway_t*  网关串口
+    @param[in]  fd          int         tcp客户端或udp套接字
+    @param[in]  now         uint64_t    当前时间
+    @retval     >=0 接收的字节数
+    @retval     -1 连接已关闭
+*/
+static int gw_receive(Gateway_t *pGw, int fd, uint64_t now)
+{
+    int n = 0;
+    int room = 0;
+    struct sockaddr_in from;
+    socklen_t fromLength = sizeof(struct sockaddr_in);
+
+    if (pGw->txHead > 0)
+    {
+        memmove(pGw->tx, pGw->tx + pGw->txHead, pGw->txTail - pGw->txHead);
+        pGw->txTail -= pGw->txHead;
+        pGw->txHead = 0;
+    }
+    room = s_pool.size - pGw->txTail;
+
+    if (pGw->udp)
+    {
+        n = recvfrom(fd, pGw->tx + pGw->txTail, room, MSG_DONTWAIT | MSG_TRUNC, (struct sockaddr *)&from, &fromLength);
+        if (n < 0)
+        {
+            return 0;
+        }
+        if (pGw->known != 2)
+        {
+            pGw->peer = from;
+            pGw->known = 1;
+        }
+        if (n > room)
+        {
+            pGw->drops += n - room;
+            n = room;
+        }
+    }
+    else
+    {
+        n = recv(fd, pGw->tx + pGw->txTail, room, MSG_DONTWAIT);
+        if (n <= 0)
+        {
+            return ((n == -1) && (errno == EAGAIN)) ? 0 : -1;
+        }
+    }
+
+    if (pGw->txTail == 0)
+    {
+        pGw->pending = now;
+    }
+    pGw->txTail += n;
+    pGw->down += n;
+
+    return n;
+}
+
+/**
+    @fn         static void gw_report(Gateway_t *pGw, uint64_t elapsed)
+    @brief      打印网关统计
+    @author     agent
+    @param[in]  pGw         Gateway_t*  网关串口
+    @param[in]  elapsed     uint64_t    运行时间, 单位ns
+*/
+static void gw_report(Gateway_t *pGw, uint64_t elapsed)
+{
+    double seconds = elapsed / 1e9;
+
+    printf("%s: up=%llu bytes %.0fB/s down=%llu bytes %.0fB/s flushes=%llu full=%llu timeout=%llu avg=%.1fB drops=%llu\n",
+           pGw->path, (unsigned long long)pGw->up, pGw->up / seconds, (unsigned long long)pGw->down,
+           pGw->down / seconds, (unsigned long long)pGw->flushes, (unsigned long long)pGw->fulls,
+           (unsigned long long)(pGw->flushes - pGw->fulls), pGw->flushes ? (double)pGw->up / pGw->flushes : 0,
+           (unsigned long long)pGw->drops);
+    hist_print(&pGw->upHist);
+    hist_print(&pGw->downHist);
+}
+
+/**
+    @fn         static int gw_run(Para_t *pPara)
+    @brief      串口网络网关
+    @author     agent
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       一个ppoll循环处理所有串口, 监听, 客户端和udp套接字.
+                串口数据在字节间隔超过-t或攒满-n字节时发送, 超时由循环计算, 精度不受VTIME的0.1秒限制.
+                网络数据立即写串口, 串口缓冲满时暂停接收, tcp由窗口反压, udp由内核丢弃.
+                ctrl+c后打印每个串口两个方向的字节数, 速率和延时分布.
+*/
+static int gw_run(Para_t *pPara)
+{
+    int i = 0;
+    int j = 0;
+    int n = 0;
+    int fd = -1;
+    int ret = 0;
+    int count = 0;
+    int opt = 1;
+    int room = 0;
+    uint64_t gap = 0;
+    uint64_t now = 0;
+    uint64_t start = 0;
+    uint64_t deadline = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    struct pollfd fds[GW_PORTS * (2 + GW_CLIENTS)];
+    int owner[GW_PORTS * (2 + GW_CLIENTS)];
+    int slot[GW_PORTS * (2 + GW_CLIENTS)];  /* -2:串口 -1:监听或udp >=0:客户端序号 */
+    struct timespec timeout;
+    Gateway_t *pGw = NULL;
+    Gateway_t gateway[GW_PORTS];
+
+    for (i = 0; i < pPara->gateways; i++)
+    {
+        if (gw_parse(pPara->gateway[i], &gateway[i]) != 0)
+        {
+            return -1;
+        }
+        gateway[i].tty = -1;
+        gateway[i].sock = -1;
+        for (j = 0; j < GW_CLIENTS; j++)
+        {
+            gateway[i].client[j] = -1;
+        }
+    }
+
+    for (i = 0; i < pPara->gateways; i++)
+    {
+        if (gw_open(&gateway[i], pPara) != 0)
+        {
+            ret = -1;
+            goto Exit;
+        }
+    }
+
+    /* 默认3.5个字符时间, 与Modbus RTU的帧间隔相同 */
+    gap = pPara->gap ? (uint64_t)pPara->gap * 1000 : rs_frame_ns(pPara, 35) / 10;
+    printf("inter-character timeout %.1fus, flush at %d bytes, press ctrl+c to quit.\n", gap / 1000.0, pPara->number);
+
+    install_quit();
+    start = clock_ns(CLOCK_MONOTONIC);
+    perf_begin();
+    while (!s_quit)
+    {
+        count = 0;
+        deadline = UINT64_MAX;
+        for (i = 0; i < pPara->gateways; i++)
+        {
+            pGw = &gateway[i];
+            room = (pGw->txTail - pGw->txHead) < (int)s_pool.size;
+
+            fds[count].fd = pGw->tty;
+            fds[count].events = POLLIN | ((pGw->txTail > pGw->txHead) ? POLLOUT : 0);
+            owner[count] = i;
+            slot[count++] = -2;
+
+            fds[count].fd = pGw->sock;
+            fds[count].events = (!pGw->udp || room) ? POLLIN : 0;
+            owner[count] = i;
+            slot[count++] = -1;
+
+            for (j = 0; j < GW_CLIENTS; j++)
+            {
+                if (pGw->client[j] != -1)
+                {
+                    fds[count].fd = pGw->client[j];
+                    fds[count].events = room ? POLLIN : 0;
+                    owner[count] = i;
+                    slot[count++] = j;
+                }
+            }
+
+            if ((pGw->rxLength > 0) && (pGw->last + gap < deadline))
+            {
+                deadline = pGw->last + gap;
+            }
+        }
+
+        now = clock_ns(CLOCK_MONOTONIC);
+        if (deadline != UINT64_MAX)
+        {
+            deadline = (deadline > now) ? deadline - now : 0;
+            timeout.tv_sec = deadline / 1000000000;
+            timeout.tv_nsec = deadline % 1000000000;
+        }
+        n = ppoll(fds, count, (deadline == UINT64_MAX) ? NULL : &timeout, NULL);
+        if ((n == -1) && (errno != EINTR))
+        {
+            printf("ppoll failed!%d\n", errno);
+            ret = -1;
+            break;
+        }
+
+        now = clock_ns(CLOCK_MONOTONIC);
+        for (i = 0; (n > 0) && (i < count); i++)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+            pGw = &gateway[owner[i]];
+
+            if (slot[i] == -2)
+            {
+                if (fds[i].revents & POLLOUT)
+                {
+                    gw_write(pGw, now);
+                }
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                {
+                    continue;
+                }
+
+                if (pGw->rxLength == (int)s_pool.size)
+                {
+                    gw_flush(pGw, 1);
+                }
+                ret = read(pGw->tty, pGw->rx + pGw->rxLength, s_pool.size - pGw->rxLength);
+                if (ret <= 0)
+                {
+                    if ((ret == -1) && (errno == EAGAIN))
+                    {
+                        continue;
+                    }
+                    printf("read %s failed!%d\n", pGw->path, errno);
+                    ret = -21;
+                    goto Report;
+                }
+                if (pGw->rxLength == 0)
+                {
+                    pGw->first = now;
+                }
+                pGw->last = now;
+                pGw->rxLength += ret;
+                if (pGw->rxLength >= pPara->number)
+                {
+                    gw_flush(pGw, 1);
+                }
+            }
+            else if ((slot[i] == -1) && !pGw->udp)
+            {
+                fd = accept(pGw->sock, NULL, NULL);
+                if (fd == -1)
+                {
+                    continue;
+                }
+                for (j = 0; (j < GW_CLIENTS) && (pGw->client[j] != -1); j++)
+                {
+                }
+                if (j == GW_CLIENTS)
+                {
+                    printf("%s too many clients!\n", pGw->upName);
+                    close(fd);
+                    continue;
+                }
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+                pGw->client[j] = fd;
+            }
+            else
+            {
+                if (gw_receive(pGw, fds[i].fd, now) < 0)
+                {
+                    close(pGw->client[slot[i]]);
+                    pGw->client[slot[i]] = -1;
+                    continue;
+                }
+                if (pGw->txTail > pGw->txHead)
+                {
+                    gw_write(pGw, now);
+                }
+            }
+        }
+
+        /* 字节间隔超时 */
+        now = clock_ns(CLOCK_MONOTONIC);
+        for (i = 0; i < pPara->gateways; i++)
+        {
+            if ((gateway[i].rxLength > 0) && (now >= gateway[i].last + gap))
+            {
+                gw_flush(&gateway[i], 0);
+            }
+        }
+    }
+    ret = 0;
+
+Report:
+    now = clock_ns(CLOCK_MONOTONIC);
+    for (i = 0; i < pPara->gateways; i++)
+    {
+        gw_report(&gateway[i], now - start);
+        messages += gateway[i].flushes;
+        bytes += gateway[i].up + gateway[i].down;
+    }
+    perf_end("ttys gateway", messages, bytes);
+
+Exit:
+    for (i = 0; i < pPara->gateways; i++)
+    {
+        gw_close(&gateway[i]);
+    }
+
+    return ret;
+}
@@ -8,6 +8,8 @@
     @note       程序用来测试udp点播，组播，广播
 */
 
+#define _GNU_SOURCE
+
 #include "stdio.h"
 #include "stdlib.h"
 #include "unistd.h"
@@ -15,13 +17,56 @@
 #include "string.h"
 #include "errno.h"
 #include "termios.h"
+#include "signal.h"
+#include "stdint.h"
+#include "poll.h"
+#include "getopt.h"
+#include "pthread.h"
 
 #include "sys/mman.h"
 #include "sys/ioctl.h"
+#include "sys/epoll.h"
 
 #include "sys/socket.h"
 #include "netinet/in.h"
 #include "arpa/inet.h"
+#include "net/if.h"
+#include "netinet/ip.h"
+#include "netinet/udp.h"
+
+#include "linux/if_packet.h"
+#include "linux/if_ether.h"
+#include "linux/errqueue.h"
+#include "linux/net_tstamp.h"
+#include "linux/sockios.h"
+
+#include "hist.h"
+#include "lowlat.h"
+#include "capture.h"
+#include "bufpool.h"
+#include "perfcnt.h"
+#include "impair.h"
+#include "soak.h"
+
+#define TS_MAGIC        0x54535450  /* "PTST" */
+#define TS_SLOTS        4096        /* 等待follow包的数据包记录数 */
+#define TS_WAIT_MS      100         /* 等待发送时间戳的超时 */
+
+#define UDP_MAX         65536       /* 最大udp数据长度 */
+#define POOL_COUNT      32          /* 缓冲池中UDP_MAX的个数 */
+
+#define RING_THREADS    16          /* 最多接收线程数 */
+#define RING_BLOCK_SIZE (1 << 22)   /* 每个环形缓冲块4MB */
+#define RING_BLOCK_NR   16
+#define RING_FRAME_SIZE 2048
+#define RING_TIMEOUT_MS 10          /* 块未满时的超时提交时间 */
+
+#define MC_MAGIC        0x4D435354  /* "TSCM" */
+#define MC_GROUPS       4096        /* 最多组播组数 */
+#define MC_BATCH        64          /* recvmmsg每批包数 */
+#define MC_RCVBUF       (4 << 20)
+#define MC_SPIN_NS      50000       /* 距发送时刻小于此值时自旋, 否则休眠 */
+#define MC_PRINT        16          /* 最多逐组打印的行数 */
 
 /**
 参数结构体, 程序需要用的参数组成一个结构体,
@@ -33,8 +78,89 @@ typedef struct Para_s
     int type;
     int port;
     int ip;
+    int number;
+    int tstamp;
+    char ifname[IFNAMSIZ];
+    int ring;
+    int latency;
+    int busy;
+    int fifo;
+    int gap;
+    int size;
+    double speed;
+    char capture[128];
+    char replay[128];
+    int huge;
+    int perf;
+    int groups;
+    int epoll;
+    int rate;
+    char target[64];
+    char impair[256];
+    int soak;                   /* 浸泡测试 */
+    char snapshot[128];         /* 浸泡统计快照文件 */
+    int threshold;              /* 劣化阈值, 百分比 */
 } Para_t;
 
+/**
+时间戳测试包头, 与PTP两步法类似, 发送端先发送数据包,
+取得内核发送时间戳后再用follow包把发送时间戳告诉接收端.
+*/
+typedef struct TsHead_s
+{
+    uint32_t magic;
+    uint32_t type;
+    uint32_t seq;
+    uint32_t hw;                /* follow包: 1为网卡时钟的硬件时间戳, 0为CLOCK_REALTIME的软件时间戳 */
+    uint64_t time;              /* 数据包: 用户态发送时间 follow包: 内核发送时间 */
+} TsHead_t;
+
+enum
+{
+    TS_DATA = 0,
+    TS_FOLLOW,
+    TS_END,
+};
+
+/**
+接收端记录的数据包时间, 收到对应的follow包后计算各阶段延时.
+*/
+typedef struct TsSlot_s
+{
+    uint32_t seq;
+    int valid;
+    uint64_t user_tx;
+    uint64_t kernel_rx;
+    uint64_t user_rx;
+    int hw;                     /* kernel_rx为网卡时钟的硬件时间戳 */
+} TsSlot_t;
+
+/**
+组播扩展测试包头, 每个组独立编号, 接收端据此统计各组丢包和乱序.
+*/
+typedef struct McHead_s
+{
+    uint32_t magic;
+    uint32_t type;              /* TS_DATA或TS_END */
+    uint32_t group;
+    uint32_t seq;               /* 数据包: 组内序号 结束包: 该组发送总数 */
+} McHead_t;
+
+/**
+接收端每个组播组的统计.
+*/
+typedef struct McGroup_s
+{
+    uint32_t addr;
+    int fd;                     /* -E时每组一个套接字 */
+    int ended;
+    uint32_t sent;
+    uint32_t next;
+    uint64_t received;
+    uint64_t reorder;
+    uint64_t bytes;
+} McGroup_t;
+
 static char *s_string[] =
 {
     "Read",
@@ -48,8 +174,56 @@ static char *s_string2[] =
     "broad",
 };
 
+/**
+AF_PACKET接收线程, 每个线程一个TPACKET_V3环形缓冲, 通过fanout分担流量.
+*/
+typedef struct Ring_s
+{
+    pthread_t thread;
+    int index;
+    int fd;
+    unsigned char *map;
+    struct tpacket_req3 req;
+    Para_t *pPara;
+    uint64_t packets;           /* 匹配端口/地址的udp包 */
+    uint64_t bytes;
+    uint64_t others;            /* 其他包 */
+    uint64_t blocks;
+    uint64_t gaps;              /* 时间戳测试包的序号缺口 */
+    uint32_t next_seq;
+    int has_seq;
+    uint64_t kernel_packets;    /* PACKET_STATISTICS */
+    uint64_t kernel_drops;
+    uint64_t freeze;
+} Ring_t;
+
+static TsSlot_t s_slot[TS_SLOTS];
+static Pool_t s_pool;
+
+static struct option s_option[] =
+{
+    {"perf", no_argument, NULL, 'P'},
+    {"soak", optional_argument, NULL, 'W'},
+    {NULL, 0, NULL, 0},
+};
+static volatile sig_atomic_t s_quit = 0;
+static Soak_t s_soak;
+
 static int send_data(Para_t *pPara);
 static int receive_data(Para_t *pPara);
+static void install_quit(void);
+static int ts_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara);
+static int ts_receive(int fd, Para_t *pPara);
+static int ring_receive(Para_t *pPara);
+static int lat_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara);
+static int lat_receive(int fd, Para_t *pPara);
+static int cap_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara);
+static int cap_receive(int fd, Para_t *pPara);
+static int mc_join(int fd, uint32_t group, Para_t *pPara);
+static int mc_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara);
+static int mc_receive(Para_t *pPara);
+static int udp_proxy(Para_t *pPara);
+static int soak_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara);
 
 /**
     @fn         static int print_usage(void)
@@ -61,11 +235,35 @@ static int receive_data(Para_t *pPara);
 */
 static int print_usage(void)
 {
-    printf("Usage: udp -[rw] <port> -[pm] <ip> \n"
+    printf("Usage: udp -[rw] <port> -[pm] <ip> -n <number> -t -I <ifname> -k <threads>\n"
+           "           -L -B <usec> -F <priority> -g <usec> -C <file> -S <MB> -R <file> -x <speed> -H --perf\n"
+           "           -G <groups> -E -q <pps> -X <ip:port> -J <impairments> --soak[=<file>] -Q <percent>\n"
            "\t-r: recive data\n"
            "\t-w: send data\n"
            "\t-p: send p2p data\n"
            "\t-m: send multi data\n"
+           "\t-n: send number\n"
+           "\t-t: SO_TIMESTAMPING latency breakdown\n"
+           "\t-I: enable hardware timestamp on interface / ring interface\n"
+           "\t-k: AF_PACKET TPACKET_V3 ring receive with fanout threads\n"
+           "\t-L: one-way latency and cpu cost report\n"
+           "\t-B: busy poll receive, SO_BUSY_POLL usec, implies -L\n"
+           "\t-F: SCHED_FIFO priority and mlockall\n"
+           "\t-g: send gap usec\n"
+           "\t-C: capture received datagrams to file\n"
+           "\t-S: capture file size MB, default 64\n"
+           "\t-R: replay captured file\n"
+           "\t-x: replay speed, 1 real time, 0 as fast as possible\n"
+           "\t-H: hugepage backed and mlocked buffer pool\n"
+           "\t--perf: cycles/instructions/cache-misses/cs/faults per message and byte\n"
+           "\t-G: multicast fan-out over groups from -m address upward\n"
+           "\t-E: receive groups with one socket each under epoll, default one socket with IP_PKTINFO\n"
+           "\t-q: aggregate send rate over all groups, packets per second\n"
+           "\t-X: impairment proxy, forward datagrams received on -r port to ip:port and replies back\n"
+           "\t-J: impairments delay=20ms,jitter=2ms,loss=1%%,dup=0.1%%,reorder=1%%,gap=2ms,rate=10M\n"
+           "\t--soak: send or receive until ctrl+c with per second/minute/hour statistics in fixed memory,\n"
+           "\t    no hex dump, history is saved to and resumed from file\n"
+           "\t-Q: soak degradation threshold against the last hour, percent, default 30\n"
            "\tip: ip address 192.168.1.1\n"
            "\tport: listen or remote port\n"
            "Example: udp -w 8080 -p 192.168.1.101\n"
@@ -74,6 +272,18 @@ static int print_usage(void)
            "Example: udp -r 8080 -p 0\n"
            "Example: udp -r 8080 -p 192.168.1.145\n"
            "Example: udp -r 8080 -m 224.0.0.1\n"
+           "Example: udp -r 8080 -p 0 -t -I eth0\n"
+           "Example: udp -w 8080 -p 192.168.1.145 -n 10000 -t -I eth0\n"
+           "Example: udp -r 8080 -m 224.0.0.1 -k 4 -I veth1\n"
+           "Example: udp -r 8080 -p 0 -B 50 -F 50\n"
+           "Example: udp -w 8080 -p 192.168.1.145 -n 100000 -L -g 10\n"
+           "Example: udp -r 8080 -p 0 -C field.cap -S 256\n"
+           "Example: udp -w 8080 -p 192.168.1.145 -R field.cap -x 2\n"
+           "Example: udp -r 8080 -m 239.1.1.1 -G 64 -E\n"
+           "Example: udp -w 8080 -m 239.1.1.1 -G 64 -n 1000000 -q 200000\n"
+           "Example: udp -r 9000 -p 0 -X 127.0.0.1:8080 -J delay=20ms,jitter=2ms,loss=1%%\n"
+           "Example: udp -r 8080 -p 0 --soak=link.soak\n"
+           "Example: udp -w 8080 -p 192.168.1.145 -g 100 --soak\n"
           );
 
     return 0;
@@ -95,7 +305,7 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
     int ret = 0;
     int valid = 0;
 
-    while ((ret = getopt(argc, argv, "r:w:p:m:")) != -1)
+    while ((ret = getopt_long(argc, argv, "r:w:p:m:n:tI:k:LB:F:g:C:S:R:x:HPG:Eq:X:J:Q:", s_option, NULL)) != -1)
     {
         switch (ret)
         {
@@ -117,6 +327,74 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
             pPara->type = 1;
             pPara->ip = inet_addr(optarg);
             break;
+        case 'n':
+            pPara->number = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            pPara->tstamp = 1;
+            break;
+        case 'I':
+            strncpy(pPara->ifname, optarg, sizeof(pPara->ifname) - 1);
+            break;
+        case 'k':
+            pPara->ring = strtoul(optarg, NULL, 10);
+            if (pPara->ring > RING_THREADS) pPara->ring = RING_THREADS;
+            break;
+        case 'L':
+            pPara->latency = 1;
+            break;
+        case 'B':
+            pPara->latency = 1;
+            pPara->busy = strtoul(optarg, NULL, 10);
+            if (pPara->busy == 0) pPara->busy = 1;
+            break;
+        case 'F':
+            pPara->fifo = strtoul(optarg, NULL, 10);
+            break;
+        case 'g':
+            pPara->gap = strtoul(optarg, NULL, 10);
+            break;
+        case 'C':
+            strncpy(pPara->capture, optarg, sizeof(pPara->capture) - 1);
+            break;
+        case 'S':
+            pPara->size = strtoul(optarg, NULL, 10);
+            break;
+        case 'R':
+            strncpy(pPara->replay, optarg, sizeof(pPara->replay) - 1);
+            break;
+        case 'x':
+            pPara->speed = strtod(optarg, NULL);
+            break;
+        case 'H':
+            pPara->huge = 1;
+            break;
+        case 'P':
+            pPara->perf = 1;
+            break;
+        case 'G':
+            pPara->groups = strtoul(optarg, NULL, 10);
+            if (pPara->groups > MC_GROUPS) pPara->groups = MC_GROUPS;
+            break;
+        case 'E':
+            pPara->epoll = 1;
+            break;
+        case 'q':
+            pPara->rate = strtoul(optarg, NULL, 10);
+            break;
+        case 'X':
+            strncpy(pPara->target, optarg, sizeof(pPara->target) - 1);
+            break;
+        case 'J':
+            strncpy(pPara->impair, optarg, sizeof(pPara->impair) - 1);
+            break;
+        case 'W':
+            pPara->soak = 1;
+            if (optarg != NULL) strncpy(pPara->snapshot, optarg, sizeof(pPara->snapshot) - 1);
+            break;
+        case 'Q':
+            pPara->threshold = strtoul(optarg, NULL, 10);
+            break;
         }
     }
 
@@ -128,7 +406,7 @@ static int parse_usage(int argc, char *argv[], Para_t *pPara)
     }
 
     /* 参数不符合逻辑 */
-    if ((valid != 1))
+    if ((valid != 1) || (pPara->groups && (pPara->type != 1)) || (pPara->target[0] && pPara->mode))
     {
         print_usage();
         return -1;
@@ -155,6 +433,10 @@ int main(int argc, char *argv[])
     /* 默认参数 */
     memset(&para, 0x00, sizeof(Para_t));
     para.port = 8080;
+    para.number = 1;
+    para.size = CAPTURE_SIZE;
+    para.speed = 1;
+    para.threshold = SOAK_THRESHOLD;
 
     /* 解析参数 */
     ret = parse_usage(argc, argv, &para);
@@ -167,15 +449,60 @@ int main(int argc, char *argv[])
     printf("%s %s ip=0x%x port=%d\n", s_string[para.mode], s_string2[para.type],
            para.ip, para.port);
 
+    /* 收发缓冲在启动时一次分配 */
+    ret = pool_init(&s_pool, UDP_MAX, POOL_COUNT, para.huge ? (POOL_HUGE | POOL_LOCK) : 0);
+    if (ret != 0)
+    {
+        ret = -1;
+        goto Exit;
+    }
+
+    if (para.perf)
+    {
+        perf_init();
+    }
+
+    /* 浸泡测试, ctrl+c后保存快照 */
+    if (para.soak)
+    {
+        if (soak_init(&s_soak, para.snapshot, para.threshold) != 0)
+        {
+            ret = -1;
+            goto Exit;
+        }
+        install_quit();
+    }
+
     if (para.mode)
     {
         ret = send_data(&para);
     }
+    else if (para.target[0])
+    {
+        ret = udp_proxy(&para);
+    }
+    else if (para.ring)
+    {
+        ret = ring_receive(&para);
+    }
+    else if (para.groups)
+    {
+        ret = mc_receive(&para);
+    }
     else
     {
         ret = receive_data(&para);
     }
 
+    if (para.soak)
+    {
+        soak_close(&s_soak);
+    }
+
+    pool_print(&s_pool);
+    pool_destroy(&s_pool);
+    perf_exit();
+
 Exit:
     return ret;
 }
@@ -248,14 +575,56 @@ static int send_data(Para_t *pPara)
     remote.sin_port = htons(pPara->port);
     remote.sin_addr.s_addr = pPara->ip;
 
-    ret = sendto(fd, (char *)buffer, sizeof(buffer), 0, (struct sockaddr *)&remote, sizeof(struct sockaddr_in));
-    if (ret != sizeof(buffer))
+    /* 组播扩展模式 */
+    if (pPara->groups)
+    {
+        ret = mc_send(fd, &remote, pPara);
+        goto Exit;
+    }
+
+    /* 时间戳模式 */
+    if (pPara->tstamp)
+    {
+        ret = ts_send(fd, &remote, pPara);
+        goto Exit;
+    }
+
+    /* 延时测试模式 */
+    if (pPara->latency)
+    {
+        ret = lat_send(fd, &remote, pPara);
+        goto Exit;
+    }
+
+    /* 回放模式 */
+    if (pPara->replay[0] != 0)
+    {
+        ret = cap_send(fd, &remote, pPara);
+        goto Exit;
+    }
+
+    /* 浸泡测试 */
+    if (pPara->soak)
     {
-        printf("sent = %d\n", ret);
-        ret = -21;
+        ret = soak_send(fd, &remote, pPara);
         goto Exit;
     }
 
+    perf_begin();
+    for (i = 0; i < pPara->number; i++)
+    {
+        ret = sendto(fd, (char *)buffer, sizeof(buffer), 0, (struct sockaddr *)&remote, sizeof(struct sockaddr_in));
+        if (ret != sizeof(buffer))
+        {
+            printf("sent = %d\n", ret);
+            ret = -21;
+            goto Exit;
+        }
+    }
+    perf_end("udp send", i, (uint64_t)i * sizeof(buffer));
+
+    ret = 0;
+
 Exit:
     /* 关闭套接字 */
     if (fd != 0)
@@ -275,8 +644,10 @@ static int receive_data(Para_t *pPara)
     int socketLength = sizeof(struct sockaddr_in);
     unsigned char buffer[256];
     int length = 0;
-    int sum = 0;
+    uint64_t sum = 0;
     int i = 0;
+    uint64_t messages = 0;
+    struct timeval timeout;
 
     /* 创建套接字 */
     fd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -303,17 +674,84 @@ static int receive_data(Para_t *pPara)
         goto Exit;
     }
 
+    /* 组播需要加入组才能收到 */
+    if ((pPara->type == 1) && (mc_join(fd, pPara->ip, pPara) != 0))
+    {
+        ret = -2;
+        goto Exit;
+    }
+
+    /* 时间戳模式 */
+    if (pPara->tstamp)
+    {
+        ret = ts_receive(fd, pPara);
+        goto Exit;
+    }
+
+    /* 延时测试模式 */
+    if (pPara->latency)
+    {
+        ret = lat_receive(fd, pPara);
+        goto Exit;
+    }
+
+    /* 抓包模式 */
+    if (pPara->capture[0] != 0)
+    {
+        ret = cap_receive(fd, pPara);
+        goto Exit;
+    }
+
+    /* 统计性能计数器时, ctrl+c后要打印结果 */
+    if (pPara->perf)
+    {
+        install_quit();
+    }
+
+    /* 浸泡测试最多阻塞1秒, 没有数据时也能关闭统计桶并发现停顿 */
+    if (pPara->soak)
+    {
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+        {
+            printf("setsockopt failed(SO_RCVTIMEO)!%d\n", errno);
+            ret = -3;
+            goto Exit;
+        }
+    }
+
     /* 打印接收数据 */
     printf("press ctrl+c to quit.\n");
-    for (sum = 0; ; sum += length)
+    perf_begin();
+    while (1)
     {
         length = recvfrom(fd, (char *)buffer, sizeof(buffer), 0, (struct sockaddr *)&remote, &socketLength);
+        if (pPara->soak && (length == -1) && (errno == EAGAIN) && !s_quit)
+        {
+            soak_add(&s_soak, 0, 0, 0, -1);
+            continue;
+        }
+
         if (length == -1)
         {
-            printf("recvfrom failed!%d\n", errno);
+            if (!s_quit)
+            {
+                printf("recvfrom failed!%d\n", errno);
+            }
             break;
         }
 
+        sum += length;
+        messages++;
+
+        /* 浸泡测试不打印 */
+        if (pPara->soak)
+        {
+            soak_add(&s_soak, 1, length, 0, -1);
+            continue;
+        }
+
         /* 打印接收到数据 */
         printf("--- ");
         for (i = 0; i < length; i++)
@@ -323,6 +761,7 @@ static int receive_data(Para_t *pPara)
         }
         printf("--- udp port=%d\n", pPara->port);
     }
+    perf_end("udp receive", messages, sum);
 
     ret = 0;
 
@@ -334,3 +773,1974 @@ Exit:
 
     return ret;
 }
+
+/**
+    @fn         static void signal_quit(int sig)
+    @brief      ctrl+c信号处理
+    @author     agent
+    @param[in]  sig         int         信号
+    @note       只设置退出标志, 阻塞的recvmsg会以EINTR返回.
+*/
+static void signal_quit(int sig)
+{
+    s_quit = 1;
+}
+
+/**
+    @fn         static void install_quit(void)
+    @brief      安装ctrl+c信号处理
+    @author     agent
+    @note       不设置SA_RESTART, 让阻塞的系统调用返回, 以便打印统计结果.
+*/
+static void install_quit(void)
+{
+    struct sigaction action;
+
+    memset(&action, 0x00, sizeof(struct sigaction));
+    action.sa_handler = signal_quit;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+/**
+    @fn         static int ts_enable(int fd, Para_t *pPara, int tx)
+    @brief      打开套接字时间戳
+    @author     agent
+    @param[in]  fd          int         套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @param[in]  tx          int         1:发送时间戳 0:接收时间戳
+    @retval     1 硬件时间戳
+    @retval     0 软件时间戳
+    @retval     -1 失败
+    @note       指定了网卡时先尝试SIOCSHWTSTAMP, 网卡不支持(如lo)时退回软件时间戳.
+*/
+static int ts_enable(int fd, Para_t *pPara, int tx)
+{
+    int hw = 0;
+    int flags = 0;
+    struct ifreq ifr;
+    struct hwtstamp_config config;
+
+    if (pPara->ifname[0] != 0)
+    {
+        memset(&ifr, 0x00, sizeof(struct ifreq));
+        memset(&config, 0x00, sizeof(struct hwtstamp_config));
+        snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", pPara->ifname);
+        config.tx_type = HWTSTAMP_TX_ON;
+        config.rx_filter = HWTSTAMP_FILTER_ALL;
+        ifr.ifr_data = (char *)&config;
+
+        if (ioctl(fd, SIOCSHWTSTAMP, &ifr) == 0)
+        {
+            hw = 1;
+        }
+        else
+        {
+            printf("%s hardware timestamp unsupported!%d, use software\n", pPara->ifname, errno);
+        }
+    }
+
+    flags = SOF_TIMESTAMPING_SOFTWARE;
+    if (tx)
+    {
+        flags |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+        if (hw) flags |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    else
+    {
+        flags |= SOF_TIMESTAMPING_RX_SOFTWARE;
+        if (hw) flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, (char *)&flags, sizeof(flags)) != 0)
+    {
+        printf("setsockopt failed(SO_TIMESTAMPING)!%d\n", errno);
+        return -1;
+    }
+
+    return hw;
+}
+
+/**
+    @fn         static int ts_parse(struct msghdr *pMsg, uint64_t *pTime, uint32_t *pId)
+    @brief      从控制消息中取出时间戳
+    @author     agent
+    @param[in]  pMsg        msghdr*     recvmsg返回的消息
+    @param[out] pTime       uint64_t*   时间戳, 单位ns
+    @param[out] pId         uint32_t*   发送时间戳对应的OPT_ID, 可为NULL
+    @retval     1 硬件时间戳
+    @retval     0 软件时间戳
+    @retval     -1 没有时间戳
+    @note       硬件时间戳优先.
+*/
+static int ts_parse(struct msghdr *pMsg, uint64_t *pTime, uint32_t *pId)
+{
+    int ret = -1;
+    struct cmsghdr *cmsg = NULL;
+    struct scm_timestamping *stamp = NULL;
+    struct sock_extended_err *err = NULL;
+
+    for (cmsg = CMSG_FIRSTHDR(pMsg); cmsg != NULL; cmsg = CMSG_NXTHDR(pMsg, cmsg))
+    {
+        if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING))
+        {
+            stamp = (struct scm_timestamping *)CMSG_DATA(cmsg);
+            if (stamp->ts[2].tv_sec || stamp->ts[2].tv_nsec)
+            {
+                *pTime = (uint64_t)stamp->ts[2].tv_sec * 1000000000ULL + stamp->ts[2].tv_nsec;
+                ret = 1;
+            }
+            else if (stamp->ts[0].tv_sec || stamp->ts[0].tv_nsec)
+            {
+                *pTime = (uint64_t)stamp->ts[0].tv_sec * 1000000000ULL + stamp->ts[0].tv_nsec;
+                ret = 0;
+            }
+        }
+        else if ((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR) && (pId != NULL))
+        {
+            err = (struct sock_extended_err *)CMSG_DATA(cmsg);
+            if (err->ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+            {
+                *pId = err->ee_data;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+    @fn         static int ts_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+    @brief      发送带时间戳的udp数据
+    @author     agent
+    @param[in]  fd          int         已设置好的发送套接字
+    @param[in]  pRemote     sockaddr_in 目的地址
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       每个数据包发送后从MSG_ERRQUEUE取内核发送时间戳,
+                再通过另一个套接字发送follow包, follow包本身不打时间戳.
+*/
+static int ts_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+{
+    int ret = 0;
+    int fd_follow = -1;
+    int hw = 0;
+    int i = 0;
+    int opt = 1;
+    int got = 0;
+    int lost = 0;
+    unsigned char buffer[256];
+    unsigned char control[512];
+    TsHead_t *head = (TsHead_t *)buffer;
+    TsHead_t follow;
+    struct msghdr msg;
+    struct pollfd pfd;
+    uint64_t stamp = 0;
+    uint64_t deadline = 0;
+    uint32_t id = 0;
+    int kind = 0;
+
+    for (i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = i;
+    }
+
+    hw = ts_enable(fd, pPara, 1);
+    if (hw < 0)
+    {
+        return -3;
+    }
+
+    fd_follow = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_follow == -1)
+    {
+        printf("socket failed!%d\n", errno);
+        return -1;
+    }
+    setsockopt(fd_follow, SOL_SOCKET, SO_BROADCAST, (char *)&opt, sizeof(opt));
+
+    printf("timestamp %s, send %d packets\n", hw ? "hardware" : "software", pPara->number);
+    perf_begin();
+
+    for (i = 0; i < pPara->number; i++)
+    {
+        head->magic = TS_MAGIC;
+        head->type = TS_DATA;
+        head->seq = i;
+        head->hw = hw;
+        head->time = clock_ns(CLOCK_REALTIME);
+
+        ret = sendto(fd, (char *)buffer, sizeof(buffer), 0, (struct sockaddr *)pRemote, sizeof(struct sockaddr_in));
+        if (ret != sizeof(buffer))
+        {
+            printf("sent = %d\n", ret);
+            ret = -21;
+            goto Exit;
+        }
+
+        /* 等待本包的发送时间戳, 硬件模式下软件时间戳先到, 继续等硬件的 */
+        kind = -1;
+        deadline = clock_ns(CLOCK_MONOTONIC) + TS_WAIT_MS * 1000000ULL;
+        while (clock_ns(CLOCK_MONOTONIC) < deadline)
+        {
+            pfd.fd = fd;
+            pfd.events = 0;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, TS_WAIT_MS) <= 0)
+            {
+                break;
+            }
+
+            memset(&msg, 0x00, sizeof(struct msghdr));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+            {
+                continue;
+            }
+
+            id = (uint32_t)-1;
+            ret = ts_parse(&msg, &stamp, &id);
+            if ((ret < 0) || (id != (uint32_t)i))
+            {
+                continue;
+            }
+
+            kind = ret;
+            if (kind == hw)
+            {
+                break;
+            }
+        }
+
+        if (kind < 0)
+        {
+            lost++;
+            continue;
+        }
+
+        got++;
+        follow.magic = TS_MAGIC;
+        follow.type = TS_FOLLOW;
+        follow.seq = i;
+        follow.hw = kind;
+        follow.time = stamp;
+        sendto(fd_follow, (char *)&follow, sizeof(follow), 0, (struct sockaddr *)pRemote, sizeof(struct sockaddr_in));
+    }
+
+    /* 通知接收端打印统计 */
+    memset(&follow, 0x00, sizeof(follow));
+    follow.magic = TS_MAGIC;
+    follow.type = TS_END;
+    follow.seq = i;
+    sendto(fd_follow, (char *)&follow, sizeof(follow), 0, (struct sockaddr *)pRemote, sizeof(struct sockaddr_in));
+
+    printf("sent=%d tx timestamp=%d lost=%d\n", i, got, lost);
+    perf_end("udp timestamp send", i, (uint64_t)i * sizeof(buffer));
+    ret = 0;
+
+Exit:
+    if (fd_follow != -1)
+    {
+        close(fd_follow);
+    }
+
+    return ret;
+}
+
+/**
+    @fn         static void ts_report(Hist_t *pHist, uint64_t *pSkipped, int count, uint64_t packets, uint64_t bytes)
+    @brief      打印各阶段延时直方图并清零
+    @author     agent
+    @param[in]  pHist       Hist_t*     直方图数组
+    @param[in]  pSkipped    uint64_t*   各阶段因时钟域不同而没有统计的样本数
+    @param[in]  count       int         直方图个数
+    @param[in]  packets     uint64_t    收到的数据包数
+    @param[in]  bytes       uint64_t    收到的数据字节数
+*/
+static void ts_report(Hist_t *pHist, uint64_t *pSkipped, int count, uint64_t packets, uint64_t bytes)
+{
+    int i = 0;
+
+    printf("=== udp port latency breakdown, packets=%llu ===\n", (unsigned long long)packets);
+    for (i = 0; i < count; i++)
+    {
+        if ((pHist[i].count == 0) && (pSkipped[i] != 0))
+        {
+            printf("%s: unavailable, hardware and software timestamps in different clocks (%llu samples)\n",
+                   pHist[i].name, (unsigned long long)pSkipped[i]);
+        }
+        else
+        {
+            hist_print(&pHist[i]);
+        }
+        hist_init(&pHist[i], pHist[i].name);
+        pSkipped[i] = 0;
+    }
+    memset(s_slot, 0x00, sizeof(s_slot));
+
+    perf_end("udp timestamp receive", packets, bytes);
+    perf_begin();
+}
+
+/**
+    @fn         static int ts_receive(int fd, Para_t *pPara)
+    @brief      接收带时间戳的udp数据并统计延时
+    @author     agent
+    @param[in]  fd          int         已绑定的接收套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       延时分为三段: 用户态到内核发送, 网络及协议栈, 内核接收到用户态.
+                软件时间戳和用户态时间都是CLOCK_REALTIME, 硬件时间戳是网卡时钟, 只有同一时钟域的
+                时间才相减: 硬件发送时间戳没有用户态->内核, 硬件接收时间戳没有内核->用户态,
+                一端硬件一端软件时没有网络段. 跨主机测试需要时钟同步, 两端硬件时还需ptp4l同步网卡时钟.
+*/
+static int ts_receive(int fd, Para_t *pPara)
+{
+    int hw = 0;
+    int length = 0;
+    unsigned char buffer[256];
+    unsigned char control[512];
+    TsHead_t *head = (TsHead_t *)buffer;
+    TsSlot_t *slot = NULL;
+    struct msghdr msg;
+    struct iovec iov;
+    uint64_t kernel_rx = 0;
+    uint64_t user_rx = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t skipped[4] = {0, 0, 0, 0};
+    int kind = 0;
+    Hist_t hist[4];
+
+    hw = ts_enable(fd, pPara, 0);
+    if (hw < 0)
+    {
+        return -3;
+    }
+
+    hist_init(&hist[0], "user->kernel tx");
+    hist_init(&hist[1], "wire/stack     ");
+    hist_init(&hist[2], "kernel rx->user");
+    hist_init(&hist[3], "total          ");
+    memset(s_slot, 0x00, sizeof(s_slot));
+    install_quit();
+
+    printf("timestamp %s, press ctrl+c to quit.\n", hw ? "hardware" : "software");
+    perf_begin();
+    while (!s_quit)
+    {
+        memset(&msg, 0x00, sizeof(struct msghdr));
+        iov.iov_base = buffer;
+        iov.iov_len = sizeof(buffer);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        length = recvmsg(fd, &msg, 0);
+        user_rx = clock_ns(CLOCK_REALTIME);
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("recvmsg failed!%d\n", errno);
+            break;
+        }
+
+        if ((length < sizeof(TsHead_t)) || (head->magic != TS_MAGIC))
+        {
+            continue;
+        }
+
+        if (head->type == TS_DATA)
+        {
+            kind = ts_parse(&msg, &kernel_rx, NULL);
+            if (kind < 0)
+            {
+                continue;
+            }
+
+            slot = &s_slot[head->seq % TS_SLOTS];
+            slot->seq = head->seq;
+            slot->valid = 1;
+            slot->user_tx = head->time;
+            slot->kernel_rx = kernel_rx;
+            slot->user_rx = user_rx;
+            slot->hw = kind;
+            packets++;
+            bytes += length;
+        }
+        else if (head->type == TS_FOLLOW)
+        {
+            slot = &s_slot[head->seq % TS_SLOTS];
+            if (!slot->valid || (slot->seq != head->seq))
+            {
+                continue;
+            }
+
+            /* 用户态时间都是CLOCK_REALTIME, 和硬件时间戳不能相减 */
+            if (head->hw == 0)
+            {
+                hist_add(&hist[0], (int64_t)(head->time - slot->user_tx));
+            }
+            else
+            {
+                skipped[0]++;
+            }
+
+            if (head->hw == slot->hw)
+            {
+                hist_add(&hist[1], (int64_t)(slot->kernel_rx - head->time));
+            }
+            else
+            {
+                skipped[1]++;
+            }
+
+            if (slot->hw == 0)
+            {
+                hist_add(&hist[2], (int64_t)(slot->user_rx - slot->kernel_rx));
+            }
+            else
+            {
+                skipped[2]++;
+            }
+
+            hist_add(&hist[3], (int64_t)(slot->user_rx - slot->user_tx));
+            slot->valid = 0;
+        }
+        else if (head->type == TS_END)
+        {
+            printf("sender sent %u packets\n", head->seq);
+            ts_report(hist, skipped, 4, packets, bytes);
+            packets = 0;
+            bytes = 0;
+        }
+    }
+
+    if (packets != 0)
+    {
+        ts_report(hist, skipped, 4, packets, bytes);
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int ring_open(Ring_t *pRing, int fanout)
+    @brief      创建TPACKET_V3环形缓冲接收套接字
+    @author     agent
+    @param[in]  pRing       Ring_t*     接收线程结构体
+    @param[in]  fanout      int         fanout组号
+    @retval     0 成功
+    @retval     <0 失败
+    @note       需要CAP_NET_RAW权限. fanout按流哈希, 同一条流只进入一个线程.
+*/
+static int ring_open(Ring_t *pRing, int fanout)
+{
+    int ret = 0;
+    int opt = 0;
+    struct sockaddr_ll local;
+    size_t size = 0;
+
+    pRing->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IP));
+    if (pRing->fd == -1)
+    {
+        printf("socket failed(AF_PACKET)!%d\n", errno);
+        return -1;
+    }
+
+    opt = TPACKET_V3;
+    ret = setsockopt(pRing->fd, SOL_PACKET, PACKET_VERSION, (char *)&opt, sizeof(opt));
+    if (ret != 0)
+    {
+        printf("setsockopt failed(PACKET_VERSION)!%d\n", errno);
+        return -2;
+    }
+
+    memset(&pRing->req, 0x00, sizeof(struct tpacket_req3));
+    pRing->req.tp_block_size = RING_BLOCK_SIZE;
+    pRing->req.tp_block_nr = RING_BLOCK_NR;
+    pRing->req.tp_frame_size = RING_FRAME_SIZE;
+    pRing->req.tp_frame_nr = (RING_BLOCK_SIZE / RING_FRAME_SIZE) * RING_BLOCK_NR;
+    pRing->req.tp_retire_blk_tov = RING_TIMEOUT_MS;
+    pRing->req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+    ret = setsockopt(pRing->fd, SOL_PACKET, PACKET_RX_RING, (char *)&pRing->req, sizeof(pRing->req));
+    if (ret != 0)
+    {
+        printf("setsockopt failed(PACKET_RX_RING)!%d\n", errno);
+        return -3;
+    }
+
+    size = (size_t)pRing->req.tp_block_size * pRing->req.tp_block_nr;
+    pRing->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, pRing->fd, 0);
+    if (pRing->map == MAP_FAILED)
+    {
+        /* 没有锁内存权限时不锁 */
+        pRing->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, pRing->fd, 0);
+    }
+    if (pRing->map == MAP_FAILED)
+    {
+        printf("mmap failed!%d\n", errno);
+        pRing->map = NULL;
+        return -4;
+    }
+
+    memset(&local, 0x00, sizeof(struct sockaddr_ll));
+    local.sll_family = AF_PACKET;
+    local.sll_protocol = htons(ETH_P_IP);
+    local.sll_ifindex = pRing->pPara->ifname[0] ? if_nametoindex(pRing->pPara->ifname) : 0;
+    if (bind(pRing->fd, (struct sockaddr *)&local, sizeof(struct sockaddr_ll)) == -1)
+    {
+        printf("bind failed!%d\n", errno);
+        return -5;
+    }
+
+    opt = (fanout & 0xFFFF) | (PACKET_FANOUT_HASH << 16);
+    ret = setsockopt(pRing->fd, SOL_PACKET, PACKET_FANOUT, (char *)&opt, sizeof(opt));
+    if (ret != 0)
+    {
+        printf("setsockopt failed(PACKET_FANOUT)!%d\n", errno);
+        return -6;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static void ring_close(Ring_t *pRing)
+    @brief      释放环形缓冲并关闭套接字
+    @author     agent
+    @param[in]  pRing       Ring_t*     接收线程结构体
+*/
+static void ring_close(Ring_t *pRing)
+{
+    if (pRing->map != NULL)
+    {
+        munmap(pRing->map, (size_t)pRing->req.tp_block_size * pRing->req.tp_block_nr);
+        pRing->map = NULL;
+    }
+
+    if (pRing->fd != -1)
+    {
+        close(pRing->fd);
+        pRing->fd = -1;
+    }
+}
+
+/**
+    @fn         static void ring_packet(Ring_t *pRing, struct tpacket3_hdr *pHdr)
+    @brief      在环形缓冲中就地解析一个包
+    @author     agent
+    @param[in]  pRing       Ring_t*         接收线程结构体
+    @param[in]  pHdr        tpacket3_hdr*   包头
+    @note       只统计目的端口(和目的地址)匹配的udp包, 不拷贝数据.
+*/
+static void ring_packet(Ring_t *pRing, struct tpacket3_hdr *pHdr)
+{
+    struct sockaddr_ll *sll = NULL;
+    struct iphdr *ip = NULL;
+    struct udphdr *udp = NULL;
+    TsHead_t *head = NULL;
+    unsigned int hlen = 0;
+    unsigned int length = 0;
+
+    /* lo上发出的包也会被抓到, 只要收到的一份 */
+    sll = (struct sockaddr_ll *)((unsigned char *)pHdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    if (sll->sll_pkttype == PACKET_OUTGOING)
+    {
+        return;
+    }
+
+    ip = (struct iphdr *)((unsigned char *)pHdr + pHdr->tp_net);
+    length = pHdr->tp_snaplen - (pHdr->tp_net - pHdr->tp_mac);
+    hlen = ip->ihl * 4;
+    if ((length < sizeof(struct iphdr)) || (ip->version != 4) || (ip->protocol != IPPROTO_UDP) ||
+        (length < hlen + sizeof(struct udphdr)))
+    {
+        pRing->others++;
+        return;
+    }
+
+    udp = (struct udphdr *)((unsigned char *)ip + hlen);
+    if ((ntohs(udp->dest) != pRing->pPara->port) ||
+        ((pRing->pPara->ip != 0) && (ip->daddr != (uint32_t)pRing->pPara->ip)))
+    {
+        pRing->others++;
+        return;
+    }
+
+    pRing->packets++;
+    pRing->bytes += ntohs(udp->len) - sizeof(struct udphdr);
+
+    /* 时间戳测试包带序号, 可以统计到达网卡之前的丢包 */
+    head = (TsHead_t *)(udp + 1);
+    if ((length >= hlen + sizeof(struct udphdr) + sizeof(TsHead_t)) &&
+        (head->magic == TS_MAGIC) && (head->type == TS_DATA))
+    {
+        if (pRing->has_seq && (head->seq > pRing->next_seq))
+        {
+            pRing->gaps += head->seq - pRing->next_seq;
+        }
+        pRing->next_seq = head->seq + 1;
+        pRing->has_seq = 1;
+    }
+}
+
+/**
+    @fn         static void *ring_thread(void *arg)
+    @brief      环形缓冲接收线程
+    @author     agent
+    @param[in]  arg         void*       Ring_t结构体
+    @note       依次处理内核交给用户态的块, 块内逐包解析后把块还给内核,
+                没有数据时用poll等待, 处理数据时没有系统调用.
+*/
+static void *ring_thread(void *arg)
+{
+    Ring_t *pRing = (Ring_t *)arg;
+    struct tpacket_block_desc *block = NULL;
+    struct tpacket3_hdr *hdr = NULL;
+    struct pollfd pfd;
+    unsigned int index = 0;
+    unsigned int i = 0;
+
+    while (!s_quit)
+    {
+        block = (struct tpacket_block_desc *)(pRing->map + (size_t)index * pRing->req.tp_block_size);
+        if ((block->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+        {
+            pfd.fd = pRing->fd;
+            pfd.events = POLLIN | POLLERR;
+            pfd.revents = 0;
+            poll(&pfd, 1, 100);
+            continue;
+        }
+
+        hdr = (struct tpacket3_hdr *)((unsigned char *)block + block->hdr.bh1.offset_to_first_pkt);
+        for (i = 0; i < block->hdr.bh1.num_pkts; i++)
+        {
+            ring_packet(pRing, hdr);
+            hdr = (struct tpacket3_hdr *)((unsigned char *)hdr + hdr->tp_next_offset);
+        }
+
+        pRing->blocks++;
+        __sync_synchronize();
+        block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+        index = (index + 1) % pRing->req.tp_block_nr;
+    }
+
+    return NULL;
+}
+
+/**
+    @fn         static void ring_statistics(Ring_t *pRing)
+    @brief      读取并累加内核统计
+    @author     agent
+    @param[in]  pRing       Ring_t*     接收线程结构体
+    @note       PACKET_STATISTICS读取后内核清零, 所以要累加.
+*/
+static void ring_statistics(Ring_t *pRing)
+{
+    struct tpacket_stats_v3 stats;
+    socklen_t length = sizeof(stats);
+
+    memset(&stats, 0x00, sizeof(stats));
+    if (getsockopt(pRing->fd, SOL_PACKET, PACKET_STATISTICS, &stats, &length) == 0)
+    {
+        pRing->kernel_packets += stats.tp_packets;
+        pRing->kernel_drops += stats.tp_drops;
+        pRing->freeze += stats.tp_freeze_q_cnt;
+    }
+}
+
+/**
+    @fn         static long long udp_rcvbuf_errors(void)
+    @brief      读取系统udp接收缓冲溢出计数
+    @author     agent
+    @retval     /proc/net/snmp中的Udp RcvbufErrors, 失败返回-1
+    @note       与环形缓冲的计数对比, 可判断丢包是否发生在udp套接字层.
+*/
+static long long udp_rcvbuf_errors(void)
+{
+    FILE *fp = NULL;
+    char line[512];
+    char name[512];
+    char *token = NULL;
+    char *save = NULL;
+    int column = -1;
+    int i = 0;
+    long long value = -1;
+
+    fp = fopen("/proc/net/snmp", "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        if (strncmp(line, "Udp:", 4) != 0)
+        {
+            continue;
+        }
+
+        /* 第一行为名称, 第二行为数值 */
+        if (column < 0)
+        {
+            strcpy(name, line);
+            for (i = 0, token = strtok_r(name, " \n", &save); token != NULL; i++, token = strtok_r(NULL, " \n", &save))
+            {
+                if (strcmp(token, "RcvbufErrors") == 0)
+                {
+                    column = i;
+                }
+            }
+            if (column < 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        for (i = 0, token = strtok_r(line, " \n", &save); token != NULL; i++, token = strtok_r(NULL, " \n", &save))
+        {
+            if (i == column)
+            {
+                value = strtoll(token, NULL, 10);
+            }
+        }
+        break;
+    }
+
+    fclose(fp);
+
+    return value;
+}
+
+/**
+    @fn         static int ring_receive(Para_t *pPara)
+    @brief      AF_PACKET环形缓冲接收udp数据
+    @author     agent
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       每秒打印一次速率, ctrl+c后打印各线程统计和内核丢包.
+                本地可用veth测试:
+                ip link add veth0 type veth peer name veth1
+                接收端绑定veth1, 发送端从veth0的地址发出.
+*/
+static int ring_receive(Para_t *pPara)
+{
+    int ret = 0;
+    int i = 0;
+    int started = 0;
+    int fanout = 0;
+    Ring_t ring[RING_THREADS];
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t last_packets = 0;
+    uint64_t last_bytes = 0;
+    uint64_t gaps = 0;
+    uint64_t drops = 0;
+    long long rcvbuf_start = 0;
+    long long rcvbuf_end = 0;
+
+    memset(ring, 0x00, sizeof(ring));
+    fanout = getpid() & 0xFFFF;
+
+    /* 先全部置为未打开, 中途打开失败时Exit不会关闭0号描述符 */
+    for (i = 0; i < pPara->ring; i++)
+    {
+        ring[i].fd = -1;
+    }
+
+    for (i = 0; i < pPara->ring; i++)
+    {
+        ring[i].index = i;
+        ring[i].pPara = pPara;
+        ret = ring_open(&ring[i], fanout);
+        if (ret != 0)
+        {
+            goto Exit;
+        }
+    }
+
+    install_quit();
+    rcvbuf_start = udp_rcvbuf_errors();
+    perf_begin();
+
+    for (started = 0; started < pPara->ring; started++)
+    {
+        if (pthread_create(&ring[started].thread, NULL, ring_thread, &ring[started]) != 0)
+        {
+            printf("pthread_create failed!%d\n", errno);
+            s_quit = 1;
+            ret = -7;
+            break;
+        }
+    }
+
+    printf("ring %d threads on %s, press ctrl+c to quit.\n", pPara->ring,
+           pPara->ifname[0] ? pPara->ifname : "all");
+    while (!s_quit)
+    {
+        sleep(1);
+
+        packets = 0;
+        bytes = 0;
+        for (i = 0; i < started; i++)
+        {
+            packets += ring[i].packets;
+            bytes += ring[i].bytes;
+        }
+        printf("%llu pps %.3f Mbps\n", (unsigned long long)(packets - last_packets),
+               (bytes - last_bytes) * 8 / 1000000.0);
+        last_packets = packets;
+        last_bytes = bytes;
+    }
+
+    /* 线程退出后其计数才会累加到本线程的计数器中 */
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(ring[i].thread, NULL);
+    }
+    rcvbuf_end = udp_rcvbuf_errors();
+
+    printf("=== udp port=%d ring statistics ===\n", pPara->port);
+    packets = 0;
+    bytes = 0;
+    for (i = 0; i < started; i++)
+    {
+        ring_statistics(&ring[i]);
+        printf("thread%d: packets=%llu bytes=%llu others=%llu blocks=%llu seq gaps=%llu "
+               "kernel packets=%llu drops=%llu freeze=%llu\n", i,
+               (unsigned long long)ring[i].packets, (unsigned long long)ring[i].bytes,
+               (unsigned long long)ring[i].others, (unsigned long long)ring[i].blocks,
+               (unsigned long long)ring[i].gaps, (unsigned long long)ring[i].kernel_packets,
+               (unsigned long long)ring[i].kernel_drops, (unsigned long long)ring[i].freeze);
+        packets += ring[i].packets;
+        bytes += ring[i].bytes;
+        gaps += ring[i].gaps;
+        drops += ring[i].kernel_drops;
+    }
+
+    /* 序号缺口: 发送端或线路丢包; ring drops: 接收太慢; RcvbufErrors: udp套接字层丢包 */
+    printf("total: packets=%llu seq gaps(sender/wire)=%llu ring drops=%llu",
+           (unsigned long long)packets, (unsigned long long)gaps, (unsigned long long)drops);
+    if ((rcvbuf_start >= 0) && (rcvbuf_end >= 0))
+    {
+        printf(" udp RcvbufErrors(socket)=%lld", rcvbuf_end - rcvbuf_start);
+    }
+    printf("\n");
+    perf_end("udp ring receive", packets, bytes);
+
+Exit:
+    for (i = 0; i < pPara->ring; i++)
+    {
+        ring_close(&ring[i]);
+    }
+
+    return ret;
+}
+
+/**
+    @fn         static int lat_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+    @brief      按固定间隔发送带发送时间的udp数据
+    @author     agent
+    @param[in]  fd          int         已设置好的发送套接字
+    @param[in]  pRemote     sockaddr_in 目的地址
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       按绝对时间休眠, 避免间隔误差累积. 结束时发送TS_END通知接收端打印统计.
+*/
+static int lat_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+{
+    int i = 0;
+    int ret = 0;
+    unsigned char buffer[256];
+    TsHead_t *head = (TsHead_t *)buffer;
+    struct timespec next;
+    uint64_t gap = (uint64_t)pPara->gap * 1000;
+
+    for (i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = i;
+    }
+
+    perf_begin();
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (i = 0; i < pPara->number; i++)
+    {
+        if (gap != 0)
+        {
+            next.tv_nsec += gap;
+            while (next.tv_nsec >= 1000000000)
+            {
+                next.tv_nsec -= 1000000000;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+
+        head->magic = TS_MAGIC;
+        head->type = TS_DATA;
+        head->seq = i;
+        head->hw = 0;
+        head->time = clock_ns(CLOCK_REALTIME);
+        ret = sendto(fd, (char *)buffer, sizeof(buffer), 0, (struct sockaddr *)pRemote, sizeof(struct sockaddr_in));
+        if (ret != sizeof(buffer))
+        {
+            printf("sent = %d\n", ret);
+            return -21;
+        }
+    }
+
+    head->type = TS_END;
+    head->seq = i;
+    sendto(fd, (char *)buffer, sizeof(TsHead_t), 0, (struct sockaddr *)pRemote, sizeof(struct sockaddr_in));
+    printf("sent=%d gap=%dus\n", i, pPara->gap);
+    perf_end("udp latency send", i, (uint64_t)i * sizeof(buffer));
+
+    return 0;
+}
+
+/**
+    @fn         static int lat_receive(int fd, Para_t *pPara)
+    @brief      接收udp数据并统计单向延时和CPU开销
+    @author     agent
+    @param[in]  fd          int         已绑定的接收套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       不带-B时为默认阻塞接收, 带-B时为busy poll加用户态自旋,
+                两次运行结果对比即可看出延时与CPU开销的取舍.
+*/
+static int lat_receive(int fd, Para_t *pPara)
+{
+    int length = 0;
+    int cpu = -1;
+    unsigned char buffer[256];
+    TsHead_t *head = (TsHead_t *)buffer;
+    uint64_t now = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    const char *name = pPara->busy ? "busy-poll" : "blocking";
+    Hist_t hist;
+    Cost_t cost;
+
+    if (pPara->busy && (lowlat_socket(fd, pPara->busy) != 0))
+    {
+        return -3;
+    }
+
+    if (pPara->fifo)
+    {
+        lowlat_realtime(pPara->fifo);
+    }
+
+    hist_init(&hist, name);
+    install_quit();
+
+    printf("%s receive, press ctrl+c to quit.\n", name);
+    while (!s_quit)
+    {
+        if (pPara->busy)
+        {
+            length = lowlat_recvfrom(fd, buffer, sizeof(buffer), 0, NULL, NULL, &s_quit);
+        }
+        else
+        {
+            length = recvfrom(fd, buffer, sizeof(buffer), 0, NULL, NULL);
+        }
+        now = clock_ns(CLOCK_REALTIME);
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("recvfrom failed!%d\n", errno);
+            break;
+        }
+
+        /* 第一个包开始计算CPU开销, 此时SO_INCOMING_CPU也有效了 */
+        if (messages == 0)
+        {
+            cost_start(&cost);
+            perf_begin();
+            if (pPara->busy && (cpu < 0))
+            {
+                cpu = lowlat_pin(fd, pPara->fifo);
+                printf("pinned cpu=%d\n", cpu);
+            }
+        }
+
+        if ((length < sizeof(TsHead_t)) || (head->magic != TS_MAGIC))
+        {
+            continue;
+        }
+
+        if (head->type == TS_END)
+        {
+            printf("sender sent %u packets\n", head->seq);
+            hist_print(&hist);
+            cost_print(&cost, name, messages, bytes);
+            perf_end(name, messages, bytes);
+            hist_init(&hist, name);
+            messages = 0;
+            bytes = 0;
+            continue;
+        }
+
+        hist_add(&hist, (int64_t)(now - head->time));
+        messages++;
+        bytes += length;
+    }
+
+    if (messages != 0)
+    {
+        hist_print(&hist);
+        cost_print(&cost, name, messages, bytes);
+        perf_end(name, messages, bytes);
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static int cap_receive(int fd, Para_t *pPara)
+    @brief      接收udp数据写入抓包文件
+    @author     agent
+    @param[in]  fd          int         已绑定的接收套接字
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       不打印数据, 每秒打印一次记录数. 文件满后继续接收但只计数.
+*/
+static int cap_receive(int fd, Para_t *pPara)
+{
+    int length = 0;
+    struct sockaddr_in remote;
+    socklen_t socketLength = sizeof(struct sockaddr_in);
+    Capture_t capture;
+    uint64_t last = 0;
+    uint64_t now = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    unsigned char *buffer = NULL;
+
+    if (capture_open(&capture, pPara->capture, pPara->size) != 0)
+    {
+        return -3;
+    }
+
+    buffer = pool_get(&s_pool);
+    if (buffer == NULL)
+    {
+        printf("buffer pool empty!\n");
+        capture_close(&capture);
+        return -1;
+    }
+
+    install_quit();
+    printf("capture to %s, press ctrl+c to quit.\n", pPara->capture);
+    last = clock_ns(CLOCK_MONOTONIC);
+    perf_begin();
+    while (!s_quit)
+    {
+        length = recvfrom(fd, buffer, s_pool.size, 0, (struct sockaddr *)&remote, &socketLength);
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("recvfrom failed!%d\n", errno);
+            break;
+        }
+
+        capture_write(&capture, buffer, length, remote.sin_addr.s_addr);
+        messages++;
+        bytes += length;
+
+        now = clock_ns(CLOCK_MONOTONIC);
+        if (now - last >= 1000000000ULL)
+        {
+            printf("records=%llu dropped=%llu\n", (unsigned long long)capture.head->records,
+                   (unsigned long long)capture.head->dropped);
+            last = now;
+        }
+    }
+
+    perf_end("udp capture", messages, bytes);
+    capture_close(&capture);
+    pool_put(&s_pool, buffer);
+
+    return 0;
+}
+
+/**
+    @fn         static int cap_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+    @brief      按抓包文件的长度和时间间隔回放
+    @author     agent
+    @param[in]  fd          int         已设置好的发送套接字
+    @param[in]  pRemote     sockaddr_in 目的地址
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       -x指定倍速, 打印实际回放时长与原始时长对比.
+*/
+static int cap_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+{
+    int ret = 0;
+    Capture_t capture;
+    CaptureRecord_t *record = NULL;
+    uint64_t first = 0;
+    uint64_t last = 0;
+    uint64_t start = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+
+    if (capture_load(&capture, pPara->replay) != 0)
+    {
+        return -3;
+    }
+
+    printf("replay %s records=%llu speed=%.2f\n", pPara->replay,
+           (unsigned long long)capture.head->records, pPara->speed);
+    start = clock_ns(CLOCK_MONOTONIC);
+    perf_begin();
+    while ((record = capture_next(&capture)) != NULL)
+    {
+        if (packets == 0)
+        {
+            first = record->time;
+        }
+        last = record->time;
+        capture_wait(first, start, record->time, pPara->speed);
+
+        ret = sendto(fd, (char *)(record + 1), record->length, 0, (struct sockaddr *)pRemote, sizeof(struct sockaddr_in));
+        if (ret != record->length)
+        {
+            printf("sent = %d\n", ret);
+            ret = -21;
+            break;
+        }
+        packets++;
+        bytes += record->length;
+        ret = 0;
+    }
+
+    printf("replayed packets=%llu bytes=%llu captured %.3fs replayed %.3fs\n",
+           (unsigned long long)packets, (unsigned long long)bytes, (last - first) / 1e9,
+           (clock_ns(CLOCK_MONOTONIC) - start) / 1e9);
+    perf_end("udp replay", packets, bytes);
+    capture_close(&capture);
+
+    return ret;
+}
+
+/**
+    @fn         static int mc_join(int fd, uint32_t group, Para_t *pPara)
+    @brief      加入组播组
+    @author     agent
+    @param[in]  fd          int         接收套接字
+    @param[in]  group       uint32_t    组播地址, 网络字节序
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       指定-I时在该网卡上加入, 否则由路由选择网卡.
+                单个套接字加入的组数受net.ipv4.igmp_max_memberships限制.
+*/
+static int mc_join(int fd, uint32_t group, Para_t *pPara)
+{
+    struct ip_mreqn mreq;
+
+    memset(&mreq, 0x00, sizeof(struct ip_mreqn));
+    mreq.imr_multiaddr.s_addr = group;
+    mreq.imr_address.s_addr = htonl(INADDR_ANY);
+    if (pPara->ifname[0] != 0)
+    {
+        mreq.imr_ifindex = if_nametoindex(pPara->ifname);
+    }
+
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0)
+    {
+        printf("setsockopt failed(IP_ADD_MEMBERSHIP %s)!%d\n", inet_ntoa(mreq.imr_multiaddr), errno);
+        if (errno == ENOBUFS)
+        {
+            printf("raise net.ipv4.igmp_max_memberships or use -E\n");
+        }
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+    @fn         static uint32_t mc_group(Para_t *pPara, int index)
+    @brief      计算第index个组播地址
+    @author     agent
+    @param[in]  pPara       Para_t      内部参数结构体
+    @param[in]  index       int         组序号
+    @retval     组播地址, 网络字节序
+    @note       各组地址从-m指定的地址开始连续递增.
+*/
+static uint32_t mc_group(Para_t *pPara, int index)
+{
+    return htonl(ntohl((uint32_t)pPara->ip) + index);
+}
+
+/**
+    @fn         static int mc_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+    @brief      按总速率轮流向各组播组发送
+    @author     agent
+    @param[in]  fd          int         已设置好的发送套接字
+    @param[in]  pRemote     sockaddr_in 第一个组的目的地址
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       -n为所有组的总包数, -q为总速率(包/秒), 0为尽快发送.
+                按绝对时间计算每个包的发送时刻, 提前较多时休眠, 否则自旋.
+                结束时向每个组发送TS_END, 带上该组的发送包数.
+*/
+static int mc_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+{
+    int i = 0;
+    int ret = 0;
+    int index = 0;
+    unsigned char buffer[256];
+    McHead_t *head = (McHead_t *)buffer;
+    struct sockaddr_in remote = *pRemote;
+    struct ip_mreqn mreq;
+    uint32_t *seq = NULL;
+    uint64_t start = 0;
+    uint64_t target = 0;
+    uint64_t now = 0;
+    uint64_t late = 0;
+    uint64_t errors = 0;
+
+    if (!IN_MULTICAST(ntohl(mc_group(pPara, pPara->groups - 1))))
+    {
+        printf("groups out of multicast range!\n");
+        return -3;
+    }
+
+    if (pPara->ifname[0] != 0)
+    {
+        memset(&mreq, 0x00, sizeof(struct ip_mreqn));
+        mreq.imr_ifindex = if_nametoindex(pPara->ifname);
+        if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mreq, sizeof(mreq)) != 0)
+        {
+            printf("setsockopt failed(IP_MULTICAST_IF)!%d\n", errno);
+            return -3;
+        }
+    }
+
+    seq = calloc(pPara->groups, sizeof(uint32_t));
+    if (seq == NULL)
+    {
+        printf("calloc failed!%d\n", errno);
+        return -1;
+    }
+
+    for (i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = i;
+    }
+
+    printf("spray %d packets to %d groups rate=%dpps\n", pPara->number, pPara->groups, pPara->rate);
+    perf_begin();
+    start = clock_ns(CLOCK_MONOTONIC);
+    for (i = 0; i < pPara->number; i++)
+    {
+        if (pPara->rate != 0)
+        {
+            target = start + (uint64_t)i * 1000000000ULL / pPara->rate;
+            now = clock_ns(CLOCK_MONOTONIC);
+            if (now > target + 1000000)
+            {
+                late++;
+            }
+            else if (target > now + MC_SPIN_NS)
+            {
+                struct timespec ts;
+
+                ts.tv_sec = target / 1000000000ULL;
+                ts.tv_nsec = target % 1000000000ULL;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            }
+            else
+            {
+                while (clock_ns(CLOCK_MONOTONIC) < target)
+                {
+                }
+            }
+        }
+
+        index = i % pPara->groups;
+        head->magic = MC_MAGIC;
+        head->type = TS_DATA;
+        head->group = index;
+        head->seq = seq[index];
+        remote.sin_addr.s_addr = mc_group(pPara, index);
+        ret = sendto(fd, (char *)buffer, sizeof(buffer), 0, (struct sockaddr *)&remote, sizeof(struct sockaddr_in));
+        if (ret != sizeof(buffer))
+        {
+            /* 发送队列满时计数后继续, 接收端会看到对应的丢包 */
+            if ((ret == -1) && ((errno == ENOBUFS) || (errno == EAGAIN)))
+            {
+                errors++;
+                continue;
+            }
+            printf("sent = %d\n", ret);
+            free(seq);
+            return -21;
+        }
+        seq[index]++;
+    }
+    now = clock_ns(CLOCK_MONOTONIC);
+
+    /* 结束包可能丢失, 每组多发几次 */
+    for (ret = 0; ret < 3; ret++)
+    {
+        for (index = 0; index < pPara->groups; index++)
+        {
+            head->type = TS_END;
+            head->group = index;
+            head->seq = seq[index];
+            remote.sin_addr.s_addr = mc_group(pPara, index);
+            sendto(fd, (char *)buffer, sizeof(McHead_t), 0, (struct sockaddr *)&remote, sizeof(struct sockaddr_in));
+        }
+    }
+
+    printf("sent=%d groups=%d %.0fpps late=%llu errors=%llu\n", i, pPara->groups,
+           i * 1e9 / (now - start + 1), (unsigned long long)late, (unsigned long long)errors);
+    perf_end("udp multicast send", i, (uint64_t)i * sizeof(buffer));
+    free(seq);
+
+    return 0;
+}
+
+/**
+    @fn         static int mc_account(McGroup_t *pGroup, unsigned char *buffer, int length)
+    @brief      统计一个组播包
+    @author     agent
+    @param[in]  pGroup      McGroup_t   所属组
+    @param[in]  buffer      char*       数据
+    @param[in]  length      int         长度
+    @retval     1 收到该组的结束包
+    @retval     0 其他
+*/
+static int mc_account(McGroup_t *pGroup, unsigned char *buffer, int length)
+{
+    McHead_t *head = (McHead_t *)buffer;
+
+    if ((length < sizeof(McHead_t)) || (head->magic != MC_MAGIC))
+    {
+        return 0;
+    }
+
+    if (head->type == TS_END)
+    {
+        if (pGroup->ended)
+        {
+            return 0;
+        }
+        pGroup->ended = 1;
+        pGroup->sent = head->seq;
+        return 1;
+    }
+
+    if (head->seq < pGroup->next)
+    {
+        pGroup->reorder++;
+    }
+    else
+    {
+        pGroup->next = head->seq + 1;
+    }
+    pGroup->received++;
+    pGroup->bytes += length;
+
+    return 0;
+}
+
+/**
+    @fn         static void mc_report(McGroup_t *pGroup, Para_t *pPara, const char *name)
+    @brief      打印各组的投递情况
+    @author     agent
+    @param[in]  pGroup      McGroup_t*  组数组
+    @param[in]  pPara       Para_t      内部参数结构体
+    @param[in]  name        char*       接收方式
+    @note       组数较少时逐组打印, 否则只打印有丢包的组, 最后打印汇总.
+*/
+static void mc_report(McGroup_t *pGroup, Para_t *pPara, const char *name)
+{
+    int i = 0;
+    int lines = 0;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    double ratio = 0;
+    double min = 100;
+    double max = 0;
+    struct in_addr addr;
+
+    for (i = 0; i < pPara->groups; i++)
+    {
+        /* 没收到结束包时以最大序号估计发送数 */
+        if (!pGroup[i].ended)
+        {
+            pGroup[i].sent = pGroup[i].next;
+        }
+
+        ratio = pGroup[i].sent ? pGroup[i].received * 100.0 / pGroup[i].sent : 100;
+        if (ratio < min) min = ratio;
+        if (ratio > max) max = ratio;
+        sent += pGroup[i].sent;
+        received += pGroup[i].received;
+
+        if ((pPara->groups <= MC_PRINT) || ((pGroup[i].received < pGroup[i].sent) && (lines < MC_PRINT)))
+        {
+            addr.s_addr = pGroup[i].addr;
+            printf("    %-15s sent=%u received=%llu reorder=%llu delivery=%.2f%%%s\n", inet_ntoa(addr),
+                   pGroup[i].sent, (unsigned long long)pGroup[i].received,
+                   (unsigned long long)pGroup[i].reorder, ratio, pGroup[i].ended ? "" : " (no end)");
+            lines++;
+        }
+    }
+
+    printf("%s: groups=%d sent=%llu received=%llu delivery min=%.2f%% avg=%.2f%% max=%.2f%%\n", name,
+           pPara->groups, (unsigned long long)sent, (unsigned long long)received, min,
+           sent ? received * 100.0 / sent : 100, max);
+}
+
+/**
+    @fn         static int mc_socket(uint32_t addr, Para_t *pPara)
+    @brief      创建组播接收套接字
+    @author     agent
+    @param[in]  addr        uint32_t    绑定地址, 网络字节序
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     >=0 套接字
+    @retval     -1 失败
+    @note       多个套接字绑定同一端口, 需要SO_REUSEADDR. 接收缓冲加大到MC_RCVBUF.
+*/
+static int mc_socket(uint32_t addr, Para_t *pPara)
+{
+    int fd = -1;
+    int opt = 1;
+    struct sockaddr_in local;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1)
+    {
+        printf("socket failed!%d\n", errno);
+        return -1;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    opt = MC_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &opt, sizeof(opt));
+
+    memset(&local, 0x00, sizeof(struct sockaddr_in));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(pPara->port);
+    local.sin_addr.s_addr = addr;
+    if (bind(fd, (struct sockaddr *)&local, sizeof(struct sockaddr_in)) == -1)
+    {
+        printf("bind failed!%d\n", errno);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+    @fn         static int mc_receive(Para_t *pPara)
+    @brief      同时接收多个组播组, 统计各组投递情况和CPU开销
+    @author     agent
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       默认一个套接字加入所有组, 通过IP_PKTINFO的目的地址区分组;
+                -E时每组一个套接字, 绑定组地址, 由epoll等待.
+                两种方式都用recvmmsg批量接收, 所有组收到结束包或ctrl+c后打印统计.
+*/
+static int mc_receive(Para_t *pPara)
+{
+    int i = 0;
+    int j = 0;
+    int n = 0;
+    int fd = -1;
+    int epfd = -1;
+    int ret = 0;
+    int ended = 0;
+    int index = 0;
+    unsigned char *buffer = NULL;
+    McGroup_t *pGroup = NULL;
+    struct mmsghdr msg[MC_BATCH];
+    struct iovec iov[MC_BATCH];
+    unsigned char control[MC_BATCH][CMSG_SPACE(sizeof(struct in_pktinfo))];
+    struct cmsghdr *cmsg = NULL;
+    struct in_pktinfo *info = NULL;
+    struct epoll_event event;
+    struct epoll_event events[MC_BATCH];
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t calls = 0;
+    uint64_t others = 0;
+    const char *name = pPara->epoll ? "epoll per group" : "pktinfo demux";
+    Cost_t cost;
+
+    if (!IN_MULTICAST(ntohl(mc_group(pPara, 0))) || !IN_MULTICAST(ntohl(mc_group(pPara, pPara->groups - 1))))
+    {
+        printf("groups out of multicast range!\n");
+        return -3;
+    }
+
+    buffer = pool_get(&s_pool);
+    pGroup = calloc(pPara->groups, sizeof(McGroup_t));
+    if ((buffer == NULL) || (pGroup == NULL))
+    {
+        printf("buffer alloc failed!\n");
+        ret = -1;
+        goto Exit;
+    }
+
+    /* 一个池缓冲切成MC_BATCH份, 每份接收一个包 */
+    for (i = 0; i < MC_BATCH; i++)
+    {
+        iov[i].iov_base = buffer + i * (s_pool.size / MC_BATCH);
+        iov[i].iov_len = s_pool.size / MC_BATCH;
+    }
+
+    for (i = 0; i < pPara->groups; i++)
+    {
+        pGroup[i].addr = mc_group(pPara, i);
+        pGroup[i].fd = -1;
+    }
+
+    if (pPara->epoll)
+    {
+        epfd = epoll_create1(0);
+        if (epfd == -1)
+        {
+            printf("epoll_create1 failed!%d\n", errno);
+            ret = -2;
+            goto Exit;
+        }
+
+        for (i = 0; i < pPara->groups; i++)
+        {
+            pGroup[i].fd = mc_socket(pGroup[i].addr, pPara);
+            if ((pGroup[i].fd == -1) || (mc_join(pGroup[i].fd, pGroup[i].addr, pPara) != 0))
+            {
+                ret = -2;
+                goto Exit;
+            }
+
+            event.events = EPOLLIN;
+            event.data.u32 = i;
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, pGroup[i].fd, &event) != 0)
+            {
+                printf("epoll_ctl failed!%d\n", errno);
+                ret = -2;
+                goto Exit;
+            }
+        }
+    }
+    else
+    {
+        fd = mc_socket(htonl(INADDR_ANY), pPara);
+        if (fd == -1)
+        {
+            ret = -2;
+            goto Exit;
+        }
+
+        n = 1;
+        if (setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &n, sizeof(n)) != 0)
+        {
+            printf("setsockopt failed(IP_PKTINFO)!%d\n", errno);
+            ret = -2;
+            goto Exit;
+        }
+
+        for (i = 0; i < pPara->groups; i++)
+        {
+            if (mc_join(fd, pGroup[i].addr, pPara) != 0)
+            {
+                ret = -2;
+                goto Exit;
+            }
+        }
+    }
+
+    install_quit();
+    printf("%s receive %d groups, press ctrl+c to quit.\n", name, pPara->groups);
+    while (!s_quit && (ended < pPara->groups))
+    {
+        if (pPara->epoll)
+        {
+            n = epoll_wait(epfd, events, MC_BATCH, -1);
+            if (n == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                printf("epoll_wait failed!%d\n", errno);
+                break;
+            }
+            calls++;
+        }
+        else
+        {
+            n = 1;
+        }
+
+        for (j = 0; j < n; j++)
+        {
+            index = pPara->epoll ? events[j].data.u32 : -1;
+            memset(msg, 0x00, sizeof(msg));
+            for (i = 0; i < MC_BATCH; i++)
+            {
+                msg[i].msg_hdr.msg_iov = &iov[i];
+                msg[i].msg_hdr.msg_iovlen = 1;
+                msg[i].msg_hdr.msg_control = control[i];
+                msg[i].msg_hdr.msg_controllen = pPara->epoll ? 0 : sizeof(control[i]);
+            }
+
+            /* epoll已确认可读, 非阻塞收完一批即可; pktinfo方式阻塞等待 */
+            ret = recvmmsg(pPara->epoll ? pGroup[index].fd : fd, msg, MC_BATCH,
+                           pPara->epoll ? MSG_DONTWAIT : MSG_WAITFORONE, NULL);
+            calls++;
+            if (ret == -1)
+            {
+                if ((errno == EINTR) || (errno == EAGAIN))
+                {
+                    continue;
+                }
+                printf("recvmmsg failed!%d\n", errno);
+                s_quit = 1;
+                break;
+            }
+
+            if (messages == 0)
+            {
+                cost_start(&cost);
+                perf_begin();
+            }
+
+            for (i = 0; i < ret; i++)
+            {
+                if (!pPara->epoll)
+                {
+                    index = -1;
+                    for (cmsg = CMSG_FIRSTHDR(&msg[i].msg_hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg[i].msg_hdr, cmsg))
+                    {
+                        if ((cmsg->cmsg_level == IPPROTO_IP) && (cmsg->cmsg_type == IP_PKTINFO))
+                        {
+                            info = (struct in_pktinfo *)CMSG_DATA(cmsg);
+                            index = ntohl(info->ipi_addr.s_addr) - ntohl((uint32_t)pPara->ip);
+                        }
+                    }
+                    if ((index < 0) || (index >= pPara->groups))
+                    {
+                        others++;
+                        continue;
+                    }
+                }
+
+                ended += mc_account(&pGroup[index], iov[i].iov_base, msg[i].msg_len);
+                messages++;
+                bytes += msg[i].msg_len;
+            }
+        }
+    }
+
+    mc_report(pGroup, pPara, name);
+    printf("%s: messages=%llu syscalls=%llu msgs/syscall=%.2f others=%llu\n", name,
+           (unsigned long long)messages, (unsigned long long)calls, calls ? (double)messages / calls : 0,
+           (unsigned long long)others);
+    if (messages != 0)
+    {
+        cost_print(&cost, name, messages, bytes);
+        perf_end(name, messages, bytes);
+    }
+    ret = 0;
+
+Exit:
+    if (pGroup != NULL)
+    {
+        for (i = 0; i < pPara->groups; i++)
+        {
+            if (pGroup[i].fd != -1)
+            {
+                close(pGroup[i].fd);
+            }
+        }
+        free(pGroup);
+    }
+    if (epfd != -1)
+    {
+        close(epfd);
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    if (buffer != NULL)
+    {
+        pool_put(&s_pool, buffer);
+    }
+
+    return ret;
+}
+
+/**
+    @fn         static int udp_proxy(Para_t *pPara)
+    @brief      带损伤的udp代理
+    @author     agent
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @retval     <0 失败
+    @note       -r端口收到的包转发给-X, -X的回应转发给最后一个发送者, 两个方向使用同样的损伤.
+                包直接收进时间轮的槽, 到期后发出, 等待时间由时间轮给出, 精度为IMPAIR_TICK.
+                槽用完时丢弃并计入overflows. ctrl+c结束后打印统计.
+*/
+static int udp_proxy(Para_t *pPara)
+{
+    int i = 0;
+    int n = 0;
+    int ret = 0;
+    int known = 0;
+    int64_t wait = 0;
+    uint64_t now = 0;
+    uint64_t oversize = 0;
+    uint64_t errors = 0;
+    struct pollfd fds[2];
+    struct timespec timeout;
+    struct sockaddr_in local;
+    struct sockaddr_in target;
+    struct sockaddr_in client;
+    struct sockaddr_in from;
+    socklen_t fromLength = 0;
+    unsigned char *buffer = NULL;
+    Slot_t *pSlot = NULL;
+    Impair_t impair;
+
+    fds[0].fd = -1;
+    fds[1].fd = -1;
+    memset(&impair, 0x00, sizeof(Impair_t));
+    memset(&client, 0x00, sizeof(struct sockaddr_in));
+
+    if (impair_addr(pPara->target, &target) != 0)
+    {
+        ret = -1;
+        goto Exit;
+    }
+
+    if (impair_init(&impair, pPara->impair, 0) != 0)
+    {
+        ret = -1;
+        goto Exit;
+    }
+
+    /* 槽用完时用来丢弃数据 */
+    buffer = pool_get(&s_pool);
+    if (buffer == NULL)
+    {
+        printf("pool_get failed!\n");
+        ret = -1;
+        goto Exit;
+    }
+
+    fds[0].fd = socket(AF_INET, SOCK_DGRAM, 0);
+    fds[1].fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if ((fds[0].fd == -1) || (fds[1].fd == -1))
+    {
+        printf("socket failed!%d\n", errno);
+        ret = -2;
+        goto Exit;
+    }
+
+    memset(&local, 0x00, sizeof(struct sockaddr_in));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(pPara->port);
+    local.sin_addr.s_addr = pPara->ip;
+    if (bind(fds[0].fd, (struct sockaddr *)&local, sizeof(struct sockaddr_in)) == -1)
+    {
+        printf("bind failed!%d\n", errno);
+        ret = -3;
+        goto Exit;
+    }
+
+    /* 已连接的套接字只收目的地址的回应 */
+    if (connect(fds[1].fd, (struct sockaddr *)&target, sizeof(struct sockaddr_in)) == -1)
+    {
+        printf("connect failed!%d\n", errno);
+        ret = -3;
+        goto Exit;
+    }
+
+    install_quit();
+    printf("proxy %d -> %s, press ctrl+c to quit.\n", pPara->port, pPara->target);
+
+    while (!s_quit)
+    {
+        /* 发送到期的包 */
+        now = clock_ns(CLOCK_MONOTONIC);
+        while ((pSlot = impair_due(&impair, now)) != NULL)
+        {
+            if (pSlot->tag == 0)
+            {
+                n = send(fds[1].fd, pSlot->data, pSlot->length, 0);
+            }
+            else
+            {
+                n = sendto(fds[0].fd, pSlot->data, pSlot->length, 0, (struct sockaddr *)&client, sizeof(struct sockaddr_in));
+            }
+            if (n < 0)
+            {
+                errors++;
+            }
+            impair_free(&impair, pSlot);
+        }
+
+        wait = impair_wait(&impair, now);
+        timeout.tv_sec = wait / 1000000000;
+        timeout.tv_nsec = wait % 1000000000;
+        fds[0].events = POLLIN;
+        fds[1].events = POLLIN;
+        if (ppoll(fds, 2, (wait < 0) ? NULL : &timeout, NULL) <= 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < 2; i++)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+
+            for (;;)
+            {
+                pSlot = impair_alloc(&impair);
+                fromLength = sizeof(struct sockaddr_in);
+                n = recvfrom(fds[i].fd, (pSlot != NULL) ? pSlot->data : buffer, (pSlot != NULL) ? IMPAIR_SIZE : UDP_MAX,
+                             MSG_DONTWAIT | MSG_TRUNC, (struct sockaddr *)&from, &fromLength);
+                if ((n < 0) || (pSlot == NULL))
+                {
+                    /* 目的端口没有打开时已连接的套接字收到ECONNREFUSED */
+                    if (pSlot != NULL)
+                    {
+                        impair_free(&impair, pSlot);
+                    }
+                    else if (n >= 0)
+                    {
+                        impair.overflows++;
+                    }
+                    if ((n < 0) && (errno != EAGAIN) && (errno != ECONNREFUSED))
+                    {
+                        errors++;
+                    }
+                    break;
+                }
+
+                /* 超过槽长度的包已被截断, 转发出去接收端会当作正常包, 只能丢弃 */
+                if (n > IMPAIR_SIZE)
+                {
+                    oversize++;
+                    impair_free(&impair, pSlot);
+                    continue;
+                }
+                if (i == 0)
+                {
+                    client = from;
+                    known = 1;
+                }
+                else if (!known)
+                {
+                    impair_free(&impair, pSlot);
+                    continue;
+                }
+                pSlot->length = n;
+                pSlot->tag = i;
+                impair_submit(&impair, pSlot, clock_ns(CLOCK_MONOTONIC));
+            }
+        }
+    }
+
+    impair_print(&impair);
+    printf("proxy: dropped oversize(>%d) %llu errors %llu\n", IMPAIR_SIZE, (unsigned long long)oversize,
+           (unsigned long long)errors);
+
+Exit:
+    impair_destroy(&impair);
+    for (i = 0; i < 2; i++)
+    {
+        if (fds[i].fd != -1)
+        {
+            close(fds[i].fd);
+        }
+    }
+    if (buffer != NULL)
+    {
+        pool_put(&s_pool, buffer);
+    }
+
+    return ret;
+}
+
+/**
+    @fn         static int soak_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+    @brief      浸泡测试的发送端
+    @author     agent
+    @param[in]  fd          int         套接字
+    @param[in]  pRemote     sockaddr_in 目的地址
+    @param[in]  pPara       Para_t      内部参数结构体
+    @retval     0 成功
+    @note       按-g间隔发送256字节直到ctrl+c, 发送失败计为错误后继续.
+*/
+static int soak_send(int fd, struct sockaddr_in *pRemote, Para_t *pPara)
+{
+    unsigned char buffer[256];
+    int ret = 0;
+    int i = 0;
+
+    for (i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = i;
+    }
+
+    printf("press ctrl+c to quit.\n");
+    while (!s_quit)
+    {
+        ret = sendto(fd, (char *)buffer, sizeof(buffer), 0, (struct sockaddr *)pRemote, sizeof(struct sockaddr_in));
+        if (ret == sizeof(buffer))
+        {
+            soak_add(&s_soak, 1, ret, 0, -1);
+        }
+        else if (!s_quit)
+        {
+            soak_add(&s_soak, 0, 0, 1, -1);
+        }
+
+        if (pPara->gap)
+        {
+            usleep(pPara->gap);
+        }
+    }
+
+    return 0;
+}